@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "primitives.hpp"
+
+namespace game {
+
+// Moving and rotating adapter in one that parses each property on first access only and
+// keeps the typed value. Writes stay in the adapter until Flush() formats the changed
+// properties and stores them in the entity, e.g. once at the end of a macro or a tick.
+// Every command of the macro has to go through the same adapter to share the values,
+// and the entity must not be changed directly before the adapter is flushed or Reset().
+template<Coordinate T>
+class BasicCachingAdapter : public IBasicMovingObject<T>, public IRotatingObject {
+public:
+    explicit BasicCachingAdapter(IEntity* entity)
+    : entity_{entity} {}
+
+    BasicPoint<T> getLocation() const override {
+        if (!location_) location_ = BasicPoint<T>::fromString(entity_->getProperty("location"));
+        return *location_;
+    }
+
+    void setLocation(const BasicPoint<T>& newLocation) override {
+        location_ = newLocation;
+        locationDirty_ = true;
+    }
+
+    BasicVector<T> getVelocity() const override {
+        if (!velocity_) velocity_ = BasicVector<T>::fromString(entity_->getProperty("velocity"));
+        return *velocity_;
+    }
+
+    std::pair<BasicPoint<T>, BasicVector<T>> getMotion() const override {
+        if (!location_ && !velocity_) {
+            static constexpr std::array<std::string_view, 2> keys{"location", "velocity"};
+            std::array<std::string, 2> values;
+            entity_->getProperties(keys, values);
+            location_ = BasicPoint<T>::fromString(values[0]);
+            velocity_ = BasicVector<T>::fromString(values[1]);
+        }
+        return {getLocation(), getVelocity()};
+    }
+
+    Angle getAngle() const override {
+        if (!angle_) angle_ = Angle::fromString(entity_->getProperty("angle"));
+        return *angle_;
+    }
+
+    void setAngle(const Angle& newAngle) override {
+        angle_ = newAngle;
+        angleDirty_ = true;
+    }
+
+    Angle getAngularVelocity() const override {
+        if (!angularVelocity_) angularVelocity_ = Angle::fromString(entity_->getProperty("angular_velocity"));
+        return *angularVelocity_;
+    }
+
+    std::pair<Angle, Angle> getRotation() const override {
+        if (!angle_ && !angularVelocity_) {
+            static constexpr std::array<std::string_view, 2> keys{"angle", "angular_velocity"};
+            std::array<std::string, 2> values;
+            entity_->getProperties(keys, values);
+            angle_ = Angle::fromString(values[0]);
+            angularVelocity_ = Angle::fromString(values[1]);
+        }
+        return {getAngle(), getAngularVelocity()};
+    }
+
+    // the cached values stand for the entity's properties
+    const void* accessKey() const noexcept override { return entity_; }
+
+    bool Dirty() const noexcept { return locationDirty_ || angleDirty_; }
+
+    // writes the changed properties back, the cached values stay valid
+    void Flush() {
+        if (locationDirty_) {
+            entity_->setProperty("location", location_->toString());
+            locationDirty_ = false;
+        }
+        if (angleDirty_) {
+            entity_->setProperty("angle", angle_->toString());
+            angleDirty_ = false;
+        }
+    }
+
+    // forgets the cached values, unflushed writes are lost
+    void Reset() noexcept {
+        location_.reset();
+        velocity_.reset();
+        angle_.reset();
+        angularVelocity_.reset();
+        locationDirty_ = angleDirty_ = false;
+    }
+
+private:
+    IEntity* entity_;
+    // filled by the const getters
+    mutable std::optional<BasicPoint<T>> location_;
+    mutable std::optional<BasicVector<T>> velocity_;
+    mutable std::optional<Angle> angle_;
+    mutable std::optional<Angle> angularVelocity_;
+    bool locationDirty_{false};
+    bool angleDirty_{false};
+};
+
+using CachingAdapter = BasicCachingAdapter<int>;
+
+}  // namespace game
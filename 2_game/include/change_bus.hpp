@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "primitives.hpp"
+
+namespace game {
+
+struct PropertyChange {
+    const IEntity* entity;
+    // the entity's own key, it must outlive the dispatch
+    std::string_view key;
+    std::string value;
+};
+
+// Observers of entity property changes. Entities report a change with Record(), which
+// keeps it in a buffer of the recording thread, and Dispatch() hands the changes of all
+// threads to the subscribers at once, e.g. after every command batch. Subscribers choose
+// a property key and optionally a predicate. Without subscribers Record() is not called
+// at all and with them only changes of subscribed keys are kept.
+// Record() does not lock, so Subscribe(), Unsubscribe() and Dispatch() must not run while
+// other threads record; handlers run inside Dispatch() and may do both.
+class ChangeBus {
+public:
+    using Predicate = std::function<bool(const PropertyChange&)>;
+    using Handler = std::function<void(const PropertyChange&)>;
+    using SubscriptionId = std::uint64_t;
+
+    static SubscriptionId Subscribe(std::string_view key, Handler handler, Predicate predicate = {}) {
+        auto subscriber = std::make_shared<Subscriber>(
+            Subscriber{++lastId_, std::string{key}, std::move(handler), std::move(predicate), true});
+        subscribers_.push_back(subscriber);
+        enabled_.store(true, std::memory_order_relaxed);
+        return subscriber->id;
+    }
+
+    static void Unsubscribe(SubscriptionId id) {
+        std::erase_if(subscribers_, [id](const auto& subscriber) {
+            if (subscriber->id != id) return false;
+            // a dispatch in progress holds a copy of the list
+            subscriber->active = false;
+            return true;
+        });
+        enabled_.store(!subscribers_.empty(), std::memory_order_relaxed);
+    }
+
+    static bool Enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+    static void Record(const IEntity& entity, std::string_view key, std::string_view value) {
+        for (const auto& subscriber: subscribers_) {
+            if (subscriber->key != key) continue;
+            Local().events.push_back({&entity, key, std::string{value}});
+            return;
+        }
+    }
+
+    // delivers the changes in the order of every thread, returns the number of delivered ones
+    static std::size_t Dispatch() {
+        std::vector<PropertyChange> batch;
+        {
+            std::lock_guard lock{buffersMtx_};
+            batch.swap(orphans_);
+            for (auto* buffer: buffers_) {
+                // the buffers keep their capacity for the next batch
+                batch.insert(std::end(batch), std::make_move_iterator(std::begin(buffer->events)),
+                    std::make_move_iterator(std::end(buffer->events)));
+                buffer->events.clear();
+            }
+        }
+
+        std::size_t delivered{0};
+        const auto subscribers = subscribers_;
+        for (const auto& change: batch) {
+            for (const auto& subscriber: subscribers) {
+                if (!subscriber->active || subscriber->key != change.key) continue;
+                if (subscriber->predicate && !subscriber->predicate(change)) continue;
+                subscriber->handler(change);
+                ++delivered;
+            }
+        }
+        return delivered;
+    }
+
+private:
+    struct Subscriber {
+        SubscriptionId id;
+        std::string key;
+        Handler handler;
+        Predicate predicate;
+        bool active;
+    };
+
+    struct Buffer {
+        Buffer() {
+            std::lock_guard lock{buffersMtx_};
+            buffers_.push_back(this);
+        }
+        ~Buffer() {
+            // changes of a finished thread are delivered with the next batch
+            std::lock_guard lock{buffersMtx_};
+            std::move(std::begin(events), std::end(events), std::back_inserter(orphans_));
+            std::erase(buffers_, this);
+        }
+        std::vector<PropertyChange> events;
+    };
+
+    static Buffer& Local() {
+        thread_local Buffer buffer;
+        return buffer;
+    }
+
+    static inline std::atomic<bool> enabled_{false};
+    static inline SubscriptionId lastId_{0};
+    static inline std::vector<std::shared_ptr<Subscriber>> subscribers_;
+
+    static inline std::mutex buffersMtx_;
+    static inline std::vector<Buffer*> buffers_;
+    static inline std::vector<PropertyChange> orphans_;
+};
+
+}  // namespace game
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace game {
+
+// Q16.16 signed fixed-point number: 16 integer bits, 16 fraction bits.
+// Values outside [-32768, 32768) saturate to the nearest bound instead of wrapping,
+// conversions and arithmetic are done in 64 bits first; NaN converts to zero.
+class Fixed16 {
+public:
+    static constexpr int fractionBits = 16;
+    static constexpr std::int32_t one = std::int32_t{1} << fractionBits;
+
+    constexpr Fixed16() = default;
+    constexpr explicit Fixed16(int val)
+    : raw_{saturate(std::int64_t{val} * one)} {}
+
+    static constexpr Fixed16 fromRaw(std::int32_t raw) {
+        Fixed16 res;
+        res.raw_ = raw;
+        return res;
+    }
+
+    static Fixed16 fromDouble(double val) {
+        if (std::isnan(val)) return Fixed16{};
+        const double scaled = val * one;
+        if (scaled >= static_cast<double>(max)) return fromRaw(max);
+        if (scaled <= static_cast<double>(min)) return fromRaw(min);
+        return fromRaw(static_cast<std::int32_t>(std::llround(scaled)));
+    }
+
+    constexpr double toDouble() const {
+        return static_cast<double>(raw_) / one;
+    }
+
+    constexpr std::int32_t raw() const { return raw_; }
+
+    constexpr Fixed16& operator+=(Fixed16 rhs) {
+        raw_ = saturate(std::int64_t{raw_} + rhs.raw_);
+        return *this;
+    }
+
+    constexpr Fixed16& operator-=(Fixed16 rhs) {
+        raw_ = saturate(std::int64_t{raw_} - rhs.raw_);
+        return *this;
+    }
+
+    friend constexpr Fixed16 operator+(Fixed16 lhs, Fixed16 rhs) { return lhs += rhs; }
+    friend constexpr Fixed16 operator-(Fixed16 lhs, Fixed16 rhs) { return lhs -= rhs; }
+
+    auto operator<=>(const Fixed16&) const = default;
+
+private:
+    static constexpr std::int32_t min = std::numeric_limits<std::int32_t>::min();
+    static constexpr std::int32_t max = std::numeric_limits<std::int32_t>::max();
+
+    static constexpr std::int32_t saturate(std::int64_t val) {
+        if (val > max) return max;
+        if (val < min) return min;
+        return static_cast<std::int32_t>(val);
+    }
+
+    std::int32_t raw_{0};
+};
+
+// Conversions every coordinate representation has to provide:
+// string (de)serialization for IEntity properties and double for trigonometry,
+// maxLength bounds the length of toString() for fixed size property storage
+template<typename T>
+struct CoordinateTraits;
+
+template<>
+struct CoordinateTraits<int> {
+    static constexpr std::size_t maxLength{11};  // -2147483648
+
+    static std::string toString(int val) { return std::format("{}", val); }
+
+    static bool fromString(std::string_view str, int& val) {
+        auto [_, ec] = std::from_chars(str.data(), str.data() + str.size(), val);
+        return ec == std::errc{};
+    }
+
+    static double toDouble(int val) { return static_cast<double>(val); }
+
+    // saturates like Fixed16, NaN converts to zero
+    static int fromDouble(double val) {
+        if (std::isnan(val)) return 0;
+        if (val >= static_cast<double>(max)) return max;
+        if (val <= static_cast<double>(min)) return min;
+        return static_cast<int>(std::lround(val));
+    }
+
+private:
+    static constexpr int min = std::numeric_limits<int>::min();
+    static constexpr int max = std::numeric_limits<int>::max();
+};
+
+template<typename TFloat>
+struct FloatingCoordinateTraits {
+    // shortest representation that round-trips, so no precision is lost in the property store
+    static std::string toString(TFloat val) { return std::format("{}", val); }
+
+    static bool fromString(std::string_view str, TFloat& val) {
+        auto [_, ec] = std::from_chars(str.data(), str.data() + str.size(), val);
+        return ec == std::errc{};
+    }
+
+    static double toDouble(TFloat val) { return static_cast<double>(val); }
+    static TFloat fromDouble(double val) { return static_cast<TFloat>(val); }
+};
+
+template<> struct CoordinateTraits<float> : FloatingCoordinateTraits<float> {
+    static constexpr std::size_t maxLength{15};  // -1.17549435e-38
+};
+template<> struct CoordinateTraits<double> : FloatingCoordinateTraits<double> {
+    static constexpr std::size_t maxLength{24};  // -2.2250738585072014e-308
+};
+
+template<>
+struct CoordinateTraits<Fixed16> {
+    static constexpr std::size_t maxLength{CoordinateTraits<double>::maxLength};
+
+    // every Q16.16 value is exactly representable as double
+    static std::string toString(Fixed16 val) { return std::format("{}", val.toDouble()); }
+
+    static bool fromString(std::string_view str, Fixed16& val) {
+        double parsed;
+        auto [_, ec] = std::from_chars(str.data(), str.data() + str.size(), parsed);
+        if (ec != std::errc{} || std::isnan(parsed)) return false;
+        val = Fixed16::fromDouble(parsed);
+        return true;
+    }
+
+    static double toDouble(Fixed16 val) { return val.toDouble(); }
+    static Fixed16 fromDouble(double val) { return Fixed16::fromDouble(val); }
+};
+
+template<typename T>
+concept Coordinate = requires(T val, std::string_view str, double d) {
+    { CoordinateTraits<T>::toString(val) } -> std::same_as<std::string>;
+    { CoordinateTraits<T>::fromString(str, val) } -> std::same_as<bool>;
+    { CoordinateTraits<T>::toDouble(val) } -> std::same_as<double>;
+    { CoordinateTraits<T>::fromDouble(d) } -> std::same_as<T>;
+    { CoordinateTraits<T>::maxLength } -> std::convertible_to<std::size_t>;
+    { val + val } -> std::convertible_to<T>;
+};
+
+}  // namespace game
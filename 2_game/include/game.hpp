@@ -1,33 +1,41 @@
 #pragma once
 
+#include <atomic>
 #include <charconv>
+#include <cstdint>
 #include <format>
 #include <string_view>
 #include <unordered_map>
 
+#include "change_bus.hpp"
 #include "primitives.hpp"
 
 namespace game {
 
-class Move {
+template<Coordinate T>
+class BasicMove {
 public:
-    explicit Move(IMovingObject* obj)
+    explicit BasicMove(IBasicMovingObject<T>* obj)
     : obj_{obj} {}
 
     void Execute() {
-        obj_->setLocation(obj_->getLocation().MoveTo(obj_->getVelocity()));
+        auto [location, velocity] = obj_->getMotion();
+        obj_->setLocation(location.MoveTo(velocity));
     }
 private:
-    IMovingObject* obj_{nullptr};
+    IBasicMovingObject<T>* obj_{nullptr};
 };
 
+using Move = BasicMove<int>;
+
 class Rotate {
 public:
     explicit Rotate(IRotatingObject* obj) 
     : obj_{obj} {}
 
     void Execute() {
-        obj_->setAngle(obj_->getAngle() + obj_->getAngularVelocity());
+        const auto [angle, angularVelocity] = obj_->getRotation();
+        obj_->setAngle(angle + angularVelocity);
     }
 
 private:
@@ -36,12 +44,18 @@ private:
 
 class SpaceShip : public IEntity {
 public:
+    // bits of the dirty mask
+    static constexpr std::uint8_t locationBit{1 << 0};
+    static constexpr std::uint8_t velocityBit{1 << 1};
+    static constexpr std::uint8_t angleBit{1 << 2};
+    static constexpr std::uint8_t angularVelocityBit{1 << 3};
+
     std::string getProperty(std::string_view key) const override {
         const auto iter = properties_.find(key);
         if (std::end(properties_) == iter) {
             throw std::logic_error(std::format("Unable to find '{}' property in SpaceShip object", key));
         }
-        return iter->second;
+        return iter->second.value;
     }
 
     void setProperty(std::string_view key, std::string_view val) {
@@ -49,16 +63,31 @@ public:
         if (std::end(properties_) == iter) {
             throw std::logic_error(std::format("Unable to set '{}' property in SpaceShip object", key));
         }
-        iter->second = val;
+        // writing the same value again is not a change
+        if (iter->second.value == val) return;
+        iter->second.value = val;
+        // Move and Rotate may write different properties of one ship in parallel
+        dirty_.fetch_or(iter->second.bit, std::memory_order_relaxed);
+        if (ChangeBus::Enabled()) ChangeBus::Record(*this, iter->first, val);
     }
+
+    // properties changed since the last ClearDirty(), e.g. for replication
+    std::uint8_t DirtyMask() const noexcept { return dirty_.load(std::memory_order_relaxed); }
+    void ClearDirty() noexcept { dirty_.store(0, std::memory_order_relaxed); }
    
 private:
-    std::unordered_map<std::string_view, std::string> properties_{
-         {"location", Point{0, 0}.toString()}
-        ,{"velocity", Vector{0, 0}.toString()}
-        ,{"angle", Angle{.rad = 0.}.toString()}
-        ,{"angular_velocity", Angle{.rad = 0.}.toString()}
+    struct Property {
+        std::string value;
+        std::uint8_t bit;
+    };
+
+    std::unordered_map<std::string_view, Property> properties_{
+         {"location", {Point{0, 0}.toString(), locationBit}}
+        ,{"velocity", {Vector{0, 0}.toString(), velocityBit}}
+        ,{"angle", {Angle{.rad = 0.}.toString(), angleBit}}
+        ,{"angular_velocity", {Angle{.rad = 0.}.toString(), angularVelocityBit}}
     };
+    std::atomic<std::uint8_t> dirty_{0};
 };
 
 }  // namespace game
\ No newline at end of file
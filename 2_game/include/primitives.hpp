@@ -1,9 +1,14 @@
 #pragma once
 
+#include <array>
 #include <charconv>
 #include <format>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
+
+#include "coordinates.hpp"
 
 namespace game {
 
@@ -24,91 +29,95 @@ struct Angle {
     }
 }; 
 
-Angle operator+(const Angle& lhs, const Angle& rhs) {
+inline Angle operator+(const Angle& lhs, const Angle& rhs) {
     return Angle{.rad = lhs.rad + rhs.rad};
 }
 
-struct Vector {
-    int x;
-    int y;
+template<Coordinate T>
+struct BasicVector {
+    T x;
+    T y;
 
     std::string toString() const {
-        return std::format("{},{}", x, y);
+        return std::format("{},{}", CoordinateTraits<T>::toString(x), CoordinateTraits<T>::toString(y));
     }
 
-    static Vector fromString(std::string_view str) {
+    static BasicVector fromString(std::string_view str) {
         const auto comma_pos = str.find(',');
         if (std::string_view::npos == comma_pos) {
             throw std::invalid_argument(std::format("Unable to parse Vector object from: '{}'", str));
         }
 
-        int x{-1}, y{-1};
-        
+        T x{}, y{};
+
         auto x_str = str.substr(0, comma_pos);
-        auto [_, x_ec] = std::from_chars(x_str.data(), x_str.data() + x_str.size(), x);
-        if (x_ec != std::errc{}) {
+        if (!CoordinateTraits<T>::fromString(x_str, x)) {
             throw std::invalid_argument(std::format("Unable to parse x val from: '{}'", x_str));
         }
 
         auto y_str = str.substr(comma_pos + 1);
-        auto [y_ptr, y_ec] = std::from_chars(y_str.data(), y_str.data() + y_str.size(), y);
-        if (y_ec != std::errc{}) {
+        if (!CoordinateTraits<T>::fromString(y_str, y)) {
             throw std::invalid_argument(std::format("Unable to parse y val from: '{}'", y_str));
         }
-        return Vector{.x = x, .y = y};
+        return BasicVector{.x = x, .y = y};
     }
 
     bool isZero() const {
-        return 0 == x && y == x;
+        return T{} == x && y == x;
     }
 };
 
-class Point {
+template<Coordinate T>
+class BasicPoint {
 public: 
-    Point(int x, int y)
+    BasicPoint(T x, T y)
     : x_{x}
     , y_{y} {}
 
-    Point& MoveTo(const Vector& v) {
-        x_ += v.x;
-        y_ += v.y;
+    BasicPoint& MoveTo(const BasicVector<T>& v) {
+        x_ = x_ + v.x;
+        y_ = y_ + v.y;
         return *this;
     }
 
-    bool operator==(const Point& other) const {
+    T x() const { return x_; }
+    T y() const { return y_; }
+
+    bool operator==(const BasicPoint& other) const {
         return other.x_ == x_ && other.y_ == y_;
     }
 
     std::string toString() const {
-        return std::format("{},{}", x_, y_);
+        return std::format("{},{}", CoordinateTraits<T>::toString(x_), CoordinateTraits<T>::toString(y_));
     }
 
-    static Point fromString(std::string_view str) {
+    static BasicPoint fromString(std::string_view str) {
         const auto comma_pos = str.find(',');
         if (std::string_view::npos == comma_pos) {
             throw std::invalid_argument(std::format("Unable to parse Point object from string: '{}'", str));
         }
 
-        int x{-1}, y{-1};
-        
+        T x{}, y{};
+
         auto x_str = str.substr(0, comma_pos);
-        auto [_, x_ec] = std::from_chars(x_str.data(), x_str.data() + x_str.size(), x);
-        if (x_ec != std::errc{}) {
+        if (!CoordinateTraits<T>::fromString(x_str, x)) {
             throw std::invalid_argument(std::format("Unable to parse x coordinate from: '{}'", x_str));
         }
 
         auto y_str = str.substr(comma_pos + 1);
-        auto [y_ptr, y_ec] = std::from_chars(y_str.data(), y_str.data() + y_str.size(), y);
-        if (y_ec != std::errc{}) {
+        if (!CoordinateTraits<T>::fromString(y_str, y)) {
             throw std::invalid_argument(std::format("Unable to parse y coordinate from: '{}'", y_str));
         }
-        return Point{x, y};
+        return BasicPoint{x, y};
     }
 private:
-    int x_{0};
-    int y_{0};
+    T x_{};
+    T y_{};
 }; 
 
+using Vector = BasicVector<int>;
+using Point = BasicPoint<int>;
+
 struct IntegerProperty {
     int val;
 
@@ -148,20 +157,36 @@ inline bool operator==(const IntegerProperty& lhs, int rhs) noexcept {return lhs
 inline bool operator==(int lhs, const IntegerProperty& rhs) noexcept {return lhs == rhs.val;}
 
 
-class IMovingObject {
+template<Coordinate T>
+class IBasicMovingObject {
 public:
-    virtual Point getLocation() const = 0;
-    virtual void setLocation(const Point&) = 0;
-    virtual Vector getVelocity() const = 0;
+    virtual BasicPoint<T> getLocation() const = 0;
+    virtual void setLocation(const BasicPoint<T>&) = 0;
+    virtual BasicVector<T> getVelocity() const = 0;
+    // location and velocity as of one moment, for objects shared between threads
+    virtual std::pair<BasicPoint<T>, BasicVector<T>> getMotion() const {
+        return {getLocation(), getVelocity()};
+    }
+    // identity of the state behind the object, e.g. its entity, so that commands going through
+    // different adapters of one entity are seen to conflict; nullptr when it cannot tell
+    virtual const void* accessKey() const noexcept { return nullptr; }
 
-    virtual ~IMovingObject() = default;
+    virtual ~IBasicMovingObject() = default;
 };
 
+using IMovingObject = IBasicMovingObject<int>;
+
 class IRotatingObject {
 public:
     virtual Angle getAngle() const = 0;
     virtual void setAngle(const Angle&) = 0;
     virtual Angle getAngularVelocity() const = 0;
+    // angle and angular velocity as of one moment, for objects shared between threads
+    virtual std::pair<Angle, Angle> getRotation() const {
+        return {getAngle(), getAngularVelocity()};
+    }
+    // see IBasicMovingObject::accessKey()
+    virtual const void* accessKey() const noexcept { return nullptr; }
 
     virtual ~IRotatingObject() = default;
 };
@@ -170,30 +195,49 @@ class IEntity {
 public:
     virtual std::string getProperty(std::string_view key) const = 0;
     virtual void setProperty(std::string_view key, std::string_view val) = 0;
+    // Reads keys[i] into values[i]. An entity that is safe to share between threads reads
+    // them all as of one moment, the default reads them one after another.
+    virtual void getProperties(std::span<const std::string_view> keys, std::span<std::string> values) const {
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            values[i] = getProperty(keys[i]);
+        }
+    }
     virtual ~IEntity() = default;
 };
 
-class MovingObjectAdapter : public IMovingObject {
+template<Coordinate T>
+class BasicMovingObjectAdapter : public IBasicMovingObject<T> {
 public:
-    explicit MovingObjectAdapter(IEntity* entity)
+    explicit BasicMovingObjectAdapter(IEntity* entity)
     : entity_{entity} {}
 
-    Point getLocation() const override {
-        return Point::fromString(entity_->getProperty("location"));
+    BasicPoint<T> getLocation() const override {
+        return BasicPoint<T>::fromString(entity_->getProperty("location"));
     }
 
-    void setLocation(const Point& newLocation) {
+    void setLocation(const BasicPoint<T>& newLocation) override {
         entity_->setProperty("location", newLocation.toString());
     }
 
-    Vector getVelocity() const {
-        return Vector::fromString(entity_->getProperty("velocity"));
+    BasicVector<T> getVelocity() const override {
+        return BasicVector<T>::fromString(entity_->getProperty("velocity"));
+    }
+
+    std::pair<BasicPoint<T>, BasicVector<T>> getMotion() const override {
+        static constexpr std::array<std::string_view, 2> keys{"location", "velocity"};
+        std::array<std::string, 2> values;
+        entity_->getProperties(keys, values);
+        return {BasicPoint<T>::fromString(values[0]), BasicVector<T>::fromString(values[1])};
     }
 
+    const void* accessKey() const noexcept override { return entity_; }
+
 private:
     IEntity* entity_;
 };
 
+using MovingObjectAdapter = BasicMovingObjectAdapter<int>;
+
 class RotatingObjectAdapter : public IRotatingObject {
 public:
     explicit RotatingObjectAdapter(IEntity* entity)
@@ -211,6 +255,15 @@ public:
         return Angle::fromString(entity_->getProperty("angular_velocity"));
     }
 
+    std::pair<Angle, Angle> getRotation() const override {
+        static constexpr std::array<std::string_view, 2> keys{"angle", "angular_velocity"};
+        std::array<std::string, 2> values;
+        entity_->getProperties(keys, values);
+        return {Angle::fromString(values[0]), Angle::fromString(values[1])};
+    }
+
+    const void* accessKey() const noexcept override { return entity_; }
+
 private:
     IEntity* entity_;
 };
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "primitives.hpp"
+
+namespace game {
+
+// IEntity that many threads may read and write at once. Property values live inline in
+// atomic words guarded by a sequence counter: a writer makes the counter odd, stores the
+// words and makes it even again, a reader copies the words and retries if the counter
+// moved meanwhile. Readers never write shared memory, so they do not slow each other down.
+// The values are stored inline and each entity starts on its own cache line, so
+// neighbours in an array do not share one. The slots are sized for a point or vector of T.
+template<Coordinate T>
+class alignas(64) BasicSeqlockEntity : public IEntity {
+public:
+    // longest value a property can hold, at least two coordinates and a comma;
+    // one more byte keeps the size and the slot is a whole number of words
+    static constexpr std::size_t maxValueSize{
+        (std::max<std::size_t>(31, 2 * CoordinateTraits<T>::maxLength + 1) + sizeof(std::uint64_t))
+        / sizeof(std::uint64_t) * sizeof(std::uint64_t) - 1};
+    static constexpr std::size_t maxProperties{8};
+
+    BasicSeqlockEntity()
+    : BasicSeqlockEntity({
+         {"location", BasicPoint<T>{T{}, T{}}.toString()}
+        ,{"velocity", BasicVector<T>{T{}, T{}}.toString()}
+        ,{"angle", Angle{.rad = 0.}.toString()}
+        ,{"angular_velocity", Angle{.rad = 0.}.toString()}
+    }) {}
+
+    // the keys must outlive the entity
+    explicit BasicSeqlockEntity(std::initializer_list<std::pair<std::string_view, std::string>> properties) {
+        if (properties.size() > maxProperties) {
+            throw std::length_error(std::format("SeqlockEntity holds at most {} properties", maxProperties));
+        }
+        for (const auto& [key, val]: properties) {
+            if (val.size() > maxValueSize) ThrowTooLong(key, val);
+            keys_[size_] = key;
+            Store(values_[size_++], val);
+        }
+    }
+
+    std::string getProperty(std::string_view key) const override {
+        const auto idx = Index(key, "find");
+        Bytes bytes;
+        Read([&] { Load(values_[idx], bytes); });
+        return ToString(bytes);
+    }
+
+    void setProperty(std::string_view key, std::string_view val) override {
+        const auto idx = Index(key, "set");
+        if (val.size() > maxValueSize) ThrowTooLong(key, val);
+        Write([&] { Store(values_[idx], val); });
+    }
+
+    void getProperties(std::span<const std::string_view> keys, std::span<std::string> values) const override {
+        std::array<std::size_t, maxProperties> idx;
+        if (keys.size() > idx.size()) {
+            IEntity::getProperties(keys, values);
+            return;
+        }
+        for (std::size_t i = 0; i < keys.size(); ++i) idx[i] = Index(keys[i], "find");
+
+        std::array<Bytes, maxProperties> bytes;
+        Read([&] {
+            for (std::size_t i = 0; i < keys.size(); ++i) Load(values_[idx[i]], bytes[i]);
+        });
+        for (std::size_t i = 0; i < keys.size(); ++i) values[i] = ToString(bytes[i]);
+    }
+
+private:
+    static constexpr std::size_t words{(maxValueSize + 1) / sizeof(std::uint64_t)};
+
+    // the first byte is the size
+    using Bytes = std::array<char, words * sizeof(std::uint64_t)>;
+    using Value = std::array<std::atomic<std::uint64_t>, words>;
+
+    std::size_t Index(std::string_view key, const char* action) const {
+        for (std::size_t idx = 0; idx < size_; ++idx) {
+            if (keys_[idx] == key) return idx;
+        }
+        throw std::logic_error(std::format("Unable to {} '{}' property in SeqlockEntity object", action, key));
+    }
+
+    template<typename TFunc>
+    void Read(TFunc&& load) const {
+        for (;;) {
+            const auto before = seq_.load(std::memory_order_acquire);
+            if (before % 2 == 0) {
+                load();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) == before) return;
+            }
+            // the writer may have been preempted inside its section
+            std::this_thread::yield();
+        }
+    }
+
+    template<typename TFunc>
+    void Write(TFunc&& store) {
+        auto seq = seq_.load(std::memory_order_relaxed);
+        while (seq % 2 != 0 || !seq_.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+            std::this_thread::yield();
+            seq = seq_.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        store();
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    static void Load(const Value& value, Bytes& bytes) {
+        for (std::size_t w = 0; w < words; ++w) {
+            const auto word = value[w].load(std::memory_order_relaxed);
+            std::memcpy(bytes.data() + w * sizeof(word), &word, sizeof(word));
+        }
+    }
+
+    [[noreturn]] static void ThrowTooLong(std::string_view key, std::string_view val) {
+        throw std::length_error(std::format("Value of '{}' property is longer than {} chars: '{}'", key, maxValueSize, val));
+    }
+
+    static void Store(Value& value, std::string_view val) {
+        Bytes bytes{};
+        bytes[0] = static_cast<char>(val.size());
+        std::memcpy(bytes.data() + 1, val.data(), val.size());
+        for (std::size_t w = 0; w < words; ++w) {
+            std::uint64_t word;
+            std::memcpy(&word, bytes.data() + w * sizeof(word), sizeof(word));
+            value[w].store(word, std::memory_order_relaxed);
+        }
+    }
+
+    static std::string ToString(const Bytes& bytes) {
+        return std::string(bytes.data() + 1, static_cast<unsigned char>(bytes[0]));
+    }
+
+    std::atomic<std::uint32_t> seq_{0};
+    std::size_t size_{0};
+    std::array<std::string_view, maxProperties> keys_{};
+    std::array<Value, maxProperties> values_{};
+};
+
+using SeqlockEntity = BasicSeqlockEntity<int>;
+
+}  // namespace game
@@ -1,5 +1,14 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <caching_adapter.hpp>
+#include <change_bus.hpp>
 #include <game.hpp>
+#include <seqlock_entity.hpp>
 
 TEST(GameTest, BasicMovement) {
     game::SpaceShip ship;
@@ -51,3 +60,248 @@ TEST(GameTest, UnableToGetSetBadProperties) {
         FAIL() << "logic_error expected";
     }
 }
+
+
+TEST(GameTest, DirtyMaskTracksChangedProperties) {
+    game::SpaceShip ship;
+    EXPECT_EQ(0, ship.DirtyMask());
+
+    ship.setProperty("location", game::Point{0, 0}.toString());
+    EXPECT_EQ(0, ship.DirtyMask());
+
+    ship.setProperty("location", game::Point{1, 2}.toString());
+    ship.setProperty("angle", game::Angle{.rad = 1.}.toString());
+    EXPECT_EQ(game::SpaceShip::locationBit | game::SpaceShip::angleBit, ship.DirtyMask());
+
+    ship.ClearDirty();
+    EXPECT_EQ(0, ship.DirtyMask());
+}
+
+TEST(CoordinatesTest, Fixed16RoundTrip) {
+    const auto val = game::Fixed16::fromDouble(-3.25);
+    EXPECT_EQ(val.raw(), -3 * game::Fixed16::one - game::Fixed16::one / 4);
+    EXPECT_EQ(val.toDouble(), -3.25);
+
+    const auto point = game::BasicPoint<game::Fixed16>::fromString("1.5,-0.0001");
+    EXPECT_EQ(point, game::BasicPoint<game::Fixed16>::fromString(point.toString()));
+    EXPECT_NEAR(point.y().toDouble(), -0.0001, 1. / game::Fixed16::one);
+}
+
+TEST(CoordinatesTest, Fixed16Saturates) {
+    constexpr auto maxRaw = std::numeric_limits<std::int32_t>::max();
+    constexpr auto minRaw = std::numeric_limits<std::int32_t>::min();
+    EXPECT_EQ(maxRaw, game::Fixed16{40000}.raw());
+    EXPECT_EQ(minRaw, game::Fixed16{-40000}.raw());
+    EXPECT_EQ(maxRaw, (game::Fixed16{30000} + game::Fixed16{30000}).raw());
+    EXPECT_EQ(minRaw, (game::Fixed16{-30000} - game::Fixed16{30000}).raw());
+    EXPECT_EQ(maxRaw, game::Fixed16::fromDouble(1e300).raw());
+    EXPECT_EQ(minRaw, game::Fixed16::fromDouble(-1e300).raw());
+    EXPECT_EQ(0, game::Fixed16::fromDouble(std::nan("")).raw());
+
+    game::Fixed16 parsed;
+    EXPECT_FALSE(game::CoordinateTraits<game::Fixed16>::fromString("nan", parsed));
+}
+
+TEST(CoordinatesTest, IntFromDoubleSaturates) {
+    using Traits = game::CoordinateTraits<int>;
+    EXPECT_EQ(std::numeric_limits<int>::max(), Traits::fromDouble(1e300));
+    EXPECT_EQ(std::numeric_limits<int>::min(), Traits::fromDouble(-1e300));
+    EXPECT_EQ(std::numeric_limits<int>::max(), Traits::fromDouble(2147483647.4));
+    EXPECT_EQ(std::numeric_limits<int>::min(), Traits::fromDouble(-2147483648.6));
+    EXPECT_EQ(0, Traits::fromDouble(std::nan("")));
+    EXPECT_EQ(-3, Traits::fromDouble(-2.5));
+}
+
+TEST(CoordinatesTest, DoubleRoundTripIsExact) {
+    const game::BasicVector<double> v{.x = 0.1, .y = 1. / 3.};
+    const auto parsed = game::BasicVector<double>::fromString(v.toString());
+    EXPECT_EQ(parsed.x, v.x);
+    EXPECT_EQ(parsed.y, v.y);
+}
+
+template<typename T>
+class TypedMovementTest : public ::testing::Test {};
+
+using CoordinateTypes = ::testing::Types<int, game::Fixed16, float, double>;
+TYPED_TEST_SUITE(TypedMovementTest, CoordinateTypes);
+
+TYPED_TEST(TypedMovementTest, BasicMovement) {
+    game::SpaceShip ship;
+    ship.setProperty("location", "12,5");
+    ship.setProperty("velocity", "-7,3");
+
+    game::BasicMovingObjectAdapter<TypeParam> moa{&ship};
+    game::BasicMove<TypeParam> moveCommand{&moa};
+
+    EXPECT_NO_THROW(moveCommand.Execute());
+    EXPECT_EQ(moa.getLocation(), game::BasicPoint<TypeParam>::fromString("5,8"));
+}
+
+TEST(CoordinatesTest, UnableToParseBadCoordinates) {
+    EXPECT_THROW(game::BasicPoint<double>::fromString("1.5"), std::invalid_argument);
+    EXPECT_THROW(game::BasicPoint<game::Fixed16>::fromString("a,1"), std::invalid_argument);
+    EXPECT_THROW(game::BasicVector<float>::fromString("1,b"), std::invalid_argument);
+}
+
+TEST(SeqlockEntityTest, BehavesLikeSpaceShip) {
+    game::SeqlockEntity ship;
+    ship.setProperty("location", game::Point{12, 5}.toString());
+    ship.setProperty("velocity", game::Vector{-7, 3}.toString());
+
+    game::MovingObjectAdapter moa{&ship};
+    game::Move{&moa}.Execute();
+    EXPECT_EQ(game::Point(5, 8), moa.getLocation());
+
+    EXPECT_THROW(ship.getProperty("bad_location"), std::logic_error);
+    EXPECT_THROW(ship.setProperty("bad_location", "0"), std::logic_error);
+    EXPECT_THROW(ship.setProperty("location", std::string(game::SeqlockEntity::maxValueSize + 1, '1')), std::length_error);
+    EXPECT_EQ(game::Point(5, 8), moa.getLocation());
+}
+
+TEST(SeqlockEntityTest, HoldsDoubleCoordinates) {
+    game::BasicSeqlockEntity<double> ship;
+    const game::BasicPoint<double> location{-2.2250738585072014e-308, 0.1 + 0.2};
+    const game::BasicVector<double> velocity{-1.7976931348623157e308, -4.9406564584124654e-324};
+    ship.setProperty("location", location.toString());
+    ship.setProperty("velocity", velocity.toString());
+
+    game::BasicMovingObjectAdapter<double> moa{&ship};
+    EXPECT_EQ(location, moa.getLocation());
+    EXPECT_EQ(velocity.toString(), moa.getVelocity().toString());
+    EXPECT_GT(location.toString().size(), game::SeqlockEntity::maxValueSize);
+}
+
+TEST(SeqlockEntityTest, MotionIsReadAsOfOneMoment) {
+    game::SeqlockEntity ship;
+    game::MovingObjectAdapter moa{&ship};
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+
+    std::vector<std::jthread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                // the writer keeps the location one step ahead of the velocity or equal to it
+                const auto [location, velocity] = moa.getMotion();
+                const auto lead = location.x() - velocity.x;
+                if (lead != 0 && lead != 1) ++torn;
+            }
+        });
+    }
+    for (int i = 1; i <= 20'000; ++i) {
+        moa.setLocation(game::Point{i, i});
+        ship.setProperty("velocity", game::Vector{i, i}.toString());
+    }
+    done = true;
+    readers.clear();
+    EXPECT_EQ(0, torn.load());
+}
+
+namespace test {
+
+class CountingShip : public game::SpaceShip {
+public:
+    std::string getProperty(std::string_view key) const override {
+        ++gets;
+        return game::SpaceShip::getProperty(key);
+    }
+    void setProperty(std::string_view key, std::string_view val) override {
+        ++sets;
+        game::SpaceShip::setProperty(key, val);
+    }
+
+    mutable int gets{0};
+    int sets{0};
+};
+
+}  // namespace test
+
+TEST(CachingAdapterTest, ParsesOnceAndWritesBackOnFlush) {
+    test::CountingShip ship;
+    ship.setProperty("velocity", game::Vector{1, 2}.toString());
+    ship.setProperty("angular_velocity", game::Angle{.rad = 0.25}.toString());
+    ship.sets = 0;
+
+    game::CachingAdapter cache{&ship};
+    for (int i = 0; i < 3; ++i) {
+        game::Move{&cache}.Execute();
+        game::Rotate{&cache}.Execute();
+    }
+    EXPECT_EQ(4, ship.gets);
+    EXPECT_EQ(0, ship.sets);
+    EXPECT_TRUE(cache.Dirty());
+    EXPECT_EQ(game::Point(0, 0).toString(), ship.getProperty("location"));
+
+    cache.Flush();
+    EXPECT_FALSE(cache.Dirty());
+    EXPECT_EQ(2, ship.sets);
+    EXPECT_EQ(game::Point(3, 6).toString(), ship.getProperty("location"));
+    EXPECT_EQ(game::Angle{.rad = 0.75}.toString(), ship.getProperty("angle"));
+
+    // a direct write is seen after Reset()
+    ship.setProperty("location", game::Point{-1, -1}.toString());
+    EXPECT_EQ(game::Point(3, 6), cache.getLocation());
+    cache.Reset();
+    EXPECT_EQ(game::Point(-1, -1), cache.getLocation());
+}
+
+TEST(ChangeBusTest, DispatchesFilteredChangesInBatches) {
+    game::SpaceShip ship;
+    ship.setProperty("location", game::Point{20, 0}.toString());
+    // nobody listened
+    EXPECT_EQ(0, game::ChangeBus::Dispatch());
+
+    std::vector<std::string> far;
+    const auto id = game::ChangeBus::Subscribe("location",
+        [&far](const game::PropertyChange& change) { far.push_back(change.value); },
+        [](const game::PropertyChange& change) { return game::Point::fromString(change.value).x() > 10; });
+
+    constexpr int threads{4};
+    std::vector<game::SpaceShip> ships(threads);
+    {
+        std::vector<std::jthread> writers;
+        for (int t = 0; t < threads; ++t) {
+            writers.emplace_back([&ship = ships[t], t] {
+                for (int x = 0; x <= 20; ++x) ship.setProperty("location", game::Point{x, t}.toString());
+                ship.setProperty("angle", game::Angle{.rad = 1.}.toString());
+            });
+        }
+    }
+    EXPECT_TRUE(far.empty());
+
+    EXPECT_EQ(threads * 10, game::ChangeBus::Dispatch());
+    ASSERT_EQ(threads * 10, far.size());
+    EXPECT_EQ(0, game::ChangeBus::Dispatch());
+
+    game::ChangeBus::Unsubscribe(id);
+    EXPECT_FALSE(game::ChangeBus::Enabled());
+    ship.setProperty("location", game::Point{30, 0}.toString());
+    EXPECT_EQ(0, game::ChangeBus::Dispatch());
+    EXPECT_EQ(threads * 10, far.size());
+}
+
+TEST(ChangeBusTest, HandlersMayChangeSubscriptions) {
+    game::SpaceShip ship;
+    int first{0};
+    int second{0};
+    game::ChangeBus::SubscriptionId secondId{0};
+    const auto firstId = game::ChangeBus::Subscribe("angle", [&](const game::PropertyChange&) {
+        ++first;
+        if (0 == secondId) {
+            secondId = game::ChangeBus::Subscribe("angle", [&](const game::PropertyChange&) { ++second; });
+        }
+        // seen by the next batch
+        ship.setProperty("angle", game::Angle{.rad = first + 1.}.toString());
+    });
+
+    ship.setProperty("angle", game::Angle{.rad = 1.}.toString());
+    EXPECT_EQ(1, game::ChangeBus::Dispatch());
+    EXPECT_EQ(2, game::ChangeBus::Dispatch());
+    EXPECT_EQ(2, first);
+    EXPECT_EQ(1, second);
+
+    game::ChangeBus::Unsubscribe(firstId);
+    game::ChangeBus::Unsubscribe(secondId);
+    game::ChangeBus::Dispatch();
+    EXPECT_FALSE(game::ChangeBus::Enabled());
+}
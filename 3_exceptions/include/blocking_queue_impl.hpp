@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+#include <vector>
+
+#include "command_interface.hpp"
+#include "futex.hpp"
+#include "queue_interface.hpp"
+
+namespace exceptions {
+
+// IQueue fed by any number of threads and drained by one consumer thread.
+// Producers append to an inbox under a short lock; the consumer swaps the whole inbox
+// out once its local batch is drained, so it takes the lock once per batch, not per command.
+// Push wakes a parked consumer with a futex and skips the syscall while it is running.
+// Front(), Pop() and Park() belong to the consumer thread.
+class BlockingQueue : public IQueue {
+public:
+    void Push(ICommandUPtr cmd) override {
+        {
+            std::lock_guard lock{mtx_};
+            inbox_.push_back(std::move(cmd));
+        }
+        size_.fetch_add(1, std::memory_order_relaxed);
+        signal_.fetch_add(1, std::memory_order_relaxed);
+        // pairs with the fence in Park(): either we see the consumer parked or it sees the command
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed)) futex::WakeOne(signal_);
+    }
+
+    void Pop() override {
+        assert(next_ < local_.size());
+        local_[next_++].reset();
+        size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    ICommandUPtr Take() override {
+        if (next_ == local_.size()) Refill();
+        assert(next_ < local_.size());
+        auto cmd = std::move(local_[next_++]);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return cmd;
+    }
+
+    const ICommandUPtr& Front() const noexcept override {
+        if (next_ == local_.size()) Refill();
+        assert(next_ < local_.size());
+        return local_[next_];
+    }
+
+    bool IsEmpty() const noexcept override { return 0 == size_.load(std::memory_order_relaxed); }
+    std::size_t Size() const noexcept override { return size_.load(std::memory_order_relaxed); }
+
+    // Blocks the consumer until a command is pushed, stop is requested, Wake() is called
+    // or the timeout expires. Spurious returns are possible.
+    void Park(const std::stop_token& stop, std::chrono::nanoseconds timeout) noexcept {
+        const auto seq = signal_.load(std::memory_order_relaxed);
+        parked_.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // a stop requested after this check bumps signal_ through Wake()
+        if (IsEmpty() && !stop.stop_requested()) {
+            futex::Wait(signal_, seq, timeout);
+        }
+        parked_.store(0, std::memory_order_relaxed);
+    }
+
+    // ends the current or the next Park()
+    void Wake() noexcept {
+        signal_.fetch_add(1, std::memory_order_relaxed);
+        futex::WakeAll(signal_);
+    }
+
+private:
+    void Refill() const noexcept {
+        local_.clear();
+        next_ = 0;
+        std::lock_guard lock{mtx_};
+        local_.swap(inbox_);
+    }
+
+    mutable std::mutex mtx_;
+    // both vectors keep their capacity, the steady state allocates nothing
+    mutable std::vector<ICommandUPtr> inbox_;
+    // Front() is const for cmd_loop, taking the next batch is not
+    mutable std::vector<ICommandUPtr> local_;
+    mutable std::size_t next_{0};
+    std::atomic<std::size_t> size_{0};
+    std::atomic<std::uint32_t> signal_{0};  // futex word, bumped by every Push() and Wake()
+    std::atomic<std::uint32_t> parked_{0};
+};
+
+}; // namespace exceptions
@@ -1,22 +1,131 @@
 #pragma once
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <stop_token>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "blocking_queue_impl.hpp"
 #include "command_impl.hpp"
 #include "exceptions_impl.hpp"
+#include "loop_metrics.hpp"
 #include "queue_interface.hpp"
+#include "tracer.hpp"
 
 namespace exceptions::cmd_loop {
 
-void run(IQueue& queue) {
-    while(!queue.IsEmpty()) {
+namespace detail {
+
+inline void handle(const ICommandUPtr& cmd, const IException& e) {
+    if (trace::Enabled()) {
+        const trace::Span span{trace::Category::Handler, typeid(e)};
+        ExceptionHandler::Handle(cmd, e)->Execute();
+        return;
+    }
+    ExceptionHandler::Handle(cmd, e)->Execute();
+}
+
+// A sampled command: its type slot, latency and the queue depth behind it. Out of line,
+// so the loop around the unsampled ones stays as small as the uninstrumented one.
+void execute_sampled(const ICommandUPtr& front, const IQueue& queue, metrics::ThreadMetrics& local);
+
+// Unsampled commands share the uninstrumented path, metrics only count them and their failures
+template<bool Instrumented>
+inline void execute(const ICommandUPtr& front, const IQueue& queue, [[maybe_unused]] metrics::ThreadMetrics* local) {
+    if constexpr (Instrumented) {
+        if (local->Count()) [[unlikely]] {
+            execute_sampled(front, queue, *local);
+            return;
+        }
+    }
+    try {
+        front->Execute();
+    } catch (const IException& e) {
+        if constexpr (Instrumented) {
+            local->Failed(typeid(*front), typeid(e));
+        }
+        handle(front, e);
+    }
+}
+
+template<bool Instrumented>
+std::size_t run_impl(IQueue& queue, std::size_t maxCommands) {
+    [[maybe_unused]] metrics::ThreadMetrics* local{nullptr};
+    if constexpr (Instrumented) {
+        local = &metrics::ThreadMetrics::Local();
+    }
+
+    std::size_t executed{0};
+    while(executed < maxCommands && !queue.IsEmpty()) {
         const ICommandUPtr& front = queue.Front();
-        try {
-            front->Execute();
-        } catch (const IException& e) {
-            ExceptionHandler::Handle(front, e)->Execute();
+        if (trace::Enabled()) [[unlikely]] {
+            const trace::Span span{trace::Category::Command, typeid(*front)};
+            execute<Instrumented>(front, queue, local);
+        } else {
+            execute<Instrumented>(front, queue, local);
         }
         queue.Pop();
+        ++executed;
+    }
+    return executed;
+}
+
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+} // namespace detail
+
+inline void run(IQueue& queue) {
+    detail::run_impl<metrics::enabled>(queue, std::numeric_limits<std::size_t>::max());
+}
+
+// Executes at most maxCommands commands, the rest stays in the queue.
+// Returns the number of executed commands.
+inline std::size_t run(IQueue& queue, std::size_t maxCommands) {
+    return detail::run_impl<metrics::enabled>(queue, maxCommands);
+}
+
+struct PersistentConfig {
+    // how long an idle loop keeps polling the queue before it parks
+    std::chrono::nanoseconds spin{std::chrono::microseconds{50}};
+    // commands executed between two looks at the stop token
+    std::size_t batch{1024};
+};
+
+// Long-running loop for a queue fed by other threads: executes commands as they arrive,
+// spins for config.spin once the queue is empty, then parks until the next Push().
+// Returns after stop is requested, the commands queued at that point stay in the queue.
+// Returns the number of executed commands.
+inline std::size_t run(BlockingQueue& queue, std::stop_token stop, PersistentConfig config = {}) {
+    using Clock = std::chrono::steady_clock;
+    const std::stop_callback wake{stop, [&queue] { queue.Wake(); }};
+
+    std::size_t executed{0};
+    while (!stop.stop_requested()) {
+        if (!queue.IsEmpty()) {
+            executed += detail::run_impl<metrics::enabled>(queue, config.batch);
+            continue;
+        }
+        if (config.spin.count() > 0) {
+            const auto deadline = Clock::now() + config.spin;
+            while (queue.IsEmpty() && !stop.stop_requested() && Clock::now() < deadline) {
+                detail::cpu_relax();
+            }
+        }
+        if (queue.IsEmpty()) {
+            queue.Park(stop, std::chrono::nanoseconds::max());
+        }
     }
+    return executed;
 }
 
-} // namespace exceptions::cmd_loop
\ No newline at end of file
+} // namespace exceptions::cmd_loop
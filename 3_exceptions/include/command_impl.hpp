@@ -6,6 +6,7 @@
 #include <string_view>
 
 #include "command_interface.hpp"
+#include "exceptions_interface.hpp"
 #include "queue_interface.hpp"
 
 namespace exceptions {
@@ -22,10 +23,25 @@ public:
     void Execute() const override;
     ICommandUPtr Clone() const override;
 
+    std::string_view Error() const noexcept { return err_; }
+
 private:
     std::string err_;
 };
 
+// Default handler: keeps the exception message as thrown and formats it only when executed
+class PrintUnhandled: public ICommand {
+public:
+    explicit PrintUnhandled(const Message& what) noexcept;
+    void Execute() const override;
+    ICommandUPtr Clone() const override;
+
+    std::string Error() const;
+
+private:
+    Message what_;
+};
+
 // 4. Implement command that writes exception info into the log file
 class LogErrorCommand: public ICommand {
 public:
@@ -33,6 +49,9 @@ public:
     void Execute() const override;
     ICommandUPtr Clone() const override;
 
+    std::string_view Error() const noexcept { return err_; }
+    std::string_view LogPath() const noexcept { return logPath_; }
+
 private:
     std::string err_;
     std::string logPath_;
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "command_interface.hpp"
+#include "queue_interface.hpp"
+
+namespace exceptions {
+
+// Per-thread free lists of fixed size blocks for coroutine frames and awaited commands.
+// Blocks freed on another thread join that thread's lists, the lists never shrink.
+class FramePool {
+public:
+    static void* Allocate(std::size_t size);
+    static void Deallocate(void* p, std::size_t size) noexcept;
+
+    // blocks are multiples of granularity, larger requests go to the global operator new
+    static constexpr std::size_t granularity{16};
+    static constexpr std::size_t maxPooled{1024};
+};
+
+class Coroutines;
+
+// Resumes a suspended behavior. It lives in a resume slot of the behavior's frame, so
+// waking a behavior allocates nothing; deleting it only ends the resumption, or frees the
+// frame once the behavior is done. A behavior that throws finishes and its exception leaves Execute(),
+// so cmd_loop hands it to ExceptionHandler as any other failure.
+class CoroutineCommand : public ICommand {
+public:
+    void Execute() const override;
+    // a coroutine cannot be copied, handlers have to spawn fresh behaviors instead
+    ICommandUPtr Clone() const override;
+
+    // the storage belongs to the frame: the command is destroyed first and a finished
+    // frame is freed only once the command's lifetime has ended
+    static void operator delete(CoroutineCommand* cmd, std::destroying_delete_t) noexcept;
+
+private:
+    friend class Coroutines;
+    explicit CoroutineCommand(std::coroutine_handle<> h) noexcept : handle_{h} {}
+
+    std::coroutine_handle<> handle_;
+};
+
+// Coroutine behavior, spawned with Coroutines::Spawn(). The body runs inside commands
+// executed by cmd_loop and may suspend on Coroutines::NextTick(), SleepFor() and Run().
+class Behavior {
+public:
+    struct promise_type {
+        Behavior get_return_object() noexcept { return Behavior{Handle::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        // the frame is freed with the command that finished it
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+        static void* operator new(std::size_t size) { return FramePool::Allocate(size); }
+        static void operator delete(void* p, std::size_t size) noexcept { FramePool::Deallocate(p, size); }
+
+        std::exception_ptr exception;
+        Coroutines* runtime{nullptr};
+        // intrusive list of the runtime's live frames
+        promise_type* prev{nullptr};
+        promise_type* next{nullptr};
+        // A suspended behavior has at most one resume command queued, but it suspends on
+        // the next tick while the command that resumed it is still executing and owned by
+        // the queue, so the two slots alternate.
+        alignas(CoroutineCommand) std::byte resume[2][sizeof(CoroutineCommand)];
+        std::uint8_t nextResume{0};
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Behavior(Behavior&& other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+    Behavior& operator=(Behavior&&) = delete;
+    ~Behavior() {
+        if (handle_) handle_.destroy();
+    }
+
+private:
+    friend class Coroutines;
+    explicit Behavior(Handle h) noexcept : handle_{h} {}
+
+    Handle handle_;
+};
+
+// Owns the behaviors spawned into a queue and wakes them: the ones waiting for the
+// next tick and the expired timers are enqueued by Tick(). Resume commands point
+// into the frames, so the queue has to be drained or destroyed before the runtime;
+// the frames still alive are destroyed with it.
+class Coroutines {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Coroutines(IQueue& queue) : queue_{queue} {}
+    Coroutines(const Coroutines&) = delete;
+    Coroutines& operator=(const Coroutines&) = delete;
+    ~Coroutines();
+
+    // the behavior starts when the queue reaches it
+    void Spawn(Behavior behavior);
+
+    // enqueues the behaviors waiting for the next tick and the ones whose timers expired
+    void Tick();
+
+    std::size_t Alive() const noexcept { return alive_; }
+    std::uint64_t CurrentTick() const noexcept { return tick_; }
+
+    struct NextTickAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(Behavior::Handle h) const { runtime.nextTick_.push_back(runtime.MakeResume(h)); }
+        void await_resume() const noexcept {}
+
+        Coroutines& runtime;
+    };
+
+    struct SleepAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(Behavior::Handle h) const {
+            runtime.timers_.push(Timer{deadline, runtime.timerSeq_++, h});
+        }
+        void await_resume() const noexcept {}
+
+        Coroutines& runtime;
+        Clock::time_point deadline;
+    };
+
+    // resumes with true if the command executed without an exception,
+    // a failure is passed to ExceptionHandler first
+    struct RunAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(Behavior::Handle h);
+        bool await_resume() const noexcept { return succeeded; }
+
+        Coroutines& runtime;
+        ICommandUPtr cmd;
+        bool succeeded{false};
+    };
+
+    NextTickAwaiter NextTick() noexcept { return NextTickAwaiter{*this}; }
+    // woken by the first Tick() after the deadline
+    SleepAwaiter SleepFor(Clock::duration duration) noexcept { return SleepAwaiter{*this, Clock::now() + duration}; }
+    // enqueues cmd and waits for it to be executed
+    RunAwaiter Run(ICommandUPtr cmd) noexcept { return RunAwaiter{*this, std::move(cmd)}; }
+
+private:
+    friend class CoroutineCommand;
+    class CompletionCommand;
+
+    struct Timer {
+        Clock::time_point deadline;
+        std::uint64_t seq;
+        Behavior::Handle handle;
+
+        bool operator>(const Timer& other) const noexcept {
+            return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+        }
+    };
+
+    static ICommandUPtr MakeResume(Behavior::Handle h) noexcept;
+    void Resume(Behavior::Handle h) { queue_.Push(MakeResume(h)); }
+    void Finish(Behavior::Handle h) noexcept;
+
+    IQueue& queue_;
+    // made on suspension while the frame is hot, Tick() then only moves pointers
+    std::vector<ICommandUPtr> nextTick_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+    std::uint64_t timerSeq_{0};
+    std::uint64_t tick_{0};
+    Behavior::promise_type* live_{nullptr};
+    std::size_t alive_{0};
+};
+
+} // namespace exceptions
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <concepts>
+#include <cstdint>
 #include <format>
+#include <shared_mutex>
 #include <string>
 #include <typeindex>
+#include <typeinfo>
 #include <unordered_map>
+#include <vector>
 
 #include "command_impl.hpp"
 #include "exceptions_interface.hpp"
@@ -16,20 +22,74 @@ public:
     ExceptionHandler() = default;
     ~ExceptionHandler() = default;
 
+    // Resolves the handler once per (command type, exception type) pair and memoizes the
+    // result per thread, later calls for the pair are a single lookup.
     static ICommandUPtr Handle(const ICommandUPtr& cmd, const IException& ex) noexcept;
 
+    // The handler also serves commands and exceptions derived from TCmd and TExc. The most
+    // derived registered command type wins, then the most derived exception type; between
+    // unrelated bases the earlier registration wins. A replaced handler is kept alive until
+    // exit, so a thread still holding it in its memo never clones a freed command; handlers
+    // are meant to be registered at startup, replacing them in a loop grows the memory use.
     template<typename TCmd, typename TExc>
+        requires std::derived_from<TCmd, ICommand> && std::derived_from<TExc, IException>
     static void Register(ICommandUPtr handler) {
-        handlersStore_[typeid(TCmd)][typeid(TExc)] = std::move(handler);
+        Register(Probe<ICommand>::Of<TCmd>(), Probe<IException>::Of<TExc>(), std::move(handler));
     }
 
 private:
-    using CommandKey = std::type_index;
-    using ExceptionKey = std::type_index;
-    using ExceptionTable = std::unordered_map<ExceptionKey, ICommandUPtr>;
-    static inline std::unordered_map<CommandKey, ExceptionTable> handlersStore_;
+    // Type-erased registered type: tests objects against it and, by throwing and catching a null
+    // pointer, whether another registered type derives from it, no instance needed.
+    template<typename TRoot>
+    struct Probe {
+        const std::type_info* type;
+        bool (*isInstance)(const TRoot&);
+        void (*throwNull)();
+        bool (*catchesNull)(void (*)());
 
-    static ICommandUPtr GetDefaultCommand(std::string_view);
+        template<typename T>
+        static Probe Of() {
+            return {
+                &typeid(T),
+                []([[maybe_unused]] const TRoot& obj) {
+                    // every object is a root, and a cast to it would only test a reference for null
+                    if constexpr (std::same_as<T, TRoot>) return true;
+                    else return nullptr != dynamic_cast<const T*>(&obj);
+                },
+                [] { throw static_cast<const T*>(nullptr); },
+                [](void (*throwNull)()) {
+                    try {
+                        throwNull();
+                    } catch (const T*) {
+                        return true;
+                    } catch (...) {}
+                    return false;
+                },
+            };
+        }
+
+        bool DerivesFrom(const Probe& base) const {
+            return base.catchesNull(throwNull);
+        }
+    };
+
+    struct Registration {
+        Probe<ICommand> command;
+        Probe<IException> exception;
+        ICommandUPtr handler;
+    };
+
+    static void Register(const Probe<ICommand>&, const Probe<IException>&, ICommandUPtr);
+    static const ICommand* Resolve(const ICommand&, const IException&);
+    static bool MoreSpecific(const Registration&, const Registration&);
+    static ICommandUPtr GetDefaultCommand(const Message&);
+
+    static inline std::shared_mutex mutex_;
+    static inline std::vector<Registration> registrations_;
+    // replaced handlers, never freed, see Register()
+    static inline std::vector<ICommandUPtr> retired_;
+    // bumped by every registration, a thread memo of another generation is dropped
+    static inline std::atomic<std::uint64_t> generation_{1};
 };
 
 class TestException : public IException {
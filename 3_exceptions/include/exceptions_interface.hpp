@@ -1,26 +1,153 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <format>
 #include <string>
-#include <typeindex>
-#include <unordered_map>
+#include <string_view>
 
 namespace exceptions {
 
+// Exception text that never allocates. Literal() references a string literal, any other text
+// is copied into an inline buffer of inlineCapacity chars; longer text is cut, ends in "..."
+// and is reported by Truncated(). Up to maxArgs integral details are kept beside the text and
+// substituted into its {} placeholders only by Format().
+class Message {
+public:
+    static constexpr std::size_t inlineCapacity{47};
+    static constexpr std::size_t maxArgs{3};
+
+    // Text with static storage that is known at compile time, e.g. a string literal; a local
+    // buffer does not compile. The text ends at its first NUL and has at most 255 chars.
+    class LiteralText {
+    public:
+        template<std::size_t N>
+        consteval LiteralText(const char (&text)[N]) noexcept
+        : text_{text} {
+            static_assert(N <= 256, "Message literals are limited to 255 chars");
+            while (size_ < N - 1 && '\0' != text[size_]) ++size_;
+        }
+
+    private:
+        friend class Message;
+        const char* text_;
+        std::uint8_t size_{0};
+    };
+
+    // the text is referenced, not copied
+    template<std::integral... Args>
+        requires (sizeof...(Args) <= maxArgs)
+    static Message Literal(LiteralText text, Args... args) noexcept {
+        Message msg;
+        msg.literal_ = text.text_;
+        msg.size_ = text.size_;
+        msg.argc_ = sizeof...(Args);
+        msg.args_ = {static_cast<std::int64_t>(args)...};
+        return msg;
+    }
+
+    template<std::integral... Args>
+        requires (sizeof...(Args) <= maxArgs)
+    Message(std::string_view text, Args... args) noexcept
+    : inline_{true}
+    , truncated_{text.size() > inlineCapacity}
+    , size_{static_cast<std::uint8_t>(std::min(text.size(), inlineCapacity))}
+    , argc_{sizeof...(Args)}
+    , args_{static_cast<std::int64_t>(args)...} {
+        std::copy_n(text.data(), size_, buffer_);
+        if (truncated_) std::copy_n(truncationMark.data(), truncationMark.size(), buffer_ + size_ - truncationMark.size());
+    }
+
+    // C strings, char buffers included, are copied as well
+    template<std::integral... Args>
+        requires (sizeof...(Args) <= maxArgs)
+    Message(const char* text, Args... args) noexcept
+    : Message{std::string_view{text}, args...} {}
+
+    static Message Copy(std::string_view text) noexcept { return Message{text}; }
+
+    Message(const Message& other) noexcept { *this = other; }
+    Message& operator=(const Message& other) noexcept {
+        inline_ = other.inline_;
+        truncated_ = other.truncated_;
+        size_ = other.size_;
+        argc_ = other.argc_;
+        args_ = other.args_;
+        if (inline_) std::copy_n(other.buffer_, size_, buffer_);
+        else literal_ = other.literal_;
+        return *this;
+    }
+
+    // the text as thrown, placeholders left in place
+    std::string_view Text() const noexcept {
+        return {inline_ ? buffer_ : literal_, size_};
+    }
+
+    // the runtime text was longer than inlineCapacity and ends in "..." instead
+    bool Truncated() const noexcept { return truncated_; }
+
+    std::size_t ArgCount() const noexcept { return argc_; }
+    std::int64_t Arg(std::size_t i) const noexcept { return args_[i]; }
+
+    std::string Format() const {
+        try {
+            switch (argc_) {
+                case 1: return std::vformat(Text(), std::make_format_args(args_[0]));
+                case 2: return std::vformat(Text(), std::make_format_args(args_[0], args_[1]));
+                case 3: return std::vformat(Text(), std::make_format_args(args_[0], args_[1], args_[2]));
+                default: return std::string{Text()};
+            }
+        } catch (const std::format_error&) {
+            return std::string{Text()};
+        }
+    }
+
+private:
+    Message() noexcept
+    : literal_{""} {}
+
+    union {
+        const char* literal_;
+        char buffer_[inlineCapacity];
+    };
+    static constexpr std::string_view truncationMark{"..."};
+
+    bool inline_{false};
+    bool truncated_{false};
+    std::uint8_t size_{0};
+    std::uint8_t argc_{0};
+    std::array<std::int64_t, maxArgs> args_{};
+};
+
 class IException {
 protected:
-    explicit IException(std::string_view what)
+    explicit IException(const Message& what) noexcept
     : what_{what} {}
 
 public:
     virtual ~IException() = default;
 
+    // The text as thrown, without allocating: {} placeholders are left in place and the
+    // details are not filled in, e.g. "Not enough fuel to reserve {} units". It suits
+    // matching and logging the kind of failure; Describe() is the message for people.
     virtual std::string_view What() const noexcept {
+        return what_.Text();
+    }
+
+    // the human-readable message, What() with the details filled in; formats on every call
+    std::string Describe() const {
+        return what_.Format();
+    }
+
+    const Message& GetMessage() const noexcept {
         return what_;
     }
 
 private:
-    const std::string what_;
+    Message what_;
 };
 
-}; // namespace exceptions
\ No newline at end of file
+}; // namespace exceptions
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "command_interface.hpp"
+#include "queue_impl.hpp"
+#include "queue_interface.hpp"
+
+namespace exceptions {
+
+// Multi-tenant front-end for cmd_loop::run: one IQueue per tenant, drained by
+// deficit round robin. A tenant's turn lasts while its deficit is positive; every
+// command is charged the time between Front() and Pop(), i.e. its execution time
+// including exception handling, and every turn tops the deficit up by weight * quantum.
+// A tenant that runs out of commands drops its credit but keeps its debt, so going idle
+// does not pay off an expensive command.
+// Commands pushed through the front-end itself (e.g. by exception handlers) go to the
+// tenant whose command is executing, or to the first tenant otherwise.
+class FairQueue : public IQueue {
+public:
+    using TenantId = std::size_t;
+    using Clock = std::function<std::chrono::nanoseconds()>;
+
+    struct Config {
+        std::chrono::nanoseconds quantum{std::chrono::microseconds{20}};
+        // monotonic time source used for cost accounting, steady_clock when empty
+        Clock now;
+    };
+
+    FairQueue() : FairQueue(Config{}) {}
+
+    explicit FairQueue(Config config)
+    : config_{std::move(config)} {
+        if (!config_.now) {
+            config_.now = [] { return std::chrono::steady_clock::now().time_since_epoch(); };
+        }
+    }
+
+    TenantId AddTenant(std::uint32_t weight = 1, std::unique_ptr<IQueue> queue = std::make_unique<QueueImpl>()) {
+        if (0 == weight) throw std::invalid_argument("Tenant weight must be positive");
+        const auto id = tenants_.size();
+        tenants_.push_back(std::make_unique<Tenant>(*this, id, weight, std::move(queue)));
+        return id;
+    }
+
+    // producer side view of a tenant: Push enqueues for the tenant, Size/IsEmpty show its backlog
+    IQueue& TenantQueue(TenantId id) { return tenants_.at(id)->view; }
+
+    void Push(TenantId id, ICommandUPtr cmd) {
+        auto& tenant = *tenants_.at(id);
+        tenant.queue->Push(std::move(cmd));
+        ++size_;
+        if (!tenant.active) {
+            tenant.active = true;
+            active_.push_back(id);
+        }
+    }
+
+    void Push(ICommandUPtr cmd) override {
+        if (tenants_.empty()) throw std::logic_error("Fair queue has no tenants");
+        Push(none != current_ ? current_ : 0, std::move(cmd));
+    }
+
+    void Pop() override {
+        Select();
+        auto& tenant = *tenants_[current_];
+        const auto cost = config_.now() - started_;
+        tenant.queue->Pop();
+        Charge(tenant, cost);
+    }
+
+    ICommandUPtr Take() override {
+        Select();
+        auto& tenant = *tenants_[current_];
+        const auto cost = config_.now() - started_;
+        auto cmd = tenant.queue->Take();
+        Charge(tenant, cost);
+        return cmd;
+    }
+
+    const ICommandUPtr& Front() const noexcept override {
+        Select();
+        return tenants_[current_]->queue->Front();
+    }
+
+    bool IsEmpty() const noexcept override { return 0 == size_; }
+    std::size_t Size() const noexcept override { return size_; }
+
+    std::chrono::nanoseconds Consumed(TenantId id) const { return tenants_.at(id)->consumed; }
+
+private:
+    static constexpr TenantId none = std::numeric_limits<TenantId>::max();
+
+    class View : public IQueue {
+    public:
+        View(FairQueue& owner, TenantId id) : owner_{owner}, id_{id} {}
+
+        void Push(ICommandUPtr cmd) override { owner_.Push(id_, std::move(cmd)); }
+        // drop or take the tenant's oldest command, must not be used while it executes
+        void Pop() override { owner_.Discard(id_); }
+        ICommandUPtr Take() override { return owner_.Discard(id_); }
+        const ICommandUPtr& Front() const noexcept override { return owner_.tenants_[id_]->queue->Front(); }
+        bool IsEmpty() const noexcept override { return owner_.tenants_[id_]->queue->IsEmpty(); }
+        std::size_t Size() const noexcept override { return owner_.tenants_[id_]->queue->Size(); }
+
+    private:
+        FairQueue& owner_;
+        TenantId id_;
+    };
+
+    struct Tenant {
+        Tenant(FairQueue& owner, TenantId id, std::uint32_t w, std::unique_ptr<IQueue> q)
+        : weight{w}
+        , queue{std::move(q)}
+        , view{owner, id} {}
+
+        std::uint32_t weight;
+        std::unique_ptr<IQueue> queue;
+        View view;
+        std::int64_t deficit{0};  // ns
+        std::chrono::nanoseconds consumed{0};
+        bool active{false};       // in the ring, possibly with no commands left after a Discard()
+    };
+
+    std::int64_t Quantum(const Tenant& tenant) const noexcept {
+        return config_.quantum.count() * tenant.weight;
+    }
+
+    void Deactivate(Tenant& tenant) const noexcept {
+        tenant.active = false;
+        tenant.deficit = std::min<std::int64_t>(tenant.deficit, 0);
+    }
+
+    // Picks the tenant at the head of the active ring in O(1) unless every tenant is in debt
+    // beyond its next top-up, then CatchUp() settles all the rounds that takes in one pass.
+    void Select() const noexcept {
+        if (none != current_) return;
+        assert(0 != size_);
+        // tenants emptied by Discard() leave the ring once they reach its head
+        while (tenants_[active_.front()]->queue->IsEmpty()) {
+            Deactivate(*tenants_[active_.front()]);
+            active_.pop_front();
+        }
+        auto& head = *tenants_[active_.front()];
+        if (head.deficit <= 0) {
+            if (head.deficit + Quantum(head) > 0) {
+                head.deficit += Quantum(head);
+            } else {
+                CatchUp();
+            }
+        }
+        current_ = active_.front();
+        started_ = config_.now();
+    }
+
+    // Every tenant but the head is in debt, so each round tops each of them up once. The
+    // first tenant in ring order to get into credit runs after the fewest rounds: it and the
+    // tenants ahead of it get that many top-ups, the ones behind it one less as their turn
+    // in the last round has not come yet, and the tenants ahead go to the back of the ring.
+    void CatchUp() const noexcept {
+        auto rounds = std::numeric_limits<std::int64_t>::max();
+        std::size_t first{0};
+        for (std::size_t i = 0; i < active_.size(); ++i) {
+            const auto& tenant = *tenants_[active_[i]];
+            if (tenant.queue->IsEmpty()) continue;
+            const auto needed = -tenant.deficit / Quantum(tenant) + 1;
+            if (needed < rounds) {
+                rounds = needed;
+                first = i;
+            }
+        }
+        for (std::size_t i = 0; i < active_.size(); ++i) {
+            auto& tenant = *tenants_[active_[i]];
+            if (tenant.queue->IsEmpty()) continue;
+            tenant.deficit += (i <= first ? rounds : rounds - 1) * Quantum(tenant);
+        }
+        std::rotate(active_.begin(), active_.begin() + static_cast<std::ptrdiff_t>(first), active_.end());
+    }
+
+    // charges the command of the current tenant and ends its selection
+    void Charge(Tenant& tenant, std::chrono::nanoseconds cost) {
+        tenant.deficit -= cost.count();
+        tenant.consumed += cost;
+        --size_;
+
+        assert(active_.front() == current_);
+        if (tenant.queue->IsEmpty()) {
+            active_.pop_front();
+            Deactivate(tenant);
+        } else if (tenant.deficit <= 0) {
+            active_.pop_front();
+            active_.push_back(current_);
+        }
+        current_ = none;
+    }
+
+    ICommandUPtr Discard(TenantId id) {
+        auto& tenant = *tenants_.at(id);
+        assert(current_ != id);
+        auto cmd = tenant.queue->Take();
+        --size_;
+        // an emptied tenant stays in the ring until Select() reaches it, erasing it here
+        // would cost a scan of the ring
+        return cmd;
+    }
+
+    Config config_;
+    std::vector<std::unique_ptr<Tenant>> tenants_;
+    // Front() and IsEmpty() are const for cmd_loop, selecting the next tenant is not
+    mutable std::deque<TenantId> active_;
+    mutable TenantId current_{none};
+    mutable std::chrono::nanoseconds started_{0};
+    std::size_t size_{0};
+};
+
+}; // namespace exceptions
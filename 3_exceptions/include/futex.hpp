@@ -0,0 +1,37 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+namespace exceptions::futex {
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t)
+              && std::atomic<std::uint32_t>::is_always_lock_free,
+              "futex words must be plain 32-bit atomics");
+
+// Blocks while word == expected, at most for timeout. Spurious wake-ups are possible.
+// The word may live in memory shared between processes.
+inline void Wait(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::chrono::nanoseconds timeout) noexcept {
+    if (timeout.count() <= 0) return;
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    timespec ts{.tv_sec = static_cast<time_t>(seconds.count()),
+                .tv_nsec = static_cast<long>((timeout - seconds).count())};
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void WakeOne(std::atomic<std::uint32_t>& word) noexcept {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+inline void WakeAll(std::atomic<std::uint32_t>& word) noexcept {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace exceptions::futex
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace exceptions {
+
+// HDR-style log-linear histogram of nanosecond latencies.
+// Every power of two is split into 2^subBucketBits linear sub-buckets,
+// so any recorded value is reported with a relative error below 1/16.
+class LatencyHistogram {
+public:
+    static constexpr unsigned subBucketBits = 4;
+    static constexpr std::size_t subBucketCount = std::size_t{1} << subBucketBits;
+    static constexpr std::size_t bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+    void Record(std::uint64_t ns) noexcept {
+        ++counts_[IndexOf(ns)];
+        ++total_;
+        sum_ += ns;
+        min_ = std::min(min_, ns);
+        max_ = std::max(max_, ns);
+    }
+
+    void Record(std::chrono::nanoseconds duration) noexcept {
+        Record(static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0)));
+    }
+
+    void Merge(const LatencyHistogram& other) noexcept {
+        for (std::size_t i = 0; i < bucketCount; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void Reset() noexcept { *this = LatencyHistogram{}; }
+
+    std::uint64_t Count() const noexcept { return total_; }
+    std::uint64_t Min() const noexcept { return total_ ? min_ : 0; }
+    std::uint64_t Max() const noexcept { return max_; }
+    double Mean() const noexcept { return total_ ? static_cast<double>(sum_) / total_ : 0.; }
+
+    // highest value equivalent to the bucket that holds the requested percentile
+    std::uint64_t Percentile(double percentile) const noexcept {
+        if (0 == total_) return 0;
+        const auto clamped = std::clamp(percentile, 0., 100.);
+        const auto rank = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(clamped / 100. * static_cast<double>(total_) + 0.5));
+
+        std::uint64_t seen{0};
+        for (std::size_t i = 0; i < bucketCount; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(UpperBoundOf(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static std::size_t IndexOf(std::uint64_t val) noexcept {
+        if (val < subBucketCount) return static_cast<std::size_t>(val);
+        const auto msb = static_cast<unsigned>(std::bit_width(val)) - 1;
+        const auto mantissa = (val >> (msb - subBucketBits)) & (subBucketCount - 1);
+        return (msb - subBucketBits + 1) * subBucketCount + static_cast<std::size_t>(mantissa);
+    }
+
+    static std::uint64_t UpperBoundOf(std::size_t idx) noexcept {
+        if (idx < subBucketCount) return idx;
+        const auto msb = static_cast<unsigned>(idx / subBucketCount) + subBucketBits - 1;
+        const auto mantissa = static_cast<std::uint64_t>(idx % subBucketCount);
+        const auto lower = (std::uint64_t{1} << msb) | (mantissa << (msb - subBucketBits));
+        return lower + ((std::uint64_t{1} << (msb - subBucketBits)) - 1);
+    }
+
+    std::array<std::uint64_t, bucketCount> counts_{};
+    std::uint64_t total_{0};
+    std::uint64_t sum_{0};
+    std::uint64_t min_{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t max_{0};
+};
+
+} // namespace exceptions
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+#include "latency_histogram.hpp"
+
+// set by the ARCHITECTURE_LOOP_METRICS CMake option
+#ifndef EXCEPTIONS_LOOP_METRICS
+#define EXCEPTIONS_LOOP_METRICS 0
+#endif
+
+namespace exceptions::metrics {
+
+// cmd_loop is instrumented only when enabled, otherwise the hooks are compiled out
+inline constexpr bool enabled = EXCEPTIONS_LOOP_METRICS != 0;
+
+struct CommandStats {
+    std::uint64_t executed{0};             // estimated from the sampled commands
+    std::uint64_t failed{0};
+    LatencyHistogram latency;              // sampled commands only
+};
+
+struct Snapshot {
+    std::chrono::nanoseconds interval{0};  // since the previous Collect()
+    std::uint64_t executed{0};             // exact, unlike the per-type counts
+    std::uint64_t failed{0};
+    double commandsPerSecond{0.};          // over the interval
+    std::uint64_t maxQueueDepth{0};
+    LatencyHistogram queueDepth;           // sampled commands only, in commands rather than ns
+    std::map<std::string, CommandStats> commands;
+    std::map<std::pair<std::string, std::string>, std::uint64_t> exceptions;
+
+    std::string ToText() const;
+    std::string ToJson() const;
+};
+
+enum class Format { Text, Json };
+
+// Metrics of the cmd_loop running on one thread. An unsampled command costs a bump
+// of the thread's counter only: the type slot, latency and queue depth are taken for
+// sampled commands, and each of them counts for sampleMask + 1 commands of its type.
+// Failures are counted for every command. Counters have a single writer and are read
+// by Collect() from any thread; histograms are under a lock contended by Collect() alone.
+class ThreadMetrics {
+    struct TypeSlot {
+        explicit TypeSlot(std::type_index t) : type{t} {}
+
+        std::type_index type;
+        std::atomic<std::uint64_t> executed{0};
+        std::atomic<std::uint64_t> failed{0};
+        LatencyHistogram latency;
+    };
+
+public:
+    struct Probe {
+        TypeSlot* slot;
+        std::chrono::steady_clock::time_point start;
+        std::size_t queueDepth;
+    };
+
+    static ThreadMetrics& Local();
+
+    // Counts a command, true when it is sampled and goes through Begin()/End()
+    bool Count() noexcept {
+        const auto executed = executed_.load(std::memory_order_relaxed) + 1;
+        executed_.store(executed, std::memory_order_relaxed);
+        return 0 == (executed & sampleMask.load(std::memory_order_relaxed));
+    }
+
+    Probe Begin(const std::type_info& cmd, std::size_t queueDepth) {
+        auto* slot = CachedSlot(cmd);
+        Bump(slot->executed, sampleMask.load(std::memory_order_relaxed) + std::uint64_t{1});
+        return Probe{slot, std::chrono::steady_clock::now(), queueDepth};
+    }
+
+    void End(const Probe& probe) {
+        const auto elapsed = std::chrono::steady_clock::now() - probe.start;
+        std::lock_guard lock{mtx_};
+        probe.slot->latency.Record(elapsed);
+        queueDepth_.Record(static_cast<std::uint64_t>(probe.queueDepth));
+    }
+
+    // out of line, it takes the lock anyway and keeps the loop small
+    void Failed(const std::type_info& cmd, const std::type_info& ex);
+
+    // every (sampleMask + 1)-th command is timed, sampleMask + 1 must be a power of two.
+    // A sample costs a couple hundred ns with the clock reads and the lock, so at 1 in 1024
+    // the overhead is mostly the count, see BM_MetricsOverhead* for the 2% budget.
+    static inline std::atomic<std::uint32_t> sampleMask{1023};
+
+private:
+    friend Snapshot Collect();
+    friend void Reset();
+
+    static void Bump(std::atomic<std::uint64_t>& counter, std::uint64_t n) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // Open addressed cache of the slots by type_info address, owner thread only, so a queue
+    // of mixed command types takes the lock only the first time a type shows up
+    TypeSlot* CachedSlot(const std::type_info& cmd) {
+        const auto home = reinterpret_cast<std::uintptr_t>(&cmd) / alignof(std::type_info);
+        for (std::size_t i = 0; i < cacheProbes; ++i) {
+            auto& entry = cache_[(home + i) % cache_.size()];
+            if (entry.type == &cmd) return entry.slot;
+            if (nullptr == entry.type) return (entry = CacheEntry{&cmd, &SlotOf(cmd)}).slot;
+        }
+        // a full probe sequence: evict the home entry
+        auto& entry = cache_[home % cache_.size()];
+        return (entry = CacheEntry{&cmd, &SlotOf(cmd)}).slot;
+    }
+
+    TypeSlot& SlotOf(const std::type_info& cmd);
+
+    struct CacheEntry {
+        const std::type_info* type{nullptr};
+        TypeSlot* slot{nullptr};
+    };
+    static constexpr std::size_t cacheProbes{4};
+
+    std::mutex mtx_;
+    std::unordered_map<std::type_index, std::unique_ptr<TypeSlot>> slots_;
+    std::map<std::pair<std::type_index, std::type_index>, std::uint64_t> exceptions_;
+    LatencyHistogram queueDepth_;
+
+    std::atomic<std::uint64_t> executed_{0};
+
+    // owner thread only
+    std::array<CacheEntry, 64> cache_{};
+};
+
+// Merges the metrics of all threads, safe to call while loops are running
+Snapshot Collect();
+
+// Clears all metrics, counters bumped concurrently by running loops may survive
+void Reset();
+
+// Writes Collect() to path through a temporary file, so readers never see a partial dump
+void WriteSnapshot(const std::filesystem::path& path, Format format);
+
+} // namespace exceptions::metrics
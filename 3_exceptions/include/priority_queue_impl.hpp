@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "command_interface.hpp"
+#include "queue_interface.hpp"
+
+namespace exceptions {
+
+// Bounded IQueue with priority classes (0 is the highest) and earliest-deadline-first
+// order inside a class. Commands over capacity and, optionally, commands whose
+// deadline has passed are shed instead of being executed.
+class PriorityQueueImpl : public IQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Classifier = std::function<std::size_t(const ICommand&)>;
+
+    enum class Overflow {
+        RejectNew,           // the pushed command is dropped
+        DropLowestPriority,  // a command of the lowest non-empty class is dropped, unless it outranks the pushed one
+    };
+
+    struct Config {
+        std::size_t capacity{std::numeric_limits<std::size_t>::max()};
+        // one entry per class, deadline = push time + budget, zero means no deadline
+        std::vector<std::chrono::nanoseconds> budgets{std::chrono::nanoseconds{0}};
+        Overflow overflow{Overflow::DropLowestPriority};
+        bool dropExpired{false};
+        // class of commands pushed through IQueue::Push, the lowest class when empty
+        Classifier classify{};
+    };
+
+    struct ShedStats {
+        std::uint64_t expired{0};
+        std::uint64_t evicted{0};   // dropped to make room for a higher class
+        std::uint64_t rejected{0};  // dropped on push
+    };
+
+    explicit PriorityQueueImpl(Config config)
+    : config_{std::move(config)}
+    , classes_(config_.budgets.size())
+    , stats_(config_.budgets.size()) {
+        if (classes_.empty()) throw std::invalid_argument("Priority queue needs at least one class");
+    }
+
+    void Push(ICommandUPtr cmd) override {
+        const auto priority = config_.classify ? config_.classify(*cmd) : classes_.size() - 1;
+        const auto budget = config_.budgets.at(priority);
+        const auto deadline = budget.count() > 0 ? Clock::now() + budget : Clock::time_point::max();
+        Push(std::move(cmd), priority, deadline);
+    }
+
+    // returns false when the command was shed
+    bool Push(ICommandUPtr cmd, std::size_t priority, Clock::time_point deadline) {
+        if (priority >= classes_.size()) {
+            throw std::out_of_range(std::format("Priority {} of a queue with {} classes", priority, classes_.size()));
+        }
+        if (size_ >= config_.capacity && !MakeRoom(priority)) {
+            ++stats_[priority].rejected;
+            return false;
+        }
+
+        auto& heap = classes_[priority];
+        heap.push_back(Entry{deadline, seq_++, std::move(cmd)});
+        std::push_heap(heap.begin(), heap.end(), Later{});
+        ++size_;
+        return true;
+    }
+
+    void Pop() override {
+        Stage();
+        assert(current_);
+        current_.reset();
+        --size_;
+    }
+
+    ICommandUPtr Take() override {
+        Stage();
+        assert(current_);
+        --size_;
+        return std::move(current_);
+    }
+
+    // The front command is moved out of its heap, so the reference stays valid
+    // and Pop() removes it even if handlers push more urgent commands meanwhile.
+    const ICommandUPtr& Front() const noexcept override {
+        Stage();
+        assert(current_);
+        return current_;
+    }
+
+    bool IsEmpty() const noexcept override {
+        Stage();
+        return !current_;
+    }
+
+    std::size_t Size() const noexcept override { return size_; }
+
+    const ShedStats& Stats(std::size_t priority) const { return stats_.at(priority); }
+
+    ShedStats TotalStats() const noexcept {
+        ShedStats res;
+        for (const auto& s: stats_) {
+            res.expired += s.expired;
+            res.evicted += s.evicted;
+            res.rejected += s.rejected;
+        }
+        return res;
+    }
+
+private:
+    struct Entry {
+        Clock::time_point deadline;
+        std::uint64_t seq;  // FIFO among equal deadlines
+        ICommandUPtr cmd;
+    };
+
+    // max-heap comparator that puts the earliest deadline on top
+    struct Later {
+        bool operator()(const Entry& lhs, const Entry& rhs) const noexcept {
+            return lhs.deadline != rhs.deadline ? lhs.deadline > rhs.deadline : lhs.seq > rhs.seq;
+        }
+    };
+
+    // ordinary less-than by deadline, max_element of it is the latest entry
+    struct Earlier {
+        bool operator()(const Entry& lhs, const Entry& rhs) const noexcept {
+            return Later{}(rhs, lhs);
+        }
+    };
+
+    static Entry PopTop(std::vector<Entry>& heap) noexcept {
+        std::pop_heap(heap.begin(), heap.end(), Later{});
+        auto top = std::move(heap.back());
+        heap.pop_back();
+        return top;
+    }
+
+    void Stage() const noexcept {
+        if (current_) return;
+        const auto now = config_.dropExpired ? Clock::now() : Clock::time_point{};
+        for (std::size_t priority = 0; priority < classes_.size(); ++priority) {
+            auto& heap = classes_[priority];
+            while (!heap.empty()) {
+                auto top = PopTop(heap);
+                if (config_.dropExpired && top.deadline < now) {
+                    ++stats_[priority].expired;
+                    --size_;
+                    continue;
+                }
+                current_ = std::move(top.cmd);
+                return;
+            }
+        }
+    }
+
+    bool MakeRoom(std::size_t priority) {
+        if (config_.dropExpired && DropExpiredTops()) return true;
+        if (Overflow::RejectNew == config_.overflow) return false;
+
+        for (auto lowest = classes_.size(); lowest-- > priority + 1;) {
+            auto& heap = classes_[lowest];
+            if (heap.empty()) continue;
+            // the latest deadline is one of the leaves, the second half of the heap
+            const auto latest = std::max_element(heap.begin() + heap.size() / 2, heap.end(), Earlier{});
+            const auto pos = latest - heap.begin();
+            *latest = std::move(heap.back());
+            heap.pop_back();
+            // the former last entry may be earlier than its new parent
+            if (pos < std::ssize(heap)) std::push_heap(heap.begin(), heap.begin() + pos + 1, Later{});
+            ++stats_[lowest].evicted;
+            --size_;
+            return true;
+        }
+        return false;
+    }
+
+    bool DropExpiredTops() {
+        const auto now = Clock::now();
+        bool dropped{false};
+        for (std::size_t priority = 0; priority < classes_.size(); ++priority) {
+            auto& heap = classes_[priority];
+            while (!heap.empty() && heap.front().deadline < now) {
+                PopTop(heap);
+                ++stats_[priority].expired;
+                --size_;
+                dropped = true;
+            }
+        }
+        return dropped;
+    }
+
+    Config config_;
+    // Front() and IsEmpty() stage the next command and shed expired ones on the way
+    mutable std::vector<std::vector<Entry>> classes_;
+    mutable std::vector<ShedStats> stats_;
+    mutable ICommandUPtr current_;
+    mutable std::size_t size_{0};
+    std::uint64_t seq_{0};
+};
+
+}; // namespace exceptions
@@ -13,6 +13,13 @@ public:
     void Push(ICommandUPtr cmd) override { impl_.push(std::move(cmd)); }
     void Pop()                  override { impl_.pop(); }
 
+    ICommandUPtr Take() override {
+        assert(!impl_.empty());
+        auto cmd = std::move(impl_.front());
+        impl_.pop();
+        return cmd;
+    }
+
     const ICommandUPtr& Front() const noexcept override { 
         assert(!impl_.empty());
         return impl_.front(); 
@@ -11,6 +11,9 @@ class IQueue {
 public:
     virtual void Push(ICommandUPtr) = 0;
     virtual void Pop() = 0;
+    // Pop() that hands the front command over instead of destroying it,
+    // for consumers that execute it elsewhere
+    virtual ICommandUPtr Take() = 0;
     virtual const ICommandUPtr& Front() const noexcept = 0;
     virtual bool IsEmpty() const noexcept = 0;
     virtual std::size_t Size() const noexcept = 0;
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <typeinfo>
+
+namespace exceptions::trace {
+
+enum class Category : std::uint8_t {
+    Command,     // ICommand::Execute run by cmd_loop
+    Handler,     // ExceptionHandler::Handle and the handler it returned
+    MacroChild,  // a command of a macro
+};
+
+struct Event {
+    const std::type_info* type;
+    std::int64_t begin;  // steady_clock ns
+    std::int64_t end;
+    Category category;
+};
+
+inline std::int64_t Now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Events of the thread that records them. The thread fills the next slot of a fixed array
+// and publishes it by bumping the size, so readers see complete events only and nothing
+// is locked. A full buffer drops further events and counts them. Once its thread exits,
+// a buffer goes on with the events of the next thread that starts tracing.
+class ThreadBuffer {
+public:
+    explicit ThreadBuffer(std::uint32_t tid);
+
+    static ThreadBuffer& Local();
+
+    void Record(const Event& event) noexcept {
+        const auto size = size_.load(std::memory_order_relaxed);
+        if (size == capacity_) {
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        events_[size] = event;
+        size_.store(size + 1, std::memory_order_release);
+    }
+
+    // events per thread, for buffers created afterwards; only buffers of this capacity are reused
+    static inline std::atomic<std::size_t> capacity{std::size_t{1} << 16};
+
+private:
+    friend std::string ToChromeJson();
+    friend void Reset();
+    friend std::uint64_t Dropped();
+
+    std::uint32_t tid_;
+    std::size_t capacity_;
+    std::unique_ptr<Event[]> events_;
+    std::atomic<std::size_t> size_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+};
+
+// Tracing is off until Start(). While it is off, cmd_loop and MacroCommand pay one
+// relaxed load and a branch per command.
+inline std::atomic<bool> enabledFlag{false};
+
+inline bool Enabled() noexcept { return enabledFlag.load(std::memory_order_relaxed); }
+inline void Start() noexcept { enabledFlag.store(true, std::memory_order_relaxed); }
+inline void Stop() noexcept { enabledFlag.store(false, std::memory_order_relaxed); }
+
+// Times its scope, for callers that have checked Enabled()
+class Span {
+public:
+    Span(Category category, const std::type_info& type) noexcept
+    : type_{type}
+    , begin_{Now()}
+    , category_{category} {}
+
+    ~Span() { ThreadBuffer::Local().Record(Event{&type_, begin_, Now(), category_}); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const std::type_info& type_;
+    std::int64_t begin_;
+    Category category_;
+};
+
+// Chrome trace-event JSON of the events of all threads, also read by Perfetto;
+// safe to call while threads are tracing
+std::string ToChromeJson();
+
+// Writes ToChromeJson() to path through a temporary file, so readers never see a partial trace
+void WriteChromeTrace(const std::filesystem::path& path);
+
+// Forgets all events, no thread may trace meanwhile
+void Reset();
+
+// events lost to full buffers
+std::uint64_t Dropped();
+
+} // namespace exceptions::trace
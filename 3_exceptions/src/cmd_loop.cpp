@@ -0,0 +1,17 @@
+#include "cmd_loop.hpp"
+
+namespace exceptions::cmd_loop::detail {
+
+void execute_sampled(const ICommandUPtr& front, const IQueue& queue, metrics::ThreadMetrics& local) {
+    const auto probe = local.Begin(typeid(*front), queue.Size());
+    try {
+        front->Execute();
+        local.End(probe);
+    } catch (const IException& e) {
+        local.End(probe);
+        local.Failed(typeid(*front), typeid(e));
+        handle(front, e);
+    }
+}
+
+} // namespace exceptions::cmd_loop::detail
@@ -29,6 +29,22 @@ ICommandUPtr PrintError::Clone() const {
     return std::make_unique<PrintError>(*this);
 }
 
+// PrintUnhandled impl
+PrintUnhandled::PrintUnhandled(const Message& what) noexcept
+: what_{what} {}
+
+void PrintUnhandled::Execute() const {
+    std::cerr << Error() << '\n';
+}
+
+ICommandUPtr PrintUnhandled::Clone() const {
+    return std::make_unique<PrintUnhandled>(*this);
+}
+
+std::string PrintUnhandled::Error() const {
+    return std::format("No registered handler for '{}'", what_.Format());
+}
+
 // LogErrorCommand impl
 LogErrorCommand::LogErrorCommand(std::string_view err, std::string_view logPath)
 : err_(err)
@@ -0,0 +1,190 @@
+#include "coroutine_command.hpp"
+#include "exceptions_impl.hpp"
+
+#include <array>
+#include <cassert>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace exceptions {
+
+namespace {
+
+// The free blocks are kept in arrays rather than linked through the blocks themselves:
+// waking many behaviors at once allocates long runs of cold blocks, and popping a linked
+// list would take a cache miss per block just to read the next pointer.
+class FreeLists {
+public:
+    static constexpr std::size_t classes{FramePool::maxPooled / FramePool::granularity};
+
+    ~FreeLists() {
+        for (auto& blocks: blocks_) {
+            for (auto p: blocks) ::operator delete(p);
+        }
+    }
+
+    void* Pop(std::size_t cls) noexcept {
+        auto& blocks = blocks_[cls];
+        if (blocks.empty()) return nullptr;
+        auto p = blocks.back();
+        blocks.pop_back();
+        return p;
+    }
+
+    void Push(std::size_t cls, void* p) {
+        blocks_[cls].push_back(p);
+    }
+
+private:
+    std::array<std::vector<void*>, classes> blocks_;
+};
+
+thread_local FreeLists freeLists;
+
+} // namespace
+
+// Executes a command awaited by a behavior and enqueues the behavior afterwards
+class Coroutines::CompletionCommand : public ICommand {
+public:
+    CompletionCommand(RunAwaiter& awaiter, Behavior::Handle h, Coroutines& runtime) noexcept
+    : awaiter_{awaiter}
+    , handle_{h}
+    , runtime_{runtime} {}
+
+    // The behavior resumes whatever the command or its handler throws, otherwise it would
+    // stay suspended with its frame alive; anything but a handled IException is rethrown.
+    void Execute() const override {
+        try {
+            awaiter_.cmd->Execute();
+            awaiter_.succeeded = true;
+        } catch (const IException& e) {
+            try {
+                ExceptionHandler::Handle(awaiter_.cmd, e)->Execute();
+            } catch (...) {
+                runtime_.Resume(handle_);
+                throw;
+            }
+        } catch (...) {
+            runtime_.Resume(handle_);
+            throw;
+        }
+        runtime_.Resume(handle_);
+    }
+
+    ICommandUPtr Clone() const override {
+        throw std::logic_error("Awaited commands cannot be cloned");
+    }
+
+    static void* operator new(std::size_t size) { return FramePool::Allocate(size); }
+    static void operator delete(void* p, std::size_t size) noexcept { FramePool::Deallocate(p, size); }
+
+private:
+    RunAwaiter& awaiter_;
+    Behavior::Handle handle_;
+    Coroutines& runtime_;
+};
+
+// FramePool impl
+void* FramePool::Allocate(std::size_t size) {
+    if (size > maxPooled) return ::operator new(size);
+    const auto cls = (size + granularity - 1) / granularity - 1;
+    if (auto p = freeLists.Pop(cls)) return p;
+    return ::operator new((cls + 1) * granularity);
+}
+
+void FramePool::Deallocate(void* p, std::size_t size) noexcept {
+    if (size > maxPooled) {
+        ::operator delete(p);
+        return;
+    }
+    try {
+        freeLists.Push((size + granularity - 1) / granularity - 1, p);
+    } catch (const std::bad_alloc&) {
+        ::operator delete(p);
+    }
+}
+
+// CoroutineCommand impl
+namespace {
+
+Behavior::Handle PromiseOf(std::coroutine_handle<> h) noexcept {
+    return Behavior::Handle::from_address(h.address());
+}
+
+} // namespace
+
+void CoroutineCommand::Execute() const {
+    handle_.resume();
+    if (!handle_.done()) return;
+    // the frame stays until the queue drops this command, handlers still get to see it
+    if (const auto exception = PromiseOf(handle_).promise().exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+ICommandUPtr CoroutineCommand::Clone() const {
+    throw std::logic_error("Coroutine commands cannot be cloned");
+}
+
+void CoroutineCommand::operator delete(CoroutineCommand* cmd, std::destroying_delete_t) noexcept {
+    const auto h = PromiseOf(cmd->handle_);
+    cmd->~CoroutineCommand();
+    if (h.done()) h.promise().runtime->Finish(h);
+}
+
+// Coroutines impl
+Coroutines::~Coroutines() {
+    // pending resume commands live in the frames
+    nextTick_.clear();
+    while (live_) {
+        Finish(Behavior::Handle::from_promise(*live_));
+    }
+}
+
+void Coroutines::Spawn(Behavior behavior) {
+    const auto h = std::exchange(behavior.handle_, {});
+    auto& promise = h.promise();
+    assert(!promise.runtime);
+    promise.runtime = this;
+    promise.next = live_;
+    if (live_) live_->prev = &promise;
+    live_ = &promise;
+    ++alive_;
+    Resume(h);
+}
+
+void Coroutines::Tick() {
+    ++tick_;
+    for (auto& cmd: nextTick_) queue_.Push(std::move(cmd));
+    nextTick_.clear();
+
+    if (timers_.empty()) return;
+    const auto now = Clock::now();
+    while (!timers_.empty() && timers_.top().deadline <= now) {
+        Resume(timers_.top().handle);
+        timers_.pop();
+    }
+}
+
+ICommandUPtr Coroutines::MakeResume(Behavior::Handle h) noexcept {
+    auto& promise = h.promise();
+    auto* slot = promise.resume[promise.nextResume];
+    promise.nextResume ^= 1;
+    return ICommandUPtr{::new (slot) CoroutineCommand{h}};
+}
+
+void Coroutines::Finish(Behavior::Handle h) noexcept {
+    auto& promise = h.promise();
+    if (promise.prev) promise.prev->next = promise.next;
+    else live_ = promise.next;
+    if (promise.next) promise.next->prev = promise.prev;
+    --alive_;
+    h.destroy();
+}
+
+void Coroutines::RunAwaiter::await_suspend(Behavior::Handle h) {
+    runtime.queue_.Push(std::make_unique<CompletionCommand>(*this, h, runtime));
+}
+
+} // namespace exceptions
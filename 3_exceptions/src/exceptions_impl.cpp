@@ -1,35 +1,95 @@
+#include <algorithm>
 #include <cassert>
 #include <format>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 
 #include "command_impl.hpp"
 #include "exceptions_impl.hpp"
 
 namespace exceptions {
 
+namespace {
+
+using MemoKey = std::pair<const std::type_info*, const std::type_info*>;
+
+struct MemoKeyHash {
+    std::size_t operator()(const MemoKey& key) const noexcept {
+        const std::hash<const void*> hash;
+        return hash(key.first) * 31 + hash(key.second);
+    }
+};
+
+// keyed by type_info addresses: two objects for one type only cost an extra entry
+struct Memo {
+    std::uint64_t generation{0};
+    std::unordered_map<MemoKey, const ICommand*, MemoKeyHash> handlers;
+};
+
+thread_local Memo memo;
+
+} // namespace
+
 ICommandUPtr ExceptionHandler::Handle(const ICommandUPtr& cmd, const IException& ex) noexcept {
     try {
-        auto exceptionTblIter = handlersStore_.find(typeid(*cmd));
-        if (std::end(handlersStore_) == exceptionTblIter) return GetDefaultCommand(ex.What());
+        const auto generation = generation_.load(std::memory_order_acquire);
+        if (memo.generation != generation) {
+            memo.handlers.clear();
+            memo.generation = generation;
+        }
 
-        auto handlerIter = exceptionTblIter->second.find(typeid(ex));
-        if (std::end(exceptionTblIter->second) == handlerIter) return GetDefaultCommand(ex.What());
+        const MemoKey key{&typeid(*cmd), &typeid(ex)};
+        auto handlerIter = memo.handlers.find(key);
+        if (std::end(memo.handlers) == handlerIter) {
+            handlerIter = memo.handlers.emplace(key, Resolve(*cmd, ex)).first;
+        }
+        if (nullptr == handlerIter->second) return GetDefaultCommand(ex.GetMessage());
 
         return handlerIter->second->Clone();
     }
     catch(...) {
-        return GetDefaultCommand("Unknown exception caught");
+        return GetDefaultCommand(Message::Literal("Unknown exception caught"));
     }
     assert(false);
     return nullptr;
 }
 
-ICommandUPtr ExceptionHandler::GetDefaultCommand(std::string_view what) {
-    return std::make_unique<PrintError>(std::format(
-        "No registered handler for '{}'", what
-    ));
+void ExceptionHandler::Register(const Probe<ICommand>& command, const Probe<IException>& exception, ICommandUPtr handler) {
+    std::unique_lock lock{mutex_};
+    auto iter = std::find_if(std::begin(registrations_), std::end(registrations_), [&](const Registration& reg) {
+        return *reg.command.type == *command.type && *reg.exception.type == *exception.type;
+    });
+    if (std::end(registrations_) == iter) {
+        registrations_.push_back({command, exception, std::move(handler)});
+    } else {
+        retired_.push_back(std::move(iter->handler));
+        iter->handler = std::move(handler);
+    }
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+const ICommand* ExceptionHandler::Resolve(const ICommand& cmd, const IException& ex) {
+    std::shared_lock lock{mutex_};
+    const Registration* best{nullptr};
+    for (const auto& reg : registrations_) {
+        if (!reg.command.isInstance(cmd) || !reg.exception.isInstance(ex)) continue;
+        if (nullptr == best || MoreSpecific(reg, *best)) best = &reg;
+    }
+    return nullptr == best ? nullptr : best->handler.get();
+}
+
+bool ExceptionHandler::MoreSpecific(const Registration& lhs, const Registration& rhs) {
+    if (*lhs.command.type != *rhs.command.type) return lhs.command.DerivesFrom(rhs.command);
+    return lhs.exception.DerivesFrom(rhs.exception);
+}
+
+ICommandUPtr ExceptionHandler::GetDefaultCommand(const Message& what) {
+    return std::make_unique<PrintUnhandled>(what);
 }
 
 TestException::TestException()
-: IException("Test exception") {}
+: IException(Message::Literal("Test exception")) {}
 
 }; // namespace exceptions
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "loop_metrics.hpp"
+
+#include <cxxabi.h>
+
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace exceptions::metrics {
+
+namespace {
+
+struct Registry {
+    std::mutex mtx;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads;
+    std::vector<ThreadMetrics*> released;  // of exited threads, handed to the next new one
+    std::chrono::steady_clock::time_point lastCollect{std::chrono::steady_clock::now()};
+    std::uint64_t lastExecuted{0};
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+std::string Demangle(const char* name) {
+    int status{0};
+    std::unique_ptr<char, decltype(&std::free)> demangled{
+        abi::__cxa_demangle(name, nullptr, nullptr, &status), &std::free};
+    return 0 == status ? std::string{demangled.get()} : std::string{name};
+}
+
+std::string JsonEscape(std::string_view str) {
+    std::string res;
+    res.reserve(str.size());
+    for (const auto c: str) {
+        if ('"' == c || '\\' == c) res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+void AppendHistogram(std::string& out, const LatencyHistogram& hist) {
+    std::format_to(std::back_inserter(out),
+        R"({{"count":{},"min":{},"mean":{:.1f},"p50":{},"p90":{},"p99":{},"p999":{},"max":{}}})",
+        hist.Count(), hist.Min(), hist.Mean(), hist.Percentile(50.), hist.Percentile(90.),
+        hist.Percentile(99.), hist.Percentile(99.9), hist.Max());
+}
+
+} // namespace
+
+ThreadMetrics& ThreadMetrics::Local() {
+    // Owned by the registry, so the numbers of finished threads stay in the snapshots.
+    // An exited thread gives its metrics back and a new thread keeps counting on them,
+    // so the registry holds as many as threads ever ran at once rather than ever started.
+    struct Lease {
+        Lease() {
+            auto& registry = GetRegistry();
+            std::lock_guard lock{registry.mtx};
+            if (registry.released.empty()) {
+                metrics = registry.threads.emplace_back(std::make_unique<ThreadMetrics>()).get();
+            } else {
+                metrics = registry.released.back();
+                registry.released.pop_back();
+            }
+        }
+
+        ~Lease() {
+            auto& registry = GetRegistry();
+            std::lock_guard lock{registry.mtx};
+            registry.released.push_back(metrics);
+        }
+
+        ThreadMetrics* metrics;
+    };
+    thread_local Lease lease;
+    return *lease.metrics;
+}
+
+ThreadMetrics::TypeSlot& ThreadMetrics::SlotOf(const std::type_info& cmd) {
+    std::lock_guard lock{mtx_};
+    auto& slot = slots_[cmd];
+    if (!slot) slot = std::make_unique<TypeSlot>(cmd);
+    return *slot;
+}
+
+void ThreadMetrics::Failed(const std::type_info& cmd, const std::type_info& ex) {
+    auto* slot = CachedSlot(cmd);
+    Bump(slot->failed, 1);
+    std::lock_guard lock{mtx_};
+    ++exceptions_[{slot->type, std::type_index{ex}}];
+}
+
+Snapshot Collect() {
+    auto& registry = GetRegistry();
+    std::lock_guard registryLock{registry.mtx};
+
+    Snapshot res;
+    for (const auto& thread: registry.threads) {
+        std::lock_guard lock{thread->mtx_};
+        res.executed += thread->executed_.load(std::memory_order_relaxed);
+        for (const auto& [type, slot]: thread->slots_) {
+            auto& stats = res.commands[Demangle(type.name())];
+            const auto executed = slot->executed.load(std::memory_order_relaxed);
+            const auto failed = slot->failed.load(std::memory_order_relaxed);
+            stats.executed += executed;
+            stats.failed += failed;
+            stats.latency.Merge(slot->latency);
+            res.failed += failed;
+        }
+        for (const auto& [types, count]: thread->exceptions_) {
+            res.exceptions[{Demangle(types.first.name()), Demangle(types.second.name())}] += count;
+        }
+        res.queueDepth.Merge(thread->queueDepth_);
+    }
+    res.maxQueueDepth = res.queueDepth.Max();
+
+    const auto now = std::chrono::steady_clock::now();
+    res.interval = now - registry.lastCollect;
+    const auto seconds = std::chrono::duration<double>(res.interval).count();
+    if (seconds > 0. && res.executed >= registry.lastExecuted) {
+        res.commandsPerSecond = static_cast<double>(res.executed - registry.lastExecuted) / seconds;
+    }
+    registry.lastCollect = now;
+    registry.lastExecuted = res.executed;
+    return res;
+}
+
+void Reset() {
+    auto& registry = GetRegistry();
+    std::lock_guard registryLock{registry.mtx};
+    for (const auto& thread: registry.threads) {
+        std::lock_guard lock{thread->mtx_};
+        thread->executed_.store(0, std::memory_order_relaxed);
+        for (auto& [_, slot]: thread->slots_) {
+            slot->executed.store(0, std::memory_order_relaxed);
+            slot->failed.store(0, std::memory_order_relaxed);
+            slot->latency.Reset();
+        }
+        thread->exceptions_.clear();
+        thread->queueDepth_.Reset();
+    }
+    registry.lastCollect = std::chrono::steady_clock::now();
+    registry.lastExecuted = 0;
+}
+
+void WriteSnapshot(const std::filesystem::path& path, Format format) {
+    const auto snapshot = Collect();
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::trunc);
+        if (!ofs) {
+            throw std::runtime_error(std::format("Unable to write metrics snapshot: {}", tmpPath.string()));
+        }
+        ofs << (Format::Json == format ? snapshot.ToJson() : snapshot.ToText());
+    }
+    std::filesystem::rename(tmpPath, path);
+}
+
+std::string Snapshot::ToText() const {
+    std::string out = std::format(
+        "commands: {} failed: {} rate: {:.0f}/s interval: {}ms\n"
+        "queue depth: max {} p50 {} p99 {}\n",
+        executed, failed, commandsPerSecond,
+        std::chrono::duration_cast<std::chrono::milliseconds>(interval).count(),
+        maxQueueDepth, queueDepth.Percentile(50.), queueDepth.Percentile(99.));
+
+    for (const auto& [name, stats]: commands) {
+        std::format_to(std::back_inserter(out),
+            "{}: executed {} failed {} latency ns p50 {} p99 {} max {}\n",
+            name, stats.executed, stats.failed,
+            stats.latency.Percentile(50.), stats.latency.Percentile(99.), stats.latency.Max());
+    }
+    for (const auto& [types, count]: exceptions) {
+        std::format_to(std::back_inserter(out), "{} threw {}: {}\n", types.first, types.second, count);
+    }
+    return out;
+}
+
+std::string Snapshot::ToJson() const {
+    std::string out = std::format(
+        R"({{"interval_ns":{},"executed":{},"failed":{},"commands_per_second":{:.1f},"max_queue_depth":{},"queue_depth":)",
+        interval.count(), executed, failed, commandsPerSecond, maxQueueDepth);
+    AppendHistogram(out, queueDepth);
+
+    out += R"(,"commands":{)";
+    bool first{true};
+    for (const auto& [name, stats]: commands) {
+        std::format_to(std::back_inserter(out), R"({}"{}":{{"executed":{},"failed":{},"latency_ns":)",
+            first ? "" : ",", JsonEscape(name), stats.executed, stats.failed);
+        AppendHistogram(out, stats.latency);
+        out += '}';
+        first = false;
+    }
+
+    out += R"(},"exceptions":[)";
+    first = true;
+    for (const auto& [types, count]: exceptions) {
+        std::format_to(std::back_inserter(out), R"({}{{"command":"{}","exception":"{}","count":{}}})",
+            first ? "" : ",", JsonEscape(types.first), JsonEscape(types.second), count);
+        first = false;
+    }
+    out += "]}\n";
+    return out;
+}
+
+} // namespace exceptions::metrics
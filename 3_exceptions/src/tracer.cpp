@@ -0,0 +1,147 @@
+#include "tracer.hpp"
+
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace exceptions::trace {
+
+namespace {
+
+struct Registry {
+    std::mutex mtx;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    // buffers of exited threads, free for the next thread that starts tracing
+    std::vector<ThreadBuffer*> released;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+std::string Demangle(const char* name) {
+    int status{0};
+    std::unique_ptr<char, decltype(&std::free)> demangled{
+        abi::__cxa_demangle(name, nullptr, nullptr, &status), &std::free};
+    return 0 == status ? std::string{demangled.get()} : std::string{name};
+}
+
+std::string JsonEscape(std::string_view str) {
+    std::string res;
+    res.reserve(str.size());
+    for (const auto c: str) {
+        if ('"' == c || '\\' == c) res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+const char* CategoryName(Category category) {
+    switch (category) {
+        case Category::Command: return "command";
+        case Category::Handler: return "handler";
+        case Category::MacroChild: return "macro_child";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+ThreadBuffer::ThreadBuffer(std::uint32_t tid)
+: tid_{tid}
+, capacity_{capacity.load(std::memory_order_relaxed)}
+, events_{std::make_unique_for_overwrite<Event[]>(capacity_)} {}
+
+ThreadBuffer& ThreadBuffer::Local() {
+    // Owned by the registry, so the events of finished threads stay in the trace.
+    // An exited thread gives its buffer back and a new one appends to it under the same tid,
+    // so the registry holds as many buffers as threads ever traced at once rather than ever started.
+    struct Lease {
+        Lease() {
+            auto& registry = GetRegistry();
+            std::lock_guard lock{registry.mtx};
+            const auto wanted = capacity.load(std::memory_order_relaxed);
+            const auto reusable = std::find_if(registry.released.rbegin(), registry.released.rend(),
+                [wanted](const ThreadBuffer* released) { return released->capacity_ == wanted; });
+            if (registry.released.rend() == reusable) {
+                const auto tid = static_cast<std::uint32_t>(registry.threads.size() + 1);
+                buffer = registry.threads.emplace_back(std::make_unique<ThreadBuffer>(tid)).get();
+            } else {
+                buffer = *reusable;
+                registry.released.erase(std::next(reusable).base());
+            }
+        }
+
+        ~Lease() {
+            auto& registry = GetRegistry();
+            std::lock_guard lock{registry.mtx};
+            registry.released.push_back(buffer);
+        }
+
+        ThreadBuffer* buffer;
+    };
+    thread_local Lease lease;
+    return *lease.buffer;
+}
+
+std::string ToChromeJson() {
+    auto& registry = GetRegistry();
+    std::lock_guard lock{registry.mtx};
+
+    std::string out{R"({"displayTimeUnit":"ns","traceEvents":[)"};
+    bool first{true};
+    for (const auto& thread: registry.threads) {
+        const auto size = thread->size_.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < size; ++i) {
+            const auto& event = thread->events_[i];
+            if (!first) out += ',';
+            first = false;
+            // complete events, microseconds with ns precision
+            std::format_to(std::back_inserter(out),
+                R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{}}})",
+                JsonEscape(Demangle(event.type->name())), CategoryName(event.category),
+                static_cast<double>(event.begin) / 1000., static_cast<double>(event.end - event.begin) / 1000.,
+                thread->tid_);
+        }
+    }
+    out += "]}";
+    return out;
+}
+
+void WriteChromeTrace(const std::filesystem::path& path) {
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out{tmp, std::ios::trunc};
+        if (!out) throw std::runtime_error(std::format("Unable to write trace to {}", tmp.string()));
+        out << ToChromeJson();
+    }
+    std::filesystem::rename(tmp, path);
+}
+
+void Reset() {
+    auto& registry = GetRegistry();
+    std::lock_guard lock{registry.mtx};
+    for (auto& thread: registry.threads) {
+        thread->size_.store(0, std::memory_order_relaxed);
+        thread->dropped_.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::uint64_t Dropped() {
+    auto& registry = GetRegistry();
+    std::lock_guard lock{registry.mtx};
+    std::uint64_t dropped{0};
+    for (const auto& thread: registry.threads) dropped += thread->dropped_.load(std::memory_order_relaxed);
+    return dropped;
+}
+
+} // namespace exceptions::trace
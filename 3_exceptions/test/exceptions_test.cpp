@@ -1,10 +1,22 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
 
+#include <blocking_queue_impl.hpp>
 #include <cmd_loop.hpp>
+#include <coroutine_command.hpp>
 #include <command_impl.hpp>
 #include <exceptions_impl.hpp>
+#include <fair_queue_impl.hpp>
+#include <latency_histogram.hpp>
+#include <loop_metrics.hpp>
+#include <priority_queue_impl.hpp>
 #include <queue_impl.hpp>
+#include <tracer.hpp>
 
 using namespace exceptions;
 namespace fs = std::filesystem;
@@ -187,4 +199,878 @@ TEST(RepeatCmdTest, EnqueCmdThatRepeatsTwiceAndLogCommand) {
 
     EXPECT_TRUE(fs::exists(logPath));
     if (fs::exists(logPath)) fs::remove(logPath);
-}
\ No newline at end of file
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinRelativeError) {
+    LatencyHistogram hist;
+    for (std::uint64_t ns = 1; ns <= 10'000; ++ns) {
+        hist.Record(ns);
+    }
+
+    EXPECT_EQ(10'000, hist.Count());
+    EXPECT_EQ(1, hist.Min());
+    EXPECT_EQ(10'000, hist.Max());
+    EXPECT_NEAR(5'000.5, hist.Mean(), 1e-9);
+    EXPECT_NEAR(5'000., hist.Percentile(50.), 5'000. / 16.);
+    EXPECT_NEAR(9'900., hist.Percentile(99.), 9'900. / 16.);
+    EXPECT_EQ(10'000, hist.Percentile(100.));
+}
+
+TEST(LatencyHistogramTest, MergeAndReset) {
+    LatencyHistogram lhs;
+    LatencyHistogram rhs;
+    lhs.Record(std::chrono::nanoseconds{3});
+    rhs.Record(std::chrono::microseconds{7});
+
+    lhs.Merge(rhs);
+    EXPECT_EQ(2, lhs.Count());
+    EXPECT_EQ(3, lhs.Percentile(50.));
+    EXPECT_EQ(7'000, lhs.Percentile(100.));
+
+    lhs.Reset();
+    EXPECT_EQ(0, lhs.Count());
+    EXPECT_EQ(0, lhs.Percentile(50.));
+}
+
+
+namespace test {
+
+class MetricsNoThrow : public ICommand {
+public:
+    void Execute() const override {}
+    ICommandUPtr Clone() const override { return std::make_unique<MetricsNoThrow>(*this); }
+};
+
+class MetricsThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<MetricsThrow>(*this); }
+};
+
+}  // namespace test
+
+TEST(LoopMetricsTest, CountsCommandsAndExceptionPairs) {
+    if constexpr (!metrics::enabled) {
+        GTEST_SKIP() << "cmd_loop metrics are compiled out";
+    }
+
+    const auto sampleMask = metrics::ThreadMetrics::sampleMask.exchange(0);
+    ExceptionHandler::Register<test::MetricsThrow, TestException>(std::make_unique<test::MetricsNoThrow>());
+    metrics::Reset();
+
+    QueueImpl q;
+    for (int i = 0; i < 3; ++i) {
+        q.Push(std::make_unique<test::MetricsNoThrow>());
+    }
+    q.Push(std::make_unique<test::MetricsThrow>());
+    cmd_loop::run(q);
+
+    const auto snapshot = metrics::Collect();
+    metrics::ThreadMetrics::sampleMask = sampleMask;
+
+    EXPECT_EQ(4, snapshot.executed);
+    EXPECT_EQ(1, snapshot.failed);
+    EXPECT_EQ(4, snapshot.maxQueueDepth);
+
+    const auto& noThrow = snapshot.commands.at("test::MetricsNoThrow");
+    EXPECT_EQ(3, noThrow.executed);
+    EXPECT_EQ(3, noThrow.latency.Count());
+
+    const auto& withThrow = snapshot.commands.at("test::MetricsThrow");
+    EXPECT_EQ(1, withThrow.executed);
+    EXPECT_EQ(1, withThrow.failed);
+    EXPECT_EQ(1, snapshot.exceptions.at({"test::MetricsThrow", "exceptions::TestException"}));
+}
+
+TEST(LoopMetricsTest, CountsEveryCommandAndTimesSampledOnes) {
+    if constexpr (!metrics::enabled) {
+        GTEST_SKIP() << "cmd_loop metrics are compiled out";
+    }
+
+    const auto sampleMask = metrics::ThreadMetrics::sampleMask.exchange(3);
+    ExceptionHandler::Register<test::MetricsThrow, TestException>(std::make_unique<test::MetricsNoThrow>());
+    metrics::Reset();
+
+    QueueImpl q;
+    q.Push(std::make_unique<test::MetricsThrow>());
+    for (int i = 0; i < 7; ++i) {
+        q.Push(std::make_unique<test::MetricsNoThrow>());
+    }
+    cmd_loop::run(q);
+
+    const auto snapshot = metrics::Collect();
+    metrics::ThreadMetrics::sampleMask = sampleMask;
+
+    EXPECT_EQ(8, snapshot.executed);
+    EXPECT_EQ(1, snapshot.failed);
+    EXPECT_EQ(2, snapshot.queueDepth.Count());
+
+    const auto& noThrow = snapshot.commands.at("test::MetricsNoThrow");
+    EXPECT_EQ(8, noThrow.executed);
+    EXPECT_EQ(2, noThrow.latency.Count());
+
+    const auto& withThrow = snapshot.commands.at("test::MetricsThrow");
+    EXPECT_EQ(0, withThrow.executed);
+    EXPECT_EQ(1, withThrow.failed);
+}
+
+TEST(LoopMetricsTest, ExitedThreadMetricsAreReused) {
+    metrics::Reset();
+    const auto countOne = [] {
+        auto& local = metrics::ThreadMetrics::Local();
+        local.Count();
+        return &local;
+    };
+
+    const metrics::ThreadMetrics* first{nullptr};
+    const metrics::ThreadMetrics* second{nullptr};
+    std::thread{[&] { first = countOne(); }}.join();
+    std::thread{[&] { second = countOne(); }}.join();
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(2, metrics::Collect().executed);
+}
+
+TEST(LoopMetricsTest, WritesJsonSnapshot) {
+    const fs::path path = fs::temp_directory_path() / "loop_metrics_test.json";
+    const auto sampleMask = metrics::ThreadMetrics::sampleMask.exchange(0);
+    metrics::Reset();
+
+    auto& local = metrics::ThreadMetrics::Local();
+    ASSERT_TRUE(local.Count());
+    const auto probe = local.Begin(typeid(test::MetricsThrow), 7);
+    local.End(probe);
+    local.Failed(typeid(test::MetricsThrow), typeid(TestException));
+
+    metrics::WriteSnapshot(path, metrics::Format::Json);
+    metrics::ThreadMetrics::sampleMask = sampleMask;
+    std::ifstream ifs(path);
+    const std::string json{std::istreambuf_iterator<char>{ifs}, {}};
+
+    EXPECT_NE(std::string::npos, json.find(R"("executed":1,"failed":1)"));
+    EXPECT_NE(std::string::npos, json.find(R"("command":"test::MetricsThrow","exception":"exceptions::TestException","count":1)"));
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+    fs::remove(path);
+}
+
+
+namespace test {
+
+class RecordingCommand : public ICommand {
+public:
+    RecordingCommand(std::vector<int>& log, int id) : log_{log}, id_{id} {}
+    void Execute() const override { log_.push_back(id_); }
+    ICommandUPtr Clone() const override { return std::make_unique<RecordingCommand>(*this); }
+private:
+    std::vector<int>& log_;
+    int id_;
+};
+
+}  // namespace test
+
+TEST(PriorityQueueTest, PriorityThenEarliestDeadline) {
+    using namespace std::chrono_literals;
+    PriorityQueueImpl q{PriorityQueueImpl::Config{.budgets = {0ns, 0ns}}};
+    std::vector<int> log;
+    const auto now = PriorityQueueImpl::Clock::now();
+
+    q.Push(std::make_unique<test::RecordingCommand>(log, 1), 1, now + 1ms);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 2), 0, now + 3ms);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 3), 0, now + 2ms);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 4), 1, now + 1ms);
+    ASSERT_EQ(4, q.Size());
+
+    cmd_loop::run(q);
+    EXPECT_TRUE(q.IsEmpty());
+    EXPECT_EQ(log, (std::vector<int>{3, 2, 1, 4}));
+}
+
+TEST(PriorityQueueTest, OverflowEvictsLowestClass) {
+    using namespace std::chrono_literals;
+    PriorityQueueImpl q{PriorityQueueImpl::Config{.capacity = 2, .budgets = {0ns, 0ns}}};
+    std::vector<int> log;
+    const auto never = PriorityQueueImpl::Clock::time_point::max();
+
+    EXPECT_TRUE(q.Push(std::make_unique<test::RecordingCommand>(log, 1), 1, never));
+    EXPECT_TRUE(q.Push(std::make_unique<test::RecordingCommand>(log, 2), 1, never));
+    // same class as the queued ones, nothing to evict
+    EXPECT_FALSE(q.Push(std::make_unique<test::RecordingCommand>(log, 3), 1, never));
+    EXPECT_TRUE(q.Push(std::make_unique<test::RecordingCommand>(log, 4), 0, never));
+    EXPECT_EQ(2, q.Size());
+
+    cmd_loop::run(q);
+    EXPECT_EQ(log, (std::vector<int>{4, 1}));
+    EXPECT_EQ(1, q.Stats(1).evicted);
+    EXPECT_EQ(1, q.Stats(1).rejected);
+    EXPECT_EQ(0, q.Stats(0).rejected);
+}
+
+TEST(PriorityQueueTest, OverflowEvictsLatestDeadline) {
+    using namespace std::chrono_literals;
+    PriorityQueueImpl q{PriorityQueueImpl::Config{.capacity = 3, .budgets = {0ns, 0ns}}};
+    std::vector<int> log;
+    const auto now = PriorityQueueImpl::Clock::now();
+
+    // the heap is [1ms, 10ms, 2ms]: the latest deadline is not the last leaf
+    q.Push(std::make_unique<test::RecordingCommand>(log, 1), 1, now + 1ms);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 10), 1, now + 10ms);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 2), 1, now + 2ms);
+    EXPECT_TRUE(q.Push(std::make_unique<test::RecordingCommand>(log, 0), 0, now + 5ms));
+
+    cmd_loop::run(q);
+    EXPECT_EQ(log, (std::vector<int>{0, 1, 2}));
+    EXPECT_THROW(q.Push(std::make_unique<test::RecordingCommand>(log, 3), 2, now), std::out_of_range);
+}
+
+TEST(PriorityQueueTest, RejectNewKeepsQueuedCommands) {
+    PriorityQueueImpl q{PriorityQueueImpl::Config{
+        .capacity = 1,
+        .budgets = {std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}},
+        .overflow = PriorityQueueImpl::Overflow::RejectNew,
+    }};
+    std::vector<int> log;
+    const auto never = PriorityQueueImpl::Clock::time_point::max();
+
+    EXPECT_TRUE(q.Push(std::make_unique<test::RecordingCommand>(log, 1), 1, never));
+    EXPECT_FALSE(q.Push(std::make_unique<test::RecordingCommand>(log, 2), 0, never));
+
+    cmd_loop::run(q);
+    EXPECT_EQ(log, (std::vector<int>{1}));
+    EXPECT_EQ(1, q.TotalStats().rejected);
+}
+
+TEST(PriorityQueueTest, ExpiredCommandsAreShed) {
+    using namespace std::chrono_literals;
+    PriorityQueueImpl q{PriorityQueueImpl::Config{.budgets = {0ns}, .dropExpired = true}};
+    std::vector<int> log;
+    const auto now = PriorityQueueImpl::Clock::now();
+
+    q.Push(std::make_unique<test::RecordingCommand>(log, 1), 0, now - 1ms);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 2), 0, now + 1h);
+    q.Push(std::make_unique<test::RecordingCommand>(log, 3), 0, now - 2ms);
+
+    cmd_loop::run(q);
+    EXPECT_EQ(log, (std::vector<int>{2}));
+    EXPECT_EQ(2, q.Stats(0).expired);
+    EXPECT_EQ(0, q.Size());
+}
+
+TEST(PriorityQueueTest, ClassifierAndHandlerPushes) {
+    using namespace std::chrono_literals;
+    std::vector<int> log;
+    PriorityQueueImpl q{PriorityQueueImpl::Config{
+        .budgets = {1s, 1h},
+        .classify = [](const ICommand& cmd) -> std::size_t {
+            return dynamic_cast<const test::RecordingCommand*>(&cmd) ? 0 : 1;
+        },
+    }};
+
+    // the handler pushes an urgent command while the failed one is still the front
+    test::RecordingCommand urgent{log, 42};
+    ExceptionHandler::Register<test::MetricsThrow, TestException>(std::make_unique<EnqueueCommand>(q, urgent));
+
+    q.Push(std::make_unique<test::MetricsThrow>());
+    q.Push(std::make_unique<test::MetricsNoThrow>());
+    cmd_loop::run(q);
+
+    EXPECT_TRUE(q.IsEmpty());
+    EXPECT_EQ(log, (std::vector<int>{42}));
+}
+
+namespace test {
+
+// Executes in a fixed amount of fake time
+class TimedCommand : public ICommand {
+public:
+    TimedCommand(std::vector<int>& log, int id, std::chrono::nanoseconds& clock, std::chrono::nanoseconds cost)
+    : log_{log}, id_{id}, clock_{clock}, cost_{cost} {}
+    void Execute() const override {
+        log_.push_back(id_);
+        clock_ += cost_;
+    }
+    ICommandUPtr Clone() const override { return std::make_unique<TimedCommand>(*this); }
+private:
+    std::vector<int>& log_;
+    int id_;
+    std::chrono::nanoseconds& clock_;
+    std::chrono::nanoseconds cost_;
+};
+
+class TenantThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<TenantThrow>(*this); }
+};
+
+}  // namespace test
+
+TEST(FairQueueTest, SharesTimeByWeight) {
+    using namespace std::chrono_literals;
+    auto clock = 0ns;
+    FairQueue q{FairQueue::Config{.quantum = 10ns, .now = [&clock] { return clock; }}};
+    const auto light = q.AddTenant(1);
+    const auto heavy = q.AddTenant(3);
+    std::vector<int> log;
+    for (int i = 0; i < 40; ++i) {
+        q.Push(light, std::make_unique<test::TimedCommand>(log, 0, clock, 10ns));
+        q.TenantQueue(heavy).Push(std::make_unique<test::TimedCommand>(log, 1, clock, 10ns));
+    }
+    EXPECT_EQ(80, q.Size());
+    EXPECT_EQ(40, q.TenantQueue(heavy).Size());
+
+    EXPECT_EQ(40, cmd_loop::run(q, 40));
+    EXPECT_EQ(10, std::count(log.begin(), log.end(), 0));
+    EXPECT_EQ(30, std::count(log.begin(), log.end(), 1));
+    EXPECT_EQ(100ns, q.Consumed(light));
+    EXPECT_EQ(300ns, q.Consumed(heavy));
+    EXPECT_EQ((std::vector<int>{0, 1, 1, 1, 0, 1, 1, 1}), std::vector<int>(log.begin(), log.begin() + 8));
+
+    cmd_loop::run(q);
+    EXPECT_TRUE(q.IsEmpty());
+    EXPECT_EQ(0, q.Size());
+}
+
+TEST(FairQueueTest, FloodingTenantDoesNotStarveQuietOne) {
+    using namespace std::chrono_literals;
+    auto clock = 0ns;
+    FairQueue q{FairQueue::Config{.quantum = 10ns, .now = [&clock] { return clock; }}};
+    const auto flood = q.AddTenant();
+    const auto quiet = q.AddTenant();
+    std::vector<int> log;
+    for (int i = 0; i < 100; ++i) {
+        q.Push(flood, std::make_unique<test::TimedCommand>(log, 0, clock, 100ns));
+    }
+    for (int i = 0; i < 5; ++i) {
+        q.Push(quiet, std::make_unique<test::TimedCommand>(log, 1, clock, 1ns));
+    }
+
+    // the expensive command overdraws the flooding tenant, which then waits for its debt to be paid off
+    cmd_loop::run(q, 6);
+    EXPECT_EQ((std::vector<int>{0, 1, 1, 1, 1, 1}), log);
+    EXPECT_TRUE(q.TenantQueue(quiet).IsEmpty());
+    EXPECT_EQ(99, q.Size());
+
+    cmd_loop::run(q);
+    EXPECT_EQ(105, log.size());
+}
+
+TEST(FairQueueTest, DebtSettlesInOneStepAndOutlastsIdleness) {
+    using namespace std::chrono_literals;
+    auto clock = 0ns;
+    FairQueue q{FairQueue::Config{.quantum = 10ns, .now = [&clock] { return clock; }}};
+    const auto a = q.AddTenant();
+    const auto b = q.AddTenant();
+    const auto c = q.AddTenant();
+    std::vector<int> log;
+    for (int i = 0; i < 2; ++i) {
+        q.Push(a, std::make_unique<test::TimedCommand>(log, 0, clock, 1000ns));
+        q.Push(b, std::make_unique<test::TimedCommand>(log, 1, clock, 300ns));
+    }
+    // emptied by the producer, skipped without ever running
+    q.Push(c, std::make_unique<test::TimedCommand>(log, 2, clock, 1ns));
+    q.TenantQueue(c).Pop();
+    EXPECT_EQ(4, q.Size());
+
+    // both end up deep in debt, b pays its own off in 30 rounds and a in 100
+    cmd_loop::run(q);
+    EXPECT_EQ((std::vector<int>{0, 1, 1, 0}), log);
+
+    // b went idle owing 290ns, a fresh tenant goes first until that is paid off
+    log.clear();
+    q.Push(b, std::make_unique<test::TimedCommand>(log, 1, clock, 1ns));
+    for (int i = 0; i < 3; ++i) {
+        q.Push(c, std::make_unique<test::TimedCommand>(log, 2, clock, 1ns));
+    }
+    cmd_loop::run(q);
+    EXPECT_EQ((std::vector<int>{2, 2, 2, 1}), log);
+    EXPECT_TRUE(q.IsEmpty());
+}
+
+TEST(FairQueueTest, HandlerPushesAreChargedToFailedTenant) {
+    using namespace std::chrono_literals;
+    auto clock = 0ns;
+    FairQueue q{FairQueue::Config{.quantum = 10ns, .now = [&clock] { return clock; }}};
+    const auto first = q.AddTenant();
+    const auto second = q.AddTenant();
+    std::vector<int> log;
+    test::TimedCommand retry{log, 42, clock, 1ns};
+    ExceptionHandler::Register<test::TenantThrow, TestException>(std::make_unique<EnqueueCommand>(q, retry));
+
+    q.Push(first, std::make_unique<test::TimedCommand>(log, 0, clock, 1ns));
+    q.Push(second, std::make_unique<test::TenantThrow>());
+    EXPECT_EQ(2, cmd_loop::run(q, 2));
+    EXPECT_EQ(1, q.TenantQueue(second).Size());
+    EXPECT_TRUE(q.TenantQueue(first).IsEmpty());
+
+    cmd_loop::run(q);
+    EXPECT_EQ((std::vector<int>{0, 42}), log);
+
+    FairQueue empty;
+    EXPECT_THROW(empty.Push(std::make_unique<test::TenantThrow>()), std::logic_error);
+    EXPECT_THROW(empty.AddTenant(0), std::invalid_argument);
+}
+
+namespace test {
+
+class CoroThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<CoroThrow>(*this); }
+};
+
+struct SetOnDestroy {
+    ~SetOnDestroy() { flag = true; }
+    bool& flag;
+};
+
+Behavior LogTicks(Coroutines& rt, std::vector<int>& log, int ticks) {
+    for (int i = 0; i < ticks; ++i) {
+        log.push_back(static_cast<int>(rt.CurrentTick()));
+        co_await rt.NextTick();
+    }
+}
+
+Behavior AwaitCommands(Coroutines& rt, std::vector<int>& log) {
+    const bool first = co_await rt.Run(std::make_unique<RecordingCommand>(log, 1));
+    log.push_back(first ? 10 : -10);
+    const bool second = co_await rt.Run(std::make_unique<CoroThrow>());
+    log.push_back(second ? 20 : -20);
+}
+
+class CoroFatal : public ICommand {
+public:
+    void Execute() const override { throw std::runtime_error{"fatal"}; }
+    ICommandUPtr Clone() const override { return std::make_unique<CoroFatal>(*this); }
+};
+
+class CoroHandlerThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<CoroHandlerThrow>(*this); }
+};
+
+Behavior AwaitFailures(Coroutines& rt, std::vector<int>& log) {
+    log.push_back(co_await rt.Run(std::make_unique<CoroFatal>()) ? 1 : -1);
+    log.push_back(co_await rt.Run(std::make_unique<CoroHandlerThrow>()) ? 2 : -2);
+}
+
+Behavior ThrowAfterTick(Coroutines& rt) {
+    co_await rt.NextTick();
+    throw TestException{};
+}
+
+Behavior SleepForever(Coroutines& rt, bool& destroyed) {
+    SetOnDestroy guard{destroyed};
+    co_await rt.SleepFor(std::chrono::hours{1});
+}
+
+Behavior SleepShortly(Coroutines& rt, std::vector<int>& log) {
+    co_await rt.SleepFor(std::chrono::nanoseconds{0});
+    log.push_back(static_cast<int>(rt.CurrentTick()));
+}
+
+}  // namespace test
+
+TEST(CoroutineCommandTest, ResumesOnEveryTick) {
+    QueueImpl q;
+    Coroutines rt{q};
+    std::vector<int> log;
+    rt.Spawn(test::LogTicks(rt, log, 3));
+    rt.Spawn(test::LogTicks(rt, log, 1));
+    EXPECT_EQ(2, rt.Alive());
+
+    for (int tick = 0; tick < 4; ++tick) {
+        cmd_loop::run(q);
+        rt.Tick();
+    }
+    EXPECT_EQ((std::vector<int>{0, 0, 1, 2}), log);
+    EXPECT_EQ(0, rt.Alive());
+    EXPECT_TRUE(q.IsEmpty());
+}
+
+TEST(CoroutineCommandTest, NextTickResumeDoesNotReuseRunningCommand) {
+    QueueImpl q;
+    Coroutines rt{q};
+    std::vector<int> log;
+    rt.Spawn(test::LogTicks(rt, log, 3));
+
+    std::vector<const ICommand*> resumes;
+    for (int tick = 0; tick < 3; ++tick) {
+        resumes.push_back(q.Front().get());
+        cmd_loop::run(q);
+        rt.Tick();
+    }
+    // the resume queued while a command runs is built beside it, not over it
+    EXPECT_NE(resumes[0], resumes[1]);
+    EXPECT_NE(resumes[1], resumes[2]);
+    EXPECT_EQ(resumes[0], resumes[2]);
+}
+
+TEST(CoroutineCommandTest, AwaitsCommandCompletion) {
+    QueueImpl q;
+    Coroutines rt{q};
+    std::vector<int> log;
+    rt.Spawn(test::AwaitCommands(rt, log));
+
+    // the failed command goes to the default handler, the behavior still resumes
+    cmd_loop::run(q);
+    EXPECT_EQ((std::vector<int>{1, 10, -20}), log);
+    EXPECT_EQ(0, rt.Alive());
+}
+
+TEST(CoroutineCommandTest, ResumesWhenCommandOrHandlerThrowsThrough) {
+    QueueImpl q;
+    Coroutines rt{q};
+    std::vector<int> log;
+    ExceptionHandler::Register<test::CoroHandlerThrow, TestException>(std::make_unique<test::CoroFatal>());
+    rt.Spawn(test::AwaitFailures(rt, log));
+
+    // the loop passes on anything but an IException, the behavior resumes regardless
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_THROW(cmd_loop::run(q), std::runtime_error);
+        q.Pop();
+    }
+    cmd_loop::run(q);
+    EXPECT_EQ((std::vector<int>{-1, -2}), log);
+    EXPECT_EQ(0, rt.Alive());
+    EXPECT_TRUE(q.IsEmpty());
+}
+
+TEST(CoroutineCommandTest, BehaviorExceptionReachesHandler) {
+    QueueImpl q;
+    Coroutines rt{q};
+    std::vector<int> log;
+    ExceptionHandler::Register<CoroutineCommand, TestException>(std::make_unique<test::RecordingCommand>(log, 99));
+    rt.Spawn(test::ThrowAfterTick(rt));
+
+    cmd_loop::run(q);
+    EXPECT_EQ(1, rt.Alive());
+    rt.Tick();
+    cmd_loop::run(q);
+    EXPECT_EQ((std::vector<int>{99}), log);
+    EXPECT_EQ(0, rt.Alive());
+}
+
+TEST(CoroutineCommandTest, TimersAndTeardown) {
+    QueueImpl q;
+    std::vector<int> log;
+    bool destroyed{false};
+    {
+        Coroutines rt{q};
+        rt.Spawn(test::SleepForever(rt, destroyed));
+        rt.Spawn(test::SleepShortly(rt, log));
+        cmd_loop::run(q);
+        rt.Tick();
+        cmd_loop::run(q);
+        EXPECT_EQ((std::vector<int>{1}), log);
+        EXPECT_EQ(1, rt.Alive());
+        EXPECT_FALSE(destroyed);
+    }
+    EXPECT_TRUE(destroyed);
+
+    Coroutines rt{q};
+    rt.Spawn(test::LogTicks(rt, log, 1));
+    EXPECT_THROW(q.Front()->Clone(), std::logic_error);
+    cmd_loop::run(q);
+}
+
+namespace test {
+
+class AtomicCounting : public ICommand {
+public:
+    explicit AtomicCounting(std::atomic<int>& counter) : counter_{counter} {}
+    void Execute() const override { counter_.fetch_add(1); }
+    ICommandUPtr Clone() const override { return std::make_unique<AtomicCounting>(*this); }
+private:
+    std::atomic<int>& counter_;
+};
+
+class BlockingThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<BlockingThrow>(*this); }
+};
+
+class PushCounting : public ICommand {
+public:
+    PushCounting(IQueue& queue, std::atomic<int>& counter) : queue_{queue}, counter_{counter} {}
+    void Execute() const override { queue_.Push(std::make_unique<AtomicCounting>(counter_)); }
+    ICommandUPtr Clone() const override { return std::make_unique<PushCounting>(*this); }
+private:
+    IQueue& queue_;
+    std::atomic<int>& counter_;
+};
+
+template<typename TPred>
+bool WaitFor(TPred pred) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+}  // namespace test
+
+TEST(BlockingQueueTest, PersistentLoopExecutesCommandsFromProducers) {
+    BlockingQueue q;
+    std::atomic<int> counter{0};
+    std::jthread loop{[&q](std::stop_token stop) {
+        cmd_loop::run(q, stop, cmd_loop::PersistentConfig{.spin = std::chrono::microseconds{10}, .batch = 16});
+    }};
+
+    std::vector<std::jthread> producers;
+    for (int p = 0; p < 3; ++p) {
+        producers.emplace_back([&q, &counter] {
+            for (int i = 0; i < 1000; ++i) {
+                q.Push(std::make_unique<test::AtomicCounting>(counter));
+            }
+        });
+    }
+    producers.clear();
+    EXPECT_TRUE(test::WaitFor([&counter] { return 3000 == counter.load(); }));
+
+    // the loop is parked by now, a single push has to wake it
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    q.Push(std::make_unique<test::AtomicCounting>(counter));
+    EXPECT_TRUE(test::WaitFor([&counter] { return 3001 == counter.load(); }));
+}
+
+TEST(BlockingQueueTest, StopWakesParkedLoop) {
+    BlockingQueue q;
+    std::atomic<std::size_t> executed{0};
+    std::atomic<bool> done{false};
+    std::jthread loop{[&](std::stop_token stop) {
+        executed = cmd_loop::run(q, stop, cmd_loop::PersistentConfig{.spin = std::chrono::nanoseconds{0}});
+        done = true;
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    EXPECT_FALSE(done.load());
+
+    loop.request_stop();
+    EXPECT_TRUE(test::WaitFor([&done] { return done.load(); }));
+    EXPECT_EQ(0, executed.load());
+}
+
+TEST(BlockingQueueTest, ConsumerSidePushesAndHandlers) {
+    BlockingQueue q;
+    std::atomic<int> counter{0};
+    ExceptionHandler::Register<test::BlockingThrow, TestException>(std::make_unique<test::AtomicCounting>(counter));
+    q.Push(std::make_unique<test::BlockingThrow>());
+    q.Push(std::make_unique<test::PushCounting>(q, counter));
+    q.Push(std::make_unique<test::PushCounting>(q, counter));
+    EXPECT_EQ(3, q.Size());
+
+    // commands pushed while a batch executes join the next batch
+    EXPECT_EQ(3, cmd_loop::run(q, 3));
+    EXPECT_EQ(1, counter.load());
+    EXPECT_EQ(2, q.Size());
+    EXPECT_EQ(2, cmd_loop::run(q, 10));
+    EXPECT_EQ(3, counter.load());
+    EXPECT_TRUE(q.IsEmpty());
+}
+
+TEST(TracerTest, RecordsCommandsAndHandlersOnlyWhileStarted) {
+    const fs::path path = fs::temp_directory_path() / "tracer_test.json";
+    ExceptionHandler::Register<test::MetricsThrow, TestException>(std::make_unique<test::MetricsNoThrow>());
+    trace::Reset();
+
+    QueueImpl q;
+    auto fill = [&q] {
+        q.Push(std::make_unique<test::MetricsNoThrow>());
+        q.Push(std::make_unique<test::MetricsThrow>());
+        q.Push(std::make_unique<test::MetricsNoThrow>());
+    };
+    fill();
+    cmd_loop::run(q);
+
+    trace::Start();
+    fill();
+    cmd_loop::run(q);
+    trace::Stop();
+
+    fill();
+    cmd_loop::run(q);
+
+    trace::WriteChromeTrace(path);
+    std::ifstream ifs(path);
+    const std::string json{std::istreambuf_iterator<char>{ifs}, {}};
+    auto count = [&json](std::string_view what) {
+        std::size_t res{0};
+        for (auto pos = json.find(what); std::string::npos != pos; pos = json.find(what, pos + 1)) ++res;
+        return res;
+    };
+
+    EXPECT_TRUE(json.starts_with(R"({"displayTimeUnit":"ns","traceEvents":[{)"));
+    EXPECT_EQ(3, count(R"("cat":"command")"));
+    EXPECT_EQ(2, count(R"({"name":"test::MetricsNoThrow","cat":"command","ph":"X")"));
+    EXPECT_EQ(1, count(R"({"name":"exceptions::TestException","cat":"handler","ph":"X")"));
+    EXPECT_EQ(0, trace::Dropped());
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+    fs::remove(path);
+
+    trace::Reset();
+    EXPECT_EQ(R"({"displayTimeUnit":"ns","traceEvents":[]})", trace::ToChromeJson());
+}
+
+TEST(TracerTest, FullBufferDropsEvents) {
+    const auto capacity = trace::ThreadBuffer::capacity.exchange(2);
+    trace::Reset();
+    trace::Start();
+    std::thread{[] {
+        QueueImpl q;
+        for (int i = 0; i < 5; ++i) q.Push(std::make_unique<test::MetricsNoThrow>());
+        cmd_loop::run(q);
+    }}.join();
+    trace::Stop();
+    trace::ThreadBuffer::capacity = capacity;
+
+    EXPECT_EQ(3, trace::Dropped());
+    trace::Reset();
+}
+
+TEST(TracerTest, ExitedThreadBuffersAreReused) {
+    trace::Reset();
+    trace::Start();
+    for (int i = 0; i < 2; ++i) {
+        std::thread{[] {
+            QueueImpl q;
+            q.Push(std::make_unique<test::MetricsNoThrow>());
+            cmd_loop::run(q);
+        }}.join();
+    }
+    trace::Stop();
+
+    // the second thread appends to the buffer of the first one
+    const auto json = trace::ToChromeJson();
+    const auto first = json.find(R"("tid":)");
+    ASSERT_NE(std::string::npos, first);
+    const auto second = json.find(R"("tid":)", first + 1);
+    ASSERT_NE(std::string::npos, second);
+    const auto tidOf = [&json](std::size_t pos) { return json.substr(pos, json.find('}', pos) - pos); };
+    EXPECT_EQ(tidOf(first), tidOf(second));
+    trace::Reset();
+}
+
+
+TEST(MessageTest, LiteralIsReferencedAndDetailsFormattedOnDemand) {
+    static constexpr char text[] = "Not enough fuel to burn {} of {} units";
+    const auto msg = Message::Literal(text, 3u, std::int64_t{-5});
+    EXPECT_EQ(text, msg.Text().data());
+    EXPECT_EQ(2, msg.ArgCount());
+    EXPECT_EQ("Not enough fuel to burn 3 of -5 units", msg.Format());
+
+    // runtime text is copied, a copy refers to its own buffer
+    std::string runtime(100, 'x');
+    const auto copied = Message::Copy(runtime);
+    runtime.assign(100, 'y');
+    const Message copy{copied};
+    EXPECT_EQ(std::string(Message::inlineCapacity - 3, 'x') + "...", copy.Text());
+    EXPECT_TRUE(copy.Truncated());
+    EXPECT_NE(copied.Text().data(), copy.Text().data());
+    EXPECT_FALSE(Message::Copy(std::string(Message::inlineCapacity, 'x')).Truncated());
+
+    // a broken placeholder prints as thrown
+    EXPECT_EQ("bad {:q}", (Message::Literal("bad {:q}", 1).Format()));
+}
+
+TEST(MessageTest, OnlyLiteralsAreReferenced) {
+    // a literal ends at its first NUL
+    EXPECT_EQ("Not", Message::Literal("Not\0 enough").Text());
+
+    // a char buffer is copied like any other runtime text
+    char buffer[] = "Local buffer {}";
+    const Message local{buffer, 7};
+    buffer[0] = 'X';
+    EXPECT_EQ("Local buffer {}", local.Text());
+    EXPECT_NE(buffer, local.Text().data());
+    EXPECT_EQ("Local buffer 7", local.Format());
+}
+
+namespace test {
+
+// no handler is ever registered for it
+class UnhandledThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<UnhandledThrow>(*this); }
+};
+
+}  // namespace test
+
+TEST(UnregisteredHandler, DefaultCommandFormatsWhenExecuted) {
+    const ICommandUPtr cmd = std::make_unique<test::UnhandledThrow>();
+    const auto handler = ExceptionHandler::Handle(cmd, TestException{});
+    const auto* print = dynamic_cast<const PrintUnhandled*>(handler.get());
+    ASSERT_NE(nullptr, print);
+    EXPECT_EQ("No registered handler for 'Test exception'", print->Error());
+}
+
+namespace test {
+
+class BaseError : public IException {
+public:
+    BaseError() : IException{Message::Literal("Base error")} {}
+protected:
+    explicit BaseError(const Message& what) : IException{what} {}
+};
+
+class MidError : public BaseError {
+public:
+    MidError() : BaseError{Message::Literal("Mid error")} {}
+protected:
+    explicit MidError(const Message& what) : BaseError{what} {}
+};
+
+class LeafError : public MidError {
+public:
+    LeafError() : MidError{Message::Literal("Leaf error")} {}
+};
+
+class HierarchyThrow : public ICommand {
+public:
+    void Execute() const override { throw LeafError{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<HierarchyThrow>(*this); }
+};
+
+class DerivedHierarchyThrow : public HierarchyThrow {
+public:
+    ICommandUPtr Clone() const override { return std::make_unique<DerivedHierarchyThrow>(*this); }
+};
+
+// runs the resolved handler and reports which counter it bumped
+int HandledBy(const ICommandUPtr& cmd, const IException& ex, std::vector<int>& counters) {
+    const auto before = counters;
+    ExceptionHandler::Handle(cmd, ex)->Execute();
+    for (std::size_t i = 0; i < counters.size(); ++i) {
+        if (before[i] != counters[i]) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+}  // namespace test
+
+TEST(RegisteredHandler, MostDerivedRegisteredBaseWins) {
+    std::vector<int> counters(4, 0);
+    ExceptionHandler::Register<test::HierarchyThrow, test::BaseError>(std::make_unique<test::CountingNoThrow>(counters[0]));
+    ExceptionHandler::Register<test::HierarchyThrow, test::MidError>(std::make_unique<test::CountingNoThrow>(counters[1]));
+    ExceptionHandler::Register<ICommand, test::LeafError>(std::make_unique<test::CountingNoThrow>(counters[2]));
+
+    const ICommandUPtr cmd = std::make_unique<test::HierarchyThrow>();
+    const ICommandUPtr derivedCmd = std::make_unique<test::DerivedHierarchyThrow>();
+
+    // the command type is matched first, the exception type breaks ties
+    EXPECT_EQ(1, test::HandledBy(cmd, test::LeafError{}, counters));
+    EXPECT_EQ(1, test::HandledBy(cmd, test::LeafError{}, counters)); // memoized
+    EXPECT_EQ(1, test::HandledBy(derivedCmd, test::MidError{}, counters));
+    EXPECT_EQ(0, test::HandledBy(derivedCmd, test::BaseError{}, counters));
+    EXPECT_EQ(2, test::HandledBy(std::make_unique<ThrowException>(), test::LeafError{}, counters));
+    EXPECT_EQ(-1, test::HandledBy(std::make_unique<test::UnhandledThrow>(), test::MidError{}, counters));
+
+    // registering drops the memoized resolutions
+    ExceptionHandler::Register<test::HierarchyThrow, test::LeafError>(std::make_unique<test::CountingNoThrow>(counters[3]));
+    EXPECT_EQ(3, test::HandledBy(cmd, test::LeafError{}, counters));
+    EXPECT_EQ(3, test::HandledBy(derivedCmd, test::LeafError{}, counters));
+    EXPECT_EQ(1, test::HandledBy(cmd, test::MidError{}, counters));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace command {
+
+// Properties a command reads and writes, keyed by the state behind the object the command
+// targets (the accessKey() of an adapter, i.e. its entity) and the property name, so adapters
+// of one entity share their keys. Two commands conflict when one of them writes a property
+// the other reads or writes. A command that cannot tell what it touches marks its set
+// unknown, as does a null key, and conflicts with every other command.
+class AccessSet {
+public:
+    struct Access {
+        const void* target;
+        std::string_view property;
+        bool write;
+    };
+
+    void Read(const void* target, std::string_view property) { Add(target, property, false); }
+    // a write covers reading the same property
+    void Write(const void* target, std::string_view property) { Add(target, property, true); }
+    void MarkUnknown() noexcept { unknown_ = true; }
+
+    bool Unknown() const noexcept { return unknown_; }
+    const std::vector<Access>& Accesses() const noexcept { return accesses_; }
+
+    void Clear() noexcept {
+        accesses_.clear();
+        unknown_ = false;
+    }
+
+private:
+    void Add(const void* target, std::string_view property, bool write) {
+        if (!target) unknown_ = true;
+        else accesses_.push_back(Access{target, property, write});
+    }
+
+    std::vector<Access> accesses_;
+    bool unknown_{false};
+};
+
+} // namespace command
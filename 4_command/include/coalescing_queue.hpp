@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <queue_impl.hpp>
+#include <queue_interface.hpp>
+
+#include "loop_command.hpp"
+
+namespace command {
+
+// Coalescing stage in front of an IQueue. Pushed commands collect in a pending window
+// that moves to the inner queue once the inner queue runs dry, i.e. once per tick of
+// cmd_loop::run. Inside a window a mergeable command (see Mergeable) is folded into the
+// pending command with the same type and target, found through a hash index, so e.g.
+// five Moves of one ship cost one read and one write of its properties.
+// Any other command closes the merge window for everything pushed before it, which
+// keeps the outcome identical to executing the commands one by one.
+class CoalescingQueue : public exceptions::IQueue {
+public:
+    explicit CoalescingQueue(std::unique_ptr<exceptions::IQueue> inner = std::make_unique<exceptions::QueueImpl>())
+    : inner_{std::move(inner)}
+    , index_(minIndexSize) {}
+
+    void Push(exceptions::ICommandUPtr cmd) override {
+        if (auto* mergeable = asMergeable_(*cmd)) {
+            const auto key = mergeable->Key();
+            auto& entry = Find(key);
+            if (entry.window == window_ && entry.cmd->Absorb(*mergeable)) {
+                ++merged_;
+                return;
+            }
+            if (entry.window != window_) ++indexed_;
+            entry = Entry{key, mergeable, window_};
+            if (indexed_ * 2 > index_.size()) Grow();
+        } else {
+            CloseWindow();
+        }
+        pending_.push_back(std::move(cmd));
+    }
+
+    void Pop() override { inner_->Pop(); }
+
+    exceptions::ICommandUPtr Take() override {
+        if (inner_->IsEmpty()) Flush();
+        return inner_->Take();
+    }
+
+    const exceptions::ICommandUPtr& Front() const noexcept override {
+        if (inner_->IsEmpty()) Flush();
+        return inner_->Front();
+    }
+
+    bool IsEmpty() const noexcept override { return inner_->IsEmpty() && pending_.empty(); }
+    std::size_t Size() const noexcept override { return inner_->Size() + pending_.size(); }
+
+    // number of commands folded into others so far
+    std::uint64_t Merged() const noexcept { return merged_; }
+
+private:
+    static constexpr std::size_t minIndexSize{64};
+
+    // open addressing, entries of older windows count as empty, so closing a window is O(1)
+    struct Entry {
+        MergeKey key{nullptr, nullptr};
+        MergeableCommand* cmd{nullptr};
+        std::uint32_t window{0};
+    };
+
+    Entry& Find(const MergeKey& key) const noexcept {
+        const auto mask = index_.size() - 1;
+        for (auto i = MergeKeyHash{}(key) & mask;; i = (i + 1) & mask) {
+            auto& entry = index_[i];
+            if (entry.window != window_ || entry.key == key) return entry;
+        }
+    }
+
+    void Grow() {
+        std::vector<Entry> old(index_.size() * 2);
+        old.swap(index_);
+        for (const auto& entry: old) {
+            if (entry.window == window_) Find(entry.key) = entry;
+        }
+    }
+
+    void CloseWindow() const noexcept {
+        indexed_ = 0;
+        if (0 == ++window_) {
+            // stale entries could pass for the new window after wrap-around
+            for (auto& entry: index_) entry.window = 0;
+            window_ = 1;
+        }
+    }
+
+    void Flush() const noexcept {
+        for (auto& cmd: pending_) inner_->Push(std::move(cmd));
+        pending_.clear();
+        CloseWindow();
+    }
+
+    std::unique_ptr<exceptions::IQueue> inner_;
+    // Front() is const for cmd_loop, opening the next window is not
+    mutable std::vector<exceptions::ICommandUPtr> pending_;
+    mutable std::vector<Entry> index_;
+    CastCache<MergeableCommand> asMergeable_;
+    mutable std::uint32_t window_{1};
+    mutable std::size_t indexed_{0};
+    std::uint64_t merged_{0};
+};
+
+} // namespace command
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include <exceptions_impl.hpp>
+#include <primitives.hpp>
+
+#include "command_impl.hpp"
+#include "loop_command.hpp"
+#include "macro_impl.hpp"
+
+namespace command {
+
+class BinaryWriter {
+public:
+    void WriteByte(std::uint8_t val) { buf_.push_back(val); }
+
+    // LEB128: 7 bits per byte, high bit marks continuation
+    void WriteVarint(std::uint64_t val) {
+        while (val >= 0x80) {
+            buf_.push_back(static_cast<std::uint8_t>(val | 0x80));
+            val >>= 7;
+        }
+        buf_.push_back(static_cast<std::uint8_t>(val));
+    }
+
+    // zigzag keeps small negative numbers short: 0, -1, 1, -2 -> 0, 1, 2, 3
+    void WriteZigzag(std::int64_t val) {
+        WriteVarint((static_cast<std::uint64_t>(val) << 1) ^ static_cast<std::uint64_t>(val >> 63));
+    }
+
+    void WriteString(std::string_view str) {
+        WriteVarint(str.size());
+        buf_.insert(buf_.end(), str.begin(), str.end());
+    }
+
+    std::span<const std::uint8_t> Data() const noexcept { return buf_; }
+    void Clear() noexcept { buf_.clear(); }
+
+private:
+    std::vector<std::uint8_t> buf_;
+};
+
+class BinaryReader {
+public:
+    explicit BinaryReader(std::span<const std::uint8_t> data)
+    : data_{data} {}
+
+    std::uint8_t ReadByte() {
+        if (AtEnd()) throw std::invalid_argument("Unexpected end of command record");
+        return data_[pos_++];
+    }
+
+    std::uint64_t ReadVarint() {
+        std::uint64_t val{0};
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const auto byte = ReadByte();
+            val |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (0 == (byte & 0x80)) return val;
+        }
+        throw std::invalid_argument("Malformed varint in command record");
+    }
+
+    std::int64_t ReadZigzag() {
+        const auto val = ReadVarint();
+        return static_cast<std::int64_t>(val >> 1) ^ -static_cast<std::int64_t>(val & 1);
+    }
+
+    std::string_view ReadString() {
+        const auto size = ReadVarint();
+        if (size > data_.size() - pos_) throw std::invalid_argument("Unexpected end of command record");
+        const std::string_view res{reinterpret_cast<const char*>(data_.data() + pos_), size};
+        pos_ += size;
+        return res;
+    }
+
+    bool AtEnd() const noexcept { return pos_ == data_.size(); }
+    std::size_t Remaining() const noexcept { return data_.size() - pos_; }
+    std::size_t Position() const noexcept { return pos_; }
+
+private:
+    std::span<const std::uint8_t> data_;
+    std::size_t pos_{0};
+};
+
+using EntityId = std::uint32_t;
+
+// Checked conversion of a wider index, e.g. a simulation::EntityId, to a codec id
+inline EntityId ToEntityId(std::uint64_t id) {
+    if (id > std::numeric_limits<EntityId>::max()) throw std::out_of_range(std::format("Entity id {} out of range", id));
+    return static_cast<EntityId>(id);
+}
+
+// Reads an id encoded with WriteVarint, one past the range of EntityId makes the record malformed
+inline EntityId ReadEntityId(BinaryReader& in) {
+    const auto id = in.ReadVarint();
+    if (id > std::numeric_limits<EntityId>::max()) throw std::invalid_argument(std::format("Entity id {} out of range", id));
+    return static_cast<EntityId>(id);
+}
+
+// Gives command targets stable ids: commands are encoded against the adapters
+// created here and decoded back into commands bound to the same adapters.
+class CodecContext {
+public:
+    CodecContext() = default;
+    CodecContext(const CodecContext&) = delete;
+    CodecContext& operator=(const CodecContext&) = delete;
+
+    EntityId AddEntity(game::IEntity* entity) {
+        const auto id = ToEntityId(adapters_.size());
+        auto& a = adapters_.emplace_back(entity);
+        ids_[static_cast<const game::IMovingObject*>(&a.moving)] = id;
+        ids_[static_cast<const game::IRotatingObject*>(&a.rotating)] = id;
+        ids_[static_cast<const IFuelConsumingObject*>(&a.fuel)] = id;
+        return id;
+    }
+
+    game::MovingObjectAdapter& Moving(EntityId id) { return adapters_.at(id).moving; }
+    game::RotatingObjectAdapter& Rotating(EntityId id) { return adapters_.at(id).rotating; }
+    FuelConsumingObjectAdapter& Fuel(EntityId id) { return adapters_.at(id).fuel; }
+
+    EntityId IdOf(const void* target) const {
+        const auto iter = ids_.find(target);
+        if (std::end(ids_) == iter) {
+            throw std::logic_error("Command target is not registered in codec context");
+        }
+        return iter->second;
+    }
+
+private:
+    struct Adapters {
+        explicit Adapters(game::IEntity* entity)
+        : moving{entity}
+        , rotating{entity}
+        , fuel{entity} {}
+
+        game::MovingObjectAdapter moving;
+        game::RotatingObjectAdapter rotating;
+        FuelConsumingObjectAdapter fuel;
+    };
+
+    // deque keeps adapter addresses stable while entities are added
+    std::deque<Adapters> adapters_;
+    std::unordered_map<const void*, EntityId> ids_;
+};
+
+// Binary encodings of commands, a record is a one byte tag followed by the payload.
+// Game commands are encoded the same way whether they are queued as LoopCommand<T>
+// or nested in a MacroCommand. The built-in commands are registered on construction;
+// commands holding references to queues or other commands (EnqueueCommand, Repeat*)
+// have no meaningful encoding and are not registered.
+class CommandRegistry {
+public:
+    using Tag = std::uint8_t;
+
+    template<typename TCmd>
+    using Encoder = std::function<void(const TCmd&, BinaryWriter&, const CodecContext&)>;
+    template<typename TCmd>
+    using Decoder = std::function<std::unique_ptr<TCmd>(BinaryReader&, CodecContext&)>;
+
+    enum BuiltinTag : Tag {
+        MoveTag = 1,
+        RotateTag,
+        ChangeVelocityTag,
+        CheckFuelTag,
+        BurnFuelTag,
+        MacroCommandTag,
+        LogErrorTag,
+        PrintErrorTag,
+        ThrowExceptionTag,
+        TryBurnFuelTag,
+    };
+
+    CommandRegistry();
+    CommandRegistry(const CommandRegistry&) = delete;
+    CommandRegistry& operator=(const CommandRegistry&) = delete;
+
+    template<typename TCmd>
+        requires std::derived_from<TCmd, ICommand>
+    void Register(Tag tag, Encoder<TCmd> encode, Decoder<TCmd> decode) {
+        auto& entry = Claim(tag);
+        entry.encode = [encode](const void* cmd, BinaryWriter& out, const CodecContext& ctx) {
+            encode(*static_cast<const TCmd*>(cmd), out, ctx);
+        };
+        entry.decode = [decode](BinaryReader& in, CodecContext& ctx) -> exceptions::ICommandUPtr {
+            return std::make_unique<LoopCommand<TCmd>>(std::move(*decode(in, ctx)));
+        };
+        entry.decodeChild = [decode](BinaryReader& in, CodecContext& ctx) -> ICommandUPtr {
+            return decode(in, ctx);
+        };
+
+        loopTypes_[typeid(LoopCommand<TCmd>)] = {tag, [](const exceptions::ICommand& cmd) -> const void* {
+            return &static_cast<const LoopCommand<TCmd>&>(cmd).Get();
+        }};
+        childTypes_[typeid(TCmd)] = tag;
+    }
+
+    template<typename TCmd>
+        requires std::derived_from<TCmd, exceptions::ICommand>
+    void Register(Tag tag, Encoder<TCmd> encode, Decoder<TCmd> decode) {
+        auto& entry = Claim(tag);
+        entry.encode = [encode](const void* cmd, BinaryWriter& out, const CodecContext& ctx) {
+            encode(*static_cast<const TCmd*>(cmd), out, ctx);
+        };
+        entry.decode = [decode](BinaryReader& in, CodecContext& ctx) -> exceptions::ICommandUPtr {
+            return decode(in, ctx);
+        };
+
+        loopTypes_[typeid(TCmd)] = {tag, [](const exceptions::ICommand& cmd) -> const void* {
+            return &static_cast<const TCmd&>(cmd);
+        }};
+    }
+
+    bool IsRegistered(const exceptions::ICommand& cmd) const {
+        return loopTypes_.contains(typeid(cmd));
+    }
+
+    void Encode(const exceptions::ICommand& cmd, BinaryWriter& out, const CodecContext& ctx) const {
+        const auto iter = loopTypes_.find(typeid(cmd));
+        if (std::end(loopTypes_) == iter) {
+            throw std::logic_error(std::format("No registered encoding for '{}' command", typeid(cmd).name()));
+        }
+        out.WriteByte(iter->second.tag);
+        entries_[iter->second.tag].encode(iter->second.unwrap(cmd), out, ctx);
+    }
+
+    void EncodeChild(const ICommand& cmd, BinaryWriter& out, const CodecContext& ctx) const {
+        const auto iter = childTypes_.find(typeid(cmd));
+        if (std::end(childTypes_) == iter) {
+            throw std::logic_error(std::format("No registered encoding for '{}' command", typeid(cmd).name()));
+        }
+        out.WriteByte(iter->second);
+        entries_[iter->second].encode(&cmd, out, ctx);
+    }
+
+    exceptions::ICommandUPtr Decode(BinaryReader& in, CodecContext& ctx) const {
+        return EntryOf(in.ReadByte()).decode(in, ctx);
+    }
+
+    ICommandUPtr DecodeChild(BinaryReader& in, CodecContext& ctx) const {
+        const auto tag = in.ReadByte();
+        const auto& entry = EntryOf(tag);
+        if (!entry.decodeChild) {
+            throw std::invalid_argument(std::format("Command tag {} can not be nested in a macro", tag));
+        }
+        return entry.decodeChild(in, ctx);
+    }
+
+private:
+    struct Entry {
+        std::function<void(const void*, BinaryWriter&, const CodecContext&)> encode;
+        std::function<exceptions::ICommandUPtr(BinaryReader&, CodecContext&)> decode;
+        std::function<ICommandUPtr(BinaryReader&, CodecContext&)> decodeChild;
+    };
+
+    struct LoopType {
+        Tag tag;
+        const void* (*unwrap)(const exceptions::ICommand&);
+    };
+
+    Entry& Claim(Tag tag) {
+        auto& entry = entries_[tag];
+        if (entry.encode) {
+            throw std::logic_error(std::format("Command tag {} is already registered", tag));
+        }
+        return entry;
+    }
+
+    const Entry& EntryOf(Tag tag) const {
+        const auto& entry = entries_[tag];
+        if (!entry.decode) {
+            throw std::invalid_argument(std::format("Unknown command tag {}", tag));
+        }
+        return entry;
+    }
+
+    std::array<Entry, 256> entries_;
+    std::unordered_map<std::type_index, LoopType> loopTypes_;
+    std::unordered_map<std::type_index, Tag> childTypes_;
+};
+
+namespace detail {
+
+// a merged Move/Rotate stands for several commands, journals record them before coalescing
+inline void RequireSingleStep(std::uint32_t steps) {
+    if (steps != 1) {
+        throw std::invalid_argument(std::format("Merged command of {} steps has no encoding", steps));
+    }
+}
+
+} // namespace detail
+
+inline CommandRegistry::CommandRegistry() {
+    Register<Move>(MoveTag,
+        [](const Move& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            detail::RequireSingleStep(cmd.Steps());
+            out.WriteVarint(ctx.IdOf(cmd.Object()));
+        },
+        [](BinaryReader& in, CodecContext& ctx) {
+            return std::make_unique<Move>(&ctx.Moving(ReadEntityId(in)));
+        });
+
+    Register<Rotate>(RotateTag,
+        [](const Rotate& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            detail::RequireSingleStep(cmd.Steps());
+            out.WriteVarint(ctx.IdOf(cmd.Object()));
+        },
+        [](BinaryReader& in, CodecContext& ctx) {
+            return std::make_unique<Rotate>(&ctx.Rotating(ReadEntityId(in)));
+        });
+
+    Register<ChangeVelocity>(ChangeVelocityTag,
+        [](const ChangeVelocity& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            out.WriteVarint(ctx.IdOf(cmd.RotatingObject()));
+            out.WriteVarint(ctx.IdOf(cmd.MovingObject()));
+        },
+        [](BinaryReader& in, CodecContext& ctx) {
+            auto& rotating = ctx.Rotating(ReadEntityId(in));
+            auto& moving = ctx.Moving(ReadEntityId(in));
+            return std::make_unique<ChangeVelocity>(&rotating, &moving);
+        });
+
+    Register<CheckFuel>(CheckFuelTag,
+        [](const CheckFuel& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            out.WriteVarint(ctx.IdOf(cmd.Object()));
+        },
+        [](BinaryReader& in, CodecContext& ctx) {
+            return std::make_unique<CheckFuel>(&ctx.Fuel(ReadEntityId(in)));
+        });
+
+    Register<BurnFuel>(BurnFuelTag,
+        [](const BurnFuel& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            out.WriteVarint(ctx.IdOf(cmd.Object()));
+        },
+        [](BinaryReader& in, CodecContext& ctx) {
+            return std::make_unique<BurnFuel>(&ctx.Fuel(ReadEntityId(in)));
+        });
+
+    Register<TryBurnFuel>(TryBurnFuelTag,
+        [](const TryBurnFuel& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            out.WriteVarint(ctx.IdOf(cmd.Object()));
+            out.WriteVarint(cmd.Units());
+        },
+        [](BinaryReader& in, CodecContext& ctx) {
+            auto& fuel = ctx.Fuel(ReadEntityId(in));
+            const auto units = in.ReadVarint();
+            if (units > maxFuelUnits) throw std::invalid_argument(std::format("Fuel units {} out of range", units));
+            return std::make_unique<TryBurnFuel>(&fuel, static_cast<std::uint32_t>(units));
+        });
+
+    Register<MacroCommand>(MacroCommandTag,
+        [this](const MacroCommand& cmd, BinaryWriter& out, const CodecContext& ctx) {
+            out.WriteVarint(cmd.Commands().size());
+            for (const auto* child: cmd.Commands()) {
+                EncodeChild(*child, out, ctx);
+            }
+        },
+        [this](BinaryReader& in, CodecContext& ctx) {
+            // every child takes at least its tag byte
+            const auto count = in.ReadVarint();
+            if (count > in.Remaining()) {
+                throw std::invalid_argument(std::format("Macro command of {} children overruns its record", count));
+            }
+            std::vector<ICommandUPtr> children(count);
+            for (auto& child: children) {
+                child = DecodeChild(in, ctx);
+            }
+            return std::make_unique<MacroCommand>(std::move(children));
+        });
+
+    Register<exceptions::LogErrorCommand>(LogErrorTag,
+        [](const exceptions::LogErrorCommand& cmd, BinaryWriter& out, const CodecContext&) {
+            out.WriteString(cmd.Error());
+            out.WriteString(cmd.LogPath());
+        },
+        [](BinaryReader& in, CodecContext&) {
+            const auto err = in.ReadString();
+            return std::make_unique<exceptions::LogErrorCommand>(err, in.ReadString());
+        });
+
+    Register<exceptions::PrintError>(PrintErrorTag,
+        [](const exceptions::PrintError& cmd, BinaryWriter& out, const CodecContext&) {
+            out.WriteString(cmd.Error());
+        },
+        [](BinaryReader& in, CodecContext&) {
+            return std::make_unique<exceptions::PrintError>(in.ReadString());
+        });
+
+    Register<exceptions::ThrowException>(ThrowExceptionTag,
+        [](const exceptions::ThrowException&, BinaryWriter&, const CodecContext&) {},
+        [](BinaryReader&, CodecContext&) {
+            return std::make_unique<exceptions::ThrowException>();
+        });
+}
+
+} // namespace command
@@ -1,13 +1,12 @@
 #pragma once
 
-#include <string_view>
 #include <exceptions_interface.hpp>
 
 namespace command {
 
 class CommandException : public exceptions::IException {
 public:
-    explicit CommandException(std::string_view what) 
+    explicit CommandException(const exceptions::Message& what) noexcept
     : IException{what} {}
 };
 
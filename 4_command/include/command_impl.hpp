@@ -1,46 +1,98 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
 
+#include <caching_adapter.hpp>
 #include <primitives.hpp>
 
 #include "command_interface.hpp"
 #include "command_exception_impl.hpp"
 #include "fuel_consuming_obj_interface.hpp"
+#include "fuel_tank.hpp"
 
 namespace command {
 
-class Move : public ICommand {
+// Move and Rotate can be merged: a command that absorbed later ones for the same
+// object applies all their steps with a single read and write of the properties.
+template<game::Coordinate T>
+class BasicMove : public ICommand {
 public:
-    explicit Move(game::IMovingObject* obj)
+    explicit BasicMove(game::IBasicMovingObject<T>* obj)
     : obj_{obj} {}
 
     void Execute() override {
-        obj_->setLocation(obj_->getLocation().MoveTo(obj_->getVelocity()));
+        auto [location, velocity] = obj_->getMotion();
+        for (std::uint32_t i = 0; i < steps_; ++i) {
+            location.MoveTo(velocity);
+        }
+        obj_->setLocation(location);
+    }
+
+    void DeclareAccess(AccessSet& access) const override {
+        access.Read(obj_->accessKey(), "velocity");
+        access.Write(obj_->accessKey(), "location");
+    }
+
+    game::IBasicMovingObject<T>* Object() const noexcept { return obj_; }
+
+    const void* Target() const noexcept { return obj_; }
+    std::uint32_t Steps() const noexcept { return steps_; }
+    bool Merge(const BasicMove& later) noexcept {
+        if (later.obj_ != obj_) return false;
+        steps_ += later.steps_;
+        return true;
     }
 
 private:
-    game::IMovingObject* obj_{nullptr};
+    game::IBasicMovingObject<T>* obj_{nullptr};
+    std::uint32_t steps_{1};
 };
 
+using Move = BasicMove<int>;
+
 class Rotate : public ICommand {
 public:
     explicit Rotate(game::IRotatingObject* obj) 
     : obj_{obj} {}
 
     void Execute() override {
-        obj_->setAngle(obj_->getAngle() + obj_->getAngularVelocity());
+        auto [angle, angularVelocity] = obj_->getRotation();
+        for (std::uint32_t i = 0; i < steps_; ++i) {
+            angle = angle + angularVelocity;
+        }
+        obj_->setAngle(angle);
+    }
+
+    void DeclareAccess(AccessSet& access) const override {
+        access.Read(obj_->accessKey(), "angular_velocity");
+        access.Write(obj_->accessKey(), "angle");
+    }
+
+    game::IRotatingObject* Object() const noexcept { return obj_; }
+
+    const void* Target() const noexcept { return obj_; }
+    std::uint32_t Steps() const noexcept { return steps_; }
+    bool Merge(const Rotate& later) noexcept {
+        if (later.obj_ != obj_) return false;
+        steps_ += later.steps_;
+        return true;
     }
 
 private:
     game::IRotatingObject* obj_;
+    std::uint32_t steps_{1};
 };
 
 // Реализовать команду для модификации вектора мгновенной скорости при повороте. 
 // Необходимо учесть, что не каждый разворачивающийся объект движется.
-class ChangeVelocity : public ICommand{
+template<game::Coordinate T>
+class BasicChangeVelocity : public ICommand{
+    using Traits = game::CoordinateTraits<T>;
 public:
-    explicit ChangeVelocity(game::IRotatingObject* rObj, game::IMovingObject* mObj)
+    explicit BasicChangeVelocity(game::IRotatingObject* rObj, game::IBasicMovingObject<T>* mObj)
     : rotatingObj_{rObj}
     , movingObj_{mObj}
     {}
@@ -50,8 +102,8 @@ public:
         if (currentVelocity.isZero())
             return;
         
-        const auto cx = static_cast<double>(currentVelocity.x);
-        const auto cy = static_cast<double>(currentVelocity.y);
+        const auto cx = Traits::toDouble(currentVelocity.x);
+        const auto cy = Traits::toDouble(currentVelocity.y);
 
         const auto currentAngle = rotatingObj_->getAngle();
         const auto c = std::cos(currentAngle.rad);
@@ -60,17 +112,51 @@ public:
         const auto nx = cx * c - cy * s;
         const auto ny = cx * s + cy * c;
 
-        const auto newVelocity = game::Vector{static_cast<int>(std::lround(nx)),
-                                              static_cast<int>(std::lround(ny))};
+        const auto newVelocity = game::BasicVector<T>{Traits::fromDouble(nx),
+                                                      Traits::fromDouble(ny)};
 
         movingObj_->setLocation(movingObj_->getLocation().MoveTo(newVelocity));
     }
 
+    void DeclareAccess(AccessSet& access) const override {
+        access.Read(rotatingObj_->accessKey(), "angle");
+        access.Read(movingObj_->accessKey(), "velocity");
+        access.Write(movingObj_->accessKey(), "location");
+    }
+
+    game::IRotatingObject* RotatingObject() const noexcept { return rotatingObj_; }
+    game::IBasicMovingObject<T>* MovingObject() const noexcept { return movingObj_; }
+
 private:
     game::IRotatingObject* rotatingObj_{nullptr};
-    game::IMovingObject* movingObj_{nullptr};
+    game::IBasicMovingObject<T>* movingObj_{nullptr};
 };
 
+using ChangeVelocity = BasicChangeVelocity<int>;
+
+// Last command of a macro that works through a game::BasicCachingAdapter
+template<game::Coordinate T>
+class BasicFlushCache : public ICommand {
+public:
+    explicit BasicFlushCache(game::BasicCachingAdapter<T>* cache)
+    : cache_{cache} {}
+
+    void Execute() override {
+        cache_->Flush();
+    }
+
+    // stores what the cached commands wrote
+    void DeclareAccess(AccessSet& access) const override {
+        access.Write(cache_->accessKey(), "location");
+        access.Write(cache_->accessKey(), "angle");
+    }
+
+private:
+    game::BasicCachingAdapter<T>* cache_;
+};
+
+using FlushCache = BasicFlushCache<int>;
+
 class CheckFuel : public ICommand {
 public:
     explicit CheckFuel(IFuelConsumingObject* obj)
@@ -78,9 +164,14 @@ public:
 
     void Execute() override {
         if (!obj_->CheckFuel()) {
-            throw CommandException{"Not enough fuel"};
+            throw CommandException{exceptions::Message::Literal("Not enough fuel")};
         }
     }
+
+    void DeclareAccess(AccessSet& access) const override { access.Read(obj_->AccessKey(), "fuel"); }
+
+    IFuelConsumingObject* Object() const noexcept { return obj_; }
+
 private:
     IFuelConsumingObject* obj_;
 };
@@ -94,8 +185,57 @@ public:
         obj_->BurnFuel();
     }
 
+    void DeclareAccess(AccessSet& access) const override { access.Write(obj_->AccessKey(), "fuel"); }
+
+    IFuelConsumingObject* Object() const noexcept { return obj_; }
+
+private:
+    IFuelConsumingObject* obj_;
+};
+
+// CheckFuel and BurnFuel in one step, for objects shared between threads
+class TryBurnFuel : public ICommand {
+public:
+    explicit TryBurnFuel(IFuelConsumingObject* obj, std::uint32_t units = 1)
+    : obj_{obj}
+    , units_{units} {}
+
+    void Execute() override {
+        if (!obj_->TryBurn(units_)) {
+            throw CommandException{exceptions::Message::Literal("Not enough fuel to burn {} units", units_)};
+        }
+    }
+
+    void DeclareAccess(AccessSet& access) const override { access.Write(obj_->AccessKey(), "fuel"); }
+
+    IFuelConsumingObject* Object() const noexcept { return obj_; }
+    std::uint32_t Units() const noexcept { return units_; }
+
 private:
     IFuelConsumingObject* obj_;
+    std::uint32_t units_;
+};
+
+// Opens a macro that burns several units: takes them all from the source at once,
+// the following CheckFuel/BurnFuel commands on the reservation stay local.
+class ReserveFuel : public ICommand {
+public:
+    ReserveFuel(FuelReservation* reservation, std::uint32_t units)
+    : reservation_{reservation}
+    , units_{units} {}
+
+    void Execute() override {
+        if (!reservation_->Reserve(units_)) {
+            throw CommandException{exceptions::Message::Literal("Not enough fuel to reserve {} units", units_)};
+        }
+    }
+
+    // the reservation shares the key of its source
+    void DeclareAccess(AccessSet& access) const override { access.Write(reservation_->AccessKey(), "fuel"); }
+
+private:
+    FuelReservation* reservation_;
+    std::uint32_t units_;
 };
 
 class FuelConsumingObjectAdapter : public IFuelConsumingObject {
@@ -113,7 +253,26 @@ public:
         --fuelAmount;
         entity_->setProperty(key, game::IntegerProperty{fuelAmount}.toString());
     }
-    
+
+    // a read and a write of the property, not atomic when the entity is shared, see FuelTank
+    bool TryBurn(std::uint32_t units) override {
+        if (units > maxFuelUnits) return false;
+        const auto fuelAmount = game::IntegerProperty::fromString(entity_->getProperty(key)).val;
+        if (fuelAmount < static_cast<int>(units)) return false;
+        entity_->setProperty(key, game::IntegerProperty{fuelAmount - static_cast<int>(units)}.toString());
+        return true;
+    }
+
+    void Refund(std::uint32_t units) override {
+        const auto fuelAmount = game::IntegerProperty::fromString(entity_->getProperty(key)).val;
+        if (static_cast<std::int64_t>(fuelAmount) + units > maxFuelUnits) {
+            throw std::out_of_range(std::format("Refund of {} units overflows fuel level {}", units, fuelAmount));
+        }
+        entity_->setProperty(key, game::IntegerProperty{fuelAmount + static_cast<int>(units)}.toString());
+    }
+
+    const void* AccessKey() const noexcept override { return entity_; }
+
 private:
     game::IEntity* entity_;
 };
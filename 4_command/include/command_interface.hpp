@@ -1,11 +1,17 @@
 #pragma once
 
+#include <memory>
+
+#include "access_set.hpp"
+
 namespace command {
 
 class ICommand {
 public:
     virtual ~ICommand() = default;
     virtual void Execute() = 0;
+    // commands that know the properties they touch can be executed in parallel
+    virtual void DeclareAccess(AccessSet& access) const { access.MarkUnknown(); }
 };
 
 using ICommandUPtr = std::unique_ptr<ICommand>;
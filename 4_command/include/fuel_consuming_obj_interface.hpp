@@ -1,12 +1,24 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
+
 namespace command {
 
+// fuel levels are ints, no object ever has more units to burn or take back
+inline constexpr std::uint32_t maxFuelUnits = std::numeric_limits<int>::max();
+
 class IFuelConsumingObject {
 public:
     virtual bool CheckFuel() const = 0;
     virtual void BurnFuel() = 0;
+    // burns the units only if that many are left, check and burn are one step
+    virtual bool TryBurn(std::uint32_t units) = 0;
+    // gives back units taken by TryBurn and not used
+    virtual void Refund(std::uint32_t units) = 0;
+    // identity of the fuel behind the object, see game::IBasicMovingObject::accessKey()
+    virtual const void* AccessKey() const noexcept { return nullptr; }
     virtual ~IFuelConsumingObject() = default;
 };
 
-} // namespace command
\ No newline at end of file
+} // namespace command
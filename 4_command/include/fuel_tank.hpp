@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+
+#include "fuel_consuming_obj_interface.hpp"
+
+namespace command {
+
+// Fuel kept in an atomic counter instead of the "fuel" string property, so concurrent
+// commands cannot spend the same units twice: TryBurn() checks and burns with one CAS.
+// Each tank starts on its own cache line, a vector of tanks has no false sharing.
+class alignas(64) FuelTank : public IFuelConsumingObject {
+public:
+    explicit FuelTank(int fuel = 0)
+    : fuel_{fuel} {}
+
+    int Level() const noexcept { return fuel_.load(std::memory_order_relaxed); }
+    void Refill(int units) noexcept { fuel_.fetch_add(units, std::memory_order_relaxed); }
+
+    bool CheckFuel() const override { return Level() > 0; }
+
+    // as FuelConsumingObjectAdapter, goes below zero when called without a check
+    void BurnFuel() override { fuel_.fetch_sub(1, std::memory_order_relaxed); }
+
+    bool TryBurn(std::uint32_t units) override {
+        if (units > maxFuelUnits) return false;
+        const auto need = static_cast<int>(units);
+        auto fuel = fuel_.load(std::memory_order_relaxed);
+        while (fuel >= need) {
+            if (fuel_.compare_exchange_weak(fuel, fuel - need, std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+    void Refund(std::uint32_t units) override {
+        auto fuel = fuel_.load(std::memory_order_relaxed);
+        do {
+            if (static_cast<std::int64_t>(fuel) + units > maxFuelUnits) {
+                throw std::out_of_range(std::format("Refund of {} units overflows fuel level {}", units, fuel));
+            }
+        } while (!fuel_.compare_exchange_weak(fuel, fuel + static_cast<int>(units), std::memory_order_relaxed));
+    }
+
+    const void* AccessKey() const noexcept override { return this; }
+
+private:
+    std::atomic<int> fuel_;
+};
+
+// Units taken from a source in one TryBurn() and handed out locally, so a macro that burns
+// several units pays for one atomic operation instead of one per unit. The units left are
+// given back by the next Reserve(), by Release() and on destruction. The destructor does not
+// throw: units the source refuses to take back there are lost.
+// A reservation belongs to one macro and is not meant to be shared between threads.
+class FuelReservation : public IFuelConsumingObject {
+public:
+    explicit FuelReservation(IFuelConsumingObject* source)
+    : source_{source} {}
+
+    FuelReservation(const FuelReservation&) = delete;
+    FuelReservation& operator=(const FuelReservation&) = delete;
+
+    ~FuelReservation() {
+        try {
+            Release();
+        } catch (...) {
+        }
+    }
+
+    bool Reserve(std::uint32_t units) {
+        Release();
+        if (!source_->TryBurn(units)) return false;
+        reserved_ = units;
+        return true;
+    }
+
+    // keeps the units when the source throws
+    void Release() {
+        if (0 == reserved_) return;
+        source_->Refund(reserved_);
+        reserved_ = 0;
+    }
+
+    std::uint32_t Reserved() const noexcept { return reserved_; }
+    IFuelConsumingObject* Source() const noexcept { return source_; }
+
+    bool CheckFuel() const override { return reserved_ > 0 || source_->CheckFuel(); }
+
+    // from the source once the reservation is used up
+    void BurnFuel() override {
+        if (reserved_ > 0) --reserved_;
+        else source_->BurnFuel();
+    }
+
+    bool TryBurn(std::uint32_t units) override {
+        if (reserved_ < units) return source_->TryBurn(units);
+        reserved_ -= units;
+        return true;
+    }
+
+    void Refund(std::uint32_t units) override {
+        if (static_cast<std::int64_t>(reserved_) + units > maxFuelUnits) {
+            throw std::out_of_range(std::format("Refund of {} units overflows reserved fuel {}", units, reserved_));
+        }
+        reserved_ += units;
+    }
+
+    // may fall through to the source, so it conflicts with everything that uses the source
+    const void* AccessKey() const noexcept override { return source_->AccessKey(); }
+
+private:
+    IFuelConsumingObject* source_;
+    std::uint32_t reserved_{0};
+};
+
+} // namespace command
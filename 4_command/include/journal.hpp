@@ -0,0 +1,298 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <cmd_loop.hpp>
+#include <queue_interface.hpp>
+
+#include "command_codec.hpp"
+
+namespace command {
+
+// Journal file layout:
+//   header: 8 byte magic, u64 payload bytes, u64 record count
+//   record: varint ns since the previous record, varint size, encoded command
+// The header is updated after every append, so a crashed recorder leaves
+// a journal that is readable up to its last complete record.
+struct JournalHeader {
+    static constexpr char magic[8] = {'C', 'M', 'D', 'J', 'R', 'N', 'L', '1'};
+
+    char magicBytes[8];
+    std::uint64_t payloadBytes;
+    std::uint64_t records;
+};
+
+class JournalWriter {
+public:
+    explicit JournalWriter(const std::filesystem::path& path, std::size_t initialCapacity = std::size_t{1} << 20) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "Unable to create journal " + path.string());
+        }
+        try {
+            Remap(std::max(initialCapacity, sizeof(JournalHeader)));
+        } catch (...) {
+            // the destructor does not run, nothing useful is left in the file
+            ::close(fd_);
+            ::unlink(path.c_str());
+            throw;
+        }
+        std::memcpy(Header().magicBytes, JournalHeader::magic, sizeof(JournalHeader::magic));
+    }
+
+    ~JournalWriter() { Close(); }
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    void Append(std::chrono::nanoseconds timestamp, std::span<const std::uint8_t> payload) {
+        const auto delta = static_cast<std::uint64_t>(std::max(timestamp - last_, std::chrono::nanoseconds{0}).count());
+        last_ = std::max(timestamp, last_);
+
+        std::uint8_t prefix[20];
+        const auto prefixSize = PutVarint(PutVarint(prefix, delta), payload.size()) - prefix;
+
+        const auto recordSize = static_cast<std::size_t>(prefixSize) + payload.size();
+        const auto offset = sizeof(JournalHeader) + Header().payloadBytes;
+        if (offset + recordSize > capacity_) {
+            Remap(std::max(capacity_ * 2, offset + recordSize));
+        }
+
+        std::memcpy(data_ + offset, prefix, prefixSize);
+        std::memcpy(data_ + offset + prefixSize, payload.data(), payload.size());
+        Header().payloadBytes += recordSize;
+        ++Header().records;
+    }
+
+    // trims the file to its content, called by the destructor
+    void Close() {
+        if (fd_ < 0) return;
+        if (data_) {
+            const auto size = sizeof(JournalHeader) + Header().payloadBytes;
+            ::munmap(data_, capacity_);
+            [[maybe_unused]] const auto res = ::ftruncate(fd_, static_cast<off_t>(size));
+        }
+        ::close(fd_);
+        fd_ = -1;
+        data_ = nullptr;
+    }
+
+    std::uint64_t Records() const noexcept { return data_ ? Header().records : 0; }
+
+private:
+    static std::uint8_t* PutVarint(std::uint8_t* out, std::uint64_t val) {
+        while (val >= 0x80) {
+            *out++ = static_cast<std::uint8_t>(val | 0x80);
+            val >>= 7;
+        }
+        *out++ = static_cast<std::uint8_t>(val);
+        return out;
+    }
+
+    JournalHeader& Header() const noexcept { return *reinterpret_cast<JournalHeader*>(data_); }
+
+    // the old mapping stays usable if growing fails, the file is trimmed on Close()
+    void Remap(std::size_t capacity) {
+        if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0) {
+            throw std::system_error(errno, std::generic_category(), "Unable to grow journal");
+        }
+        auto* mapped = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (MAP_FAILED == mapped) {
+            throw std::system_error(errno, std::generic_category(), "Unable to map journal");
+        }
+        if (data_) ::munmap(data_, capacity_);
+        data_ = static_cast<std::uint8_t*>(mapped);
+        capacity_ = capacity;
+    }
+
+    int fd_{-1};
+    std::uint8_t* data_{nullptr};
+    std::size_t capacity_{0};
+    std::chrono::nanoseconds last_{0};
+};
+
+class JournalReader {
+public:
+    struct Record {
+        std::chrono::nanoseconds timestamp;
+        std::span<const std::uint8_t> payload;
+    };
+
+    explicit JournalReader(const std::filesystem::path& path) {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "Unable to open journal " + path.string());
+        }
+
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(JournalHeader)) {
+            ::close(fd_);
+            throw std::invalid_argument("Journal is truncated: " + path.string());
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+
+        auto* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (MAP_FAILED == mapped) {
+            ::close(fd_);
+            throw std::system_error(errno, std::generic_category(), "Unable to map journal " + path.string());
+        }
+        data_ = static_cast<const std::uint8_t*>(mapped);
+        ::madvise(mapped, size_, MADV_SEQUENTIAL);
+
+        const auto& header = *reinterpret_cast<const JournalHeader*>(data_);
+        if (0 != std::memcmp(header.magicBytes, JournalHeader::magic, sizeof(JournalHeader::magic))) {
+            Release();
+            throw std::invalid_argument("Not a command journal: " + path.string());
+        }
+        end_ = sizeof(JournalHeader) + std::min<std::size_t>(header.payloadBytes, size_ - sizeof(JournalHeader));
+        records_ = header.records;
+        Rewind();
+    }
+
+    ~JournalReader() { Release(); }
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // returns false at the end of the journal or at a torn record, the position stays put then
+    bool Next(Record& rec) {
+        BinaryReader in{std::span{data_ + pos_, end_ - pos_}};
+        if (in.AtEnd()) return false;
+        try {
+            const auto time = time_ + std::chrono::nanoseconds{in.ReadVarint()};
+            const auto size = in.ReadVarint();
+            const auto header = in.Position();
+            if (size > end_ - pos_ - header) return false;
+            rec = Record{.timestamp = time, .payload = std::span{data_ + pos_ + header, size}};
+            time_ = time;
+            pos_ += header + size;
+            return true;
+        } catch (const std::invalid_argument&) {
+            return false;
+        }
+    }
+
+    void Rewind() noexcept {
+        pos_ = sizeof(JournalHeader);
+        time_ = std::chrono::nanoseconds{0};
+    }
+
+    std::uint64_t Records() const noexcept { return records_; }
+
+private:
+    void Release() noexcept {
+        if (data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+        if (fd_ >= 0) ::close(fd_);
+        data_ = nullptr;
+        fd_ = -1;
+    }
+
+    int fd_{-1};
+    const std::uint8_t* data_{nullptr};
+    std::size_t size_{0};
+    std::size_t end_{0};
+    std::size_t pos_{0};
+    std::uint64_t records_{0};
+    std::chrono::nanoseconds time_{0};
+};
+
+// Tees every pushed command into a journal and forwards it to the wrapped queue.
+// Commands without a registered encoding are forwarded but only counted.
+class RecordingQueue : public exceptions::IQueue {
+public:
+    RecordingQueue(exceptions::IQueue& queue, JournalWriter& journal,
+                   const CommandRegistry& registry, const CodecContext& ctx)
+    : queue_{queue}
+    , journal_{journal}
+    , registry_{registry}
+    , ctx_{ctx}
+    , start_{std::chrono::steady_clock::now()} {}
+
+    void Push(exceptions::ICommandUPtr cmd) override {
+        if (registry_.IsRegistered(*cmd)) {
+            scratch_.Clear();
+            registry_.Encode(*cmd, scratch_, ctx_);
+            journal_.Append(std::chrono::steady_clock::now() - start_, scratch_.Data());
+        } else {
+            ++skipped_;
+        }
+        queue_.Push(std::move(cmd));
+    }
+
+    void Pop() override { queue_.Pop(); }
+    exceptions::ICommandUPtr Take() override { return queue_.Take(); }
+    const exceptions::ICommandUPtr& Front() const noexcept override { return queue_.Front(); }
+    bool IsEmpty() const noexcept override { return queue_.IsEmpty(); }
+    std::size_t Size() const noexcept override { return queue_.Size(); }
+
+    std::size_t Skipped() const noexcept { return skipped_; }
+
+private:
+    exceptions::IQueue& queue_;
+    JournalWriter& journal_;
+    const CommandRegistry& registry_;
+    const CodecContext& ctx_;
+    std::chrono::steady_clock::time_point start_;
+    BinaryWriter scratch_;
+    std::size_t skipped_{0};
+};
+
+enum class ReplaySpeed {
+    Original,  // keeps the recorded gaps between commands
+    Maximum,   // feeds commands as fast as cmd_loop::run drains them
+};
+
+class Replayer {
+public:
+    Replayer(JournalReader& journal, const CommandRegistry& registry, CodecContext& ctx)
+    : journal_{journal}
+    , registry_{registry}
+    , ctx_{ctx} {}
+
+    // Streams the whole journal through the queue and cmd_loop::run,
+    // returns the number of replayed commands
+    std::size_t Run(exceptions::IQueue& queue, ReplaySpeed speed, std::size_t batchSize = 1024) {
+        journal_.Rewind();
+        const auto start = std::chrono::steady_clock::now();
+
+        std::size_t replayed{0};
+        JournalReader::Record rec;
+        while (journal_.Next(rec)) {
+            BinaryReader in{rec.payload};
+            auto cmd = registry_.Decode(in, ctx_);
+
+            if (ReplaySpeed::Original == speed) {
+                std::this_thread::sleep_until(start + rec.timestamp);
+            }
+            queue.Push(std::move(cmd));
+            ++replayed;
+
+            if (ReplaySpeed::Original == speed || queue.Size() >= batchSize) {
+                exceptions::cmd_loop::run(queue);
+            }
+        }
+        exceptions::cmd_loop::run(queue);
+        return replayed;
+    }
+
+private:
+    JournalReader& journal_;
+    const CommandRegistry& registry_;
+    CodecContext& ctx_;
+};
+
+} // namespace command
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include <queue_interface.hpp>
+
+#include "command_interface.hpp"
+
+namespace command {
+
+// Game commands opt into coalescing by naming their target and absorbing
+// a later command of the same type, see CoalescingQueue.
+template<typename TCmd>
+concept Mergeable = requires(TCmd& cmd, const TCmd& later) {
+    { std::as_const(cmd).Target() } -> std::convertible_to<const void*>;
+    { cmd.Merge(later) } -> std::same_as<bool>;
+};
+
+// Commands with equal keys may be merged
+struct MergeKey {
+    const std::type_info* type;
+    const void* target;
+
+    bool operator==(const MergeKey& other) const noexcept {
+        return target == other.target && *type == *other.type;
+    }
+};
+
+struct MergeKeyHash {
+    std::size_t operator()(const MergeKey& key) const noexcept {
+        // type_info addresses are unique within a binary, a type seen under two addresses is merely not merged
+        return (reinterpret_cast<std::uintptr_t>(key.type) ^ reinterpret_cast<std::uintptr_t>(key.target)) * 0x9e3779b97f4a7c15ull >> 16;
+    }
+};
+
+// exceptions::ICommand side of every LoopCommand<T>
+class GameLoopCommand : public exceptions::ICommand {
+public:
+    // read and write set of the wrapped game command
+    virtual void DeclareAccess(AccessSet& access) const = 0;
+};
+
+class MergeableCommand : public GameLoopCommand {
+public:
+    virtual MergeKey Key() const noexcept = 0;
+    // folds a later command with the same key into this one, false if it cannot be merged
+    virtual bool Absorb(const MergeableCommand& later) noexcept = 0;
+};
+
+namespace detail {
+
+template<typename TCmd, bool = Mergeable<TCmd>>
+class LoopCommandBase : public GameLoopCommand {
+protected:
+    explicit LoopCommandBase(TCmd cmd) : cmd_{std::move(cmd)} {}
+
+    // game commands are not const-callable
+    mutable TCmd cmd_;
+};
+
+template<typename TCmd>
+class LoopCommandBase<TCmd, true> : public MergeableCommand {
+public:
+    MergeKey Key() const noexcept override { return MergeKey{&typeid(TCmd), cmd_.Target()}; }
+
+    bool Absorb(const MergeableCommand& later) noexcept override {
+        return *later.Key().type == typeid(TCmd)
+            && cmd_.Merge(static_cast<const LoopCommandBase&>(later).cmd_);
+    }
+
+protected:
+    explicit LoopCommandBase(TCmd cmd) : cmd_{std::move(cmd)} {}
+
+    mutable TCmd cmd_;
+};
+
+} // namespace detail
+
+// Lets a game command travel through exceptions::IQueue and cmd_loop::run.
+// Every wrapped type is a distinct exceptions::ICommand type, so handlers
+// can be registered per game command, e.g. for LoopCommand<CheckFuel>.
+template<typename TCmd>
+class LoopCommand : public detail::LoopCommandBase<TCmd> {
+public:
+    explicit LoopCommand(TCmd cmd)
+    : detail::LoopCommandBase<TCmd>{std::move(cmd)} {}
+
+    void Execute() const override { this->cmd_.Execute(); }
+
+    void DeclareAccess(AccessSet& access) const override {
+        if constexpr (std::derived_from<TCmd, ICommand>) this->cmd_.DeclareAccess(access);
+        else access.MarkUnknown();
+    }
+
+    exceptions::ICommandUPtr Clone() const override {
+        return std::make_unique<LoopCommand>(*this);
+    }
+
+    const TCmd& Get() const noexcept { return this->cmd_; }
+};
+
+// dynamic_cast of a queued command to one of the interfaces above, memoized per dynamic
+// type: a queue stage doing it for every command would pay more for the cast than for its work
+template<typename T>
+class CastCache {
+public:
+    T* operator()(exceptions::ICommand& cmd) noexcept {
+        const auto* type = &typeid(cmd);
+        auto& cached = entries_[reinterpret_cast<std::uintptr_t>(type) / alignof(std::type_info) % entries_.size()];
+        if (cached.type != type) {
+            auto* res = dynamic_cast<T*>(&cmd);
+            cached = Entry{type, res ? reinterpret_cast<std::byte*>(res) - reinterpret_cast<std::byte*>(&cmd) : none};
+        }
+        if (none == cached.offset) return nullptr;
+        return reinterpret_cast<T*>(reinterpret_cast<std::byte*>(&cmd) + cached.offset);
+    }
+
+private:
+    static constexpr std::ptrdiff_t none{-1};
+
+    struct Entry {
+        const std::type_info* type{nullptr};
+        std::ptrdiff_t offset{none};
+    };
+
+    std::array<Entry, 8> entries_;
+};
+
+template<typename TCmd, typename... TArgs>
+exceptions::ICommandUPtr MakeLoopCommand(TArgs&&... args) {
+    return std::make_unique<LoopCommand<TCmd>>(TCmd{std::forward<TArgs>(args)...});
+}
+
+} // namespace command
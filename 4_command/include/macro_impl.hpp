@@ -1,8 +1,12 @@
 #pragma once
 
 #include "command_interface.hpp"
+#include <memory>
+#include <typeinfo>
 #include <vector>
 
+#include <tracer.hpp>
+
 namespace command {
 
 class MacroCommand : public ICommand {
@@ -13,14 +17,37 @@ public:
     : commands_(std::move(commands)) 
     {}
 
+    // owns its children, copies of the macro share them
+    explicit MacroCommand(std::vector<ICommandUPtr>&& owned)
+    : owned_{std::make_shared<std::vector<ICommandUPtr>>(std::move(owned))} {
+        commands_.reserve(owned_->size());
+        for (const auto& cmd: *owned_) {
+            commands_.push_back(cmd.get());
+        }
+    }
+
     void Execute() override {
         for (auto& cmd: commands_) {
-            cmd->Execute();
+            if (exceptions::trace::Enabled()) [[unlikely]] {
+                const exceptions::trace::Span span{exceptions::trace::Category::MacroChild, typeid(*cmd)};
+                cmd->Execute();
+            } else {
+                cmd->Execute();
+            }
         }
     }
 
+    void DeclareAccess(AccessSet& access) const override {
+        for (const auto* cmd: commands_) {
+            cmd->DeclareAccess(access);
+        }
+    }
+
+    const ICommandsArr& Commands() const noexcept { return commands_; }
+
 private:
     ICommandsArr commands_;
+    std::shared_ptr<std::vector<ICommandUPtr>> owned_;
 };
 
 } // namespace command
\ No newline at end of file
@@ -0,0 +1,557 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <futex.hpp>
+#include <queue_interface.hpp>
+
+#include "command_codec.hpp"
+
+namespace command {
+
+// Shared memory layout:
+//   ShmHeader, then config.slots ShmSlot, then one ring of config.ringBytes per slot.
+//   record: u32 payload size, payload, padded to 8 bytes; a size of wrapMarker skips to the ring start
+// Every producer owns a slot and writes its own single producer ring, so several producers
+// never contend and a producer dying mid-record cannot corrupt the stream: a record becomes
+// visible only when the slot head moves past it. A slot is owned through an OFD lock on one
+// byte of the segment, which the kernel releases when its process dies, whatever the reason.
+// The consumer holds such a lock on a byte past the slots, so a segment is only ever replaced
+// once its consumer is gone.
+struct ShmConfig {
+    std::uint32_t slots{8};                     // maximum number of producers
+    std::uint64_t ringBytes{std::uint64_t{1} << 20};  // per slot, a power of two
+};
+
+namespace detail {
+
+struct ShmHeader {
+    static constexpr char magic[8] = {'C', 'M', 'D', 'S', 'H', 'M', '0', '1'};
+
+    char magicBytes[8];
+    std::uint32_t slots;
+    std::uint64_t ringBytes;
+    std::atomic<std::uint32_t> ready;
+    alignas(64) std::atomic<std::uint32_t> dataSeq;  // futex, bumped after every publish
+    std::atomic<std::uint32_t> consumerSleeping;
+};
+
+struct ShmSlot {
+    alignas(64) std::atomic<std::int32_t> owner;  // producer pid, 0 when free
+    std::atomic<std::uint32_t> spaceSeq;          // futex, bumped when the consumer frees space for a waiting producer
+    std::atomic<std::uint32_t> producerWaiting;
+    alignas(64) std::atomic<std::uint64_t> head;  // bytes published
+    alignas(64) std::atomic<std::uint64_t> tail;  // bytes consumed
+};
+
+inline constexpr std::uint32_t wrapMarker{0xffffffff};
+inline constexpr std::size_t recordAlign{8};
+
+inline std::uint64_t RecordBytes(std::size_t payload) noexcept {
+    return (sizeof(std::uint32_t) + payload + recordAlign - 1) & ~(recordAlign - 1);
+}
+
+inline std::size_t SegmentBytes(std::uint32_t slots, std::uint64_t ringBytes) noexcept {
+    return sizeof(ShmHeader) + slots * sizeof(ShmSlot) + slots * ringBytes;
+}
+
+// Maps a shared memory segment, unmaps and closes it on destruction
+class ShmMapping {
+public:
+    ShmMapping(int fd, std::size_t size) : fd_{fd}, size_{size} {
+        auto* mapped = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (MAP_FAILED == mapped) {
+            const auto err = errno;
+            ::close(fd_);
+            throw std::system_error(err, std::generic_category(), "Unable to map command segment");
+        }
+        data_ = static_cast<std::uint8_t*>(mapped);
+    }
+
+    ~ShmMapping() {
+        ::munmap(data_, size_);
+        ::close(fd_);
+    }
+
+    ShmMapping(const ShmMapping&) = delete;
+    ShmMapping& operator=(const ShmMapping&) = delete;
+
+    int Fd() const noexcept { return fd_; }
+
+    ShmHeader& Header() const noexcept { return *reinterpret_cast<ShmHeader*>(data_); }
+
+    ShmSlot& Slot(std::uint32_t idx) const noexcept {
+        return reinterpret_cast<ShmSlot*>(data_ + sizeof(ShmHeader))[idx];
+    }
+
+    std::size_t Size() const noexcept { return size_; }
+
+    std::uint8_t* Ring(std::uint32_t idx) const noexcept {
+        const auto& header = Header();
+        return Ring(idx, header.slots, header.ringBytes);
+    }
+
+    // the layout is passed by the consumer, which does not trust the shared header
+    std::uint8_t* Ring(std::uint32_t idx, std::uint32_t slots, std::uint64_t ringBytes) const noexcept {
+        return data_ + sizeof(ShmHeader) + slots * sizeof(ShmSlot) + idx * ringBytes;
+    }
+
+private:
+    int fd_;
+    std::size_t size_;
+    std::uint8_t* data_{nullptr};
+};
+
+// a write lock on byte idx of the segment marks slot idx as owned
+inline flock SlotLock(std::uint32_t idx, short type) noexcept {
+    flock lock{};
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = static_cast<off_t>(idx);
+    lock.l_len = 1;
+    return lock;
+}
+
+// held by the consumer for the lifetime of the segment, beyond any slot index
+inline flock ConsumerLock(short type) noexcept {
+    flock lock{};
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = static_cast<off_t>(std::uint64_t{1} << 32);
+    lock.l_len = 1;
+    return lock;
+}
+
+} // namespace detail
+
+// Owns the segment: creates it, drains the producer rings and unlinks it on destruction.
+// A segment of the same name is replaced only if its consumer has died, otherwise Create throws.
+// Producers are not trusted: the layout is taken from the consumer's own config, and a slot
+// whose head or record sizes do not fit its ring is dropped and freed like a crashed producer.
+class ShmConsumer {
+public:
+    ShmConsumer(std::string name, ShmConfig config = {})
+    : name_{std::move(name)}
+    , map_{Create(name_, config)}
+    , slots_{config.slots}
+    , ringBytes_{config.ringBytes} {
+        auto& header = *new (&map_.Header()) detail::ShmHeader{};
+        header.slots = config.slots;
+        header.ringBytes = config.ringBytes;
+        for (std::uint32_t i = 0; i < config.slots; ++i) {
+            new (&map_.Slot(i)) detail::ShmSlot{};
+        }
+        std::memcpy(header.magicBytes, detail::ShmHeader::magic, sizeof(detail::ShmHeader::magic));
+        header.ready.store(1, std::memory_order_release);
+    }
+
+    ~ShmConsumer() { ::shm_unlink(name_.c_str()); }
+
+    ShmConsumer(const ShmConsumer&) = delete;
+    ShmConsumer& operator=(const ShmConsumer&) = delete;
+
+    // The oldest unconsumed record of the next non-empty ring, the rings are visited round robin.
+    // The record stays valid until Consume().
+    bool Peek(std::span<const std::uint8_t>& record) noexcept {
+        const auto slots = slots_;
+        for (std::uint32_t n = 0; n < slots; ++n) {
+            const auto idx = next_ + n < slots ? next_ + n : next_ + n - slots;
+            if (PeekSlot(idx, record)) {
+                current_ = idx;
+                next_ = idx + 1 < slots ? idx + 1 : 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // drops the record returned by the last Peek()
+    void Consume() noexcept {
+        auto& slot = map_.Slot(current_);
+        slot.tail.store(slot.tail.load(std::memory_order_relaxed) + currentBytes_, std::memory_order_release);
+        // pairs with the fence in ShmProducer::Push(): either the producer sees the space or we see it waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (slot.producerWaiting.load(std::memory_order_relaxed)) {
+            slot.spaceSeq.fetch_add(1);
+            exceptions::futex::WakeAll(slot.spaceSeq);
+        }
+    }
+
+    // Blocks until a record is available or the timeout expires, returns false on timeout.
+    // Slots of crashed producers are reclaimed while waiting.
+    bool Wait(std::chrono::nanoseconds timeout) noexcept {
+        if (HasRecords()) return true;
+        auto& header = map_.Header();
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        // dataSeq may also be bumped for records already consumed, so wake-ups are re-checked
+        while (true) {
+            const auto seq = header.dataSeq.load(std::memory_order_relaxed);
+            header.consumerSleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const auto ready = HasRecords();
+            if (!ready) {
+                exceptions::futex::Wait(header.dataSeq, seq, deadline - std::chrono::steady_clock::now());
+            }
+            header.consumerSleeping.store(0, std::memory_order_relaxed);
+            if (ready || HasRecords()) return true;
+            if (std::chrono::steady_clock::now() >= deadline) break;
+        }
+        ReapCrashedProducers();
+        return false;
+    }
+
+    bool HasRecords() const noexcept {
+        const auto slots = slots_;
+        for (std::uint32_t i = 0; i < slots; ++i) {
+            const auto& slot = map_.Slot(i);
+            if (slot.head.load(std::memory_order_acquire) != slot.tail.load(std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+    // Frees the slots whose owner died without detaching, the records it published stay readable.
+    // Returns the number of reclaimed slots.
+    std::size_t ReapCrashedProducers() noexcept {
+        std::size_t reaped{0};
+        for (std::uint32_t i = 0; i < slots_; ++i) {
+            auto& slot = map_.Slot(i);
+            auto owner = slot.owner.load();
+            if (0 == owner) continue;
+            auto lock = detail::SlotLock(i, F_WRLCK);
+            if (::fcntl(map_.Fd(), F_OFD_GETLK, &lock) != 0 || F_UNLCK != lock.l_type) continue;
+            // owned but unlocked: the owner is gone, unless a new producer claims the slot meanwhile
+            if (slot.owner.compare_exchange_strong(owner, 0)) {
+                ++reaped;
+            }
+        }
+        crashed_ += reaped;
+        return reaped;
+    }
+
+    std::uint64_t CrashedProducers() const noexcept { return crashed_; }
+
+    // slots dropped because their producer published a malformed ring
+    std::uint64_t CorruptProducers() const noexcept { return corrupt_; }
+
+    std::size_t Producers() const noexcept {
+        std::size_t res{0};
+        for (std::uint32_t i = 0; i < slots_; ++i) {
+            if (0 != map_.Slot(i).owner.load(std::memory_order_relaxed)) ++res;
+        }
+        return res;
+    }
+
+    const std::string& Name() const noexcept { return name_; }
+
+private:
+    static detail::ShmMapping Create(const std::string& name, const ShmConfig& config) {
+        if (0 == config.slots || !std::has_single_bit(config.ringBytes) || config.ringBytes < 64) {
+            throw std::invalid_argument("Ring size must be a power of two of at least 64 bytes and slots positive");
+        }
+        // a segment left behind by a crashed consumer is replaced; its lock is kept until the
+        // new segment exists, so a third consumer cannot take the old one for stale meanwhile
+        int stale{-1};
+        int fd{-1};
+        int openError{EEXIST};
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd >= 0) break;
+            if (EEXIST != errno) {
+                openError = errno;
+                break;
+            }
+            if (stale >= 0) ::close(std::exchange(stale, -1));
+            stale = LockStale(name);
+            if (stale >= 0) ::shm_unlink(name.c_str());
+        }
+        if (stale >= 0) ::close(stale);
+        if (fd < 0) {
+            throw std::system_error(openError, std::generic_category(), "Unable to create command segment " + name);
+        }
+
+        auto lock = detail::ConsumerLock(F_WRLCK);
+        const auto size = detail::SegmentBytes(config.slots, config.ringBytes);
+        if (::fcntl(fd, F_OFD_SETLK, &lock) != 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            const auto err = errno;
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::system_error(err, std::generic_category(), "Unable to set up command segment " + name);
+        }
+        return detail::ShmMapping{fd, size};
+    }
+
+    // Locks the segment behind name if its consumer is gone and name still refers to it.
+    // Returns the locked descriptor, or -1 if the name went away or was replaced meanwhile.
+    static int LockStale(const std::string& name) {
+        const auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            if (ENOENT == errno) return -1;
+            throw std::system_error(errno, std::generic_category(), "Unable to open command segment " + name);
+        }
+        auto lock = detail::ConsumerLock(F_WRLCK);
+        if (::fcntl(fd, F_OFD_SETLK, &lock) != 0) {
+            const auto err = errno;
+            ::close(fd);
+            if (EAGAIN == err || EACCES == err) throw std::runtime_error("Command segment " + name + " already has a consumer");
+            throw std::system_error(err, std::generic_category(), "Unable to lock command segment " + name);
+        }
+        const auto current = ::shm_open(name.c_str(), O_RDONLY, 0);
+        struct stat locked{};
+        struct stat named{};
+        const bool same = current >= 0 && 0 == ::fstat(fd, &locked) && 0 == ::fstat(current, &named)
+            && locked.st_dev == named.st_dev && locked.st_ino == named.st_ino;
+        if (current >= 0) ::close(current);
+        if (same) return fd;
+        ::close(fd);
+        return -1;
+    }
+
+    bool PeekSlot(std::uint32_t idx, std::span<const std::uint8_t>& record) noexcept {
+        auto& slot = map_.Slot(idx);
+        const auto ringBytes = ringBytes_;
+        auto tail = slot.tail.load(std::memory_order_relaxed);
+        const auto head = slot.head.load(std::memory_order_acquire);
+        if (tail == head) return false;
+        if (head - tail > ringBytes || 0 != tail % detail::recordAlign) return DropSlot(idx);
+
+        const auto* ring = map_.Ring(idx, slots_, ringBytes);
+        auto offset = tail & (ringBytes - 1);
+        std::uint32_t size;
+        std::memcpy(&size, ring + offset, sizeof(size));
+        if (detail::wrapMarker == size) {
+            tail += ringBytes - offset;
+            if (head - tail < sizeof(size) || head - tail > ringBytes) return DropSlot(idx);
+            slot.tail.store(tail, std::memory_order_release);
+            offset = 0;
+            std::memcpy(&size, ring, sizeof(size));
+        }
+        // the record has to lie within the ring and within what was published
+        if (size > ringBytes - offset - sizeof(size) || detail::RecordBytes(size) > head - tail) return DropSlot(idx);
+
+        record = std::span{ring + offset + sizeof(size), size};
+        currentBytes_ = detail::RecordBytes(size);
+        return true;
+    }
+
+    // skips everything the slot published and frees it; a producer still attached keeps
+    // its lock, so the slot is not handed out again before it detaches
+    bool DropSlot(std::uint32_t idx) noexcept {
+        auto& slot = map_.Slot(idx);
+        slot.tail.store(slot.head.load(std::memory_order_acquire), std::memory_order_release);
+        slot.owner.store(0, std::memory_order_release);
+        ++corrupt_;
+        return false;
+    }
+
+    std::string name_;
+    detail::ShmMapping map_;
+    std::uint32_t next_{0};
+    std::uint32_t current_{0};
+    std::uint32_t slots_;
+    std::uint64_t ringBytes_;
+    std::uint64_t currentBytes_{0};
+    std::uint64_t crashed_{0};
+    std::uint64_t corrupt_{0};
+};
+
+// Attaches to a consumer's segment and claims a free slot, detaches on destruction.
+class ShmProducer {
+public:
+    explicit ShmProducer(const std::string& name)
+    : map_{Open(name)} {
+        const auto& header = map_.Header();
+        if (0 == header.ready.load(std::memory_order_acquire)
+            || 0 != std::memcmp(header.magicBytes, detail::ShmHeader::magic, sizeof(detail::ShmHeader::magic))) {
+            throw std::invalid_argument("Not a command segment: " + name);
+        }
+        if (0 == header.slots || !std::has_single_bit(header.ringBytes)
+            || map_.Size() < detail::SegmentBytes(header.slots, header.ringBytes)) {
+            throw std::invalid_argument("Command segment is truncated: " + name);
+        }
+        Claim();
+        ring_ = map_.Ring(slot_);
+        ringBytes_ = header.ringBytes;
+    }
+
+    ~ShmProducer() {
+        map_.Slot(slot_).owner.store(0, std::memory_order_release);
+        auto lock = detail::SlotLock(slot_, F_UNLCK);
+        ::fcntl(map_.Fd(), F_OFD_SETLK, &lock);
+    }
+
+    ShmProducer(const ShmProducer&) = delete;
+    ShmProducer& operator=(const ShmProducer&) = delete;
+
+    // returns false when the ring is full
+    bool TryPush(std::span<const std::uint8_t> payload) {
+        const auto bytes = detail::RecordBytes(payload.size());
+        if (bytes > ringBytes_ / 2) throw std::invalid_argument("Command record does not fit the ring");
+
+        auto& slot = map_.Slot(slot_);
+        auto head = slot.head.load(std::memory_order_relaxed);
+        const auto tail = slot.tail.load(std::memory_order_acquire);
+        const auto offset = head & (ringBytes_ - 1);
+        const auto contiguous = ringBytes_ - offset;
+        const auto needed = bytes > contiguous ? contiguous + bytes : bytes;
+        if (head + needed - tail > ringBytes_) return false;
+
+        auto* out = ring_ + offset;
+        if (bytes > contiguous) {
+            std::memcpy(out, &detail::wrapMarker, sizeof(detail::wrapMarker));
+            head += contiguous;
+            out = ring_;
+        }
+        const auto size = static_cast<std::uint32_t>(payload.size());
+        std::memcpy(out, &size, sizeof(size));
+        std::memcpy(out + sizeof(size), payload.data(), payload.size());
+        slot.head.store(head + bytes, std::memory_order_release);
+
+        auto& header = map_.Header();
+        header.dataSeq.fetch_add(1, std::memory_order_relaxed);
+        // pairs with the fence in ShmConsumer::Wait()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header.consumerSleeping.load(std::memory_order_relaxed)) exceptions::futex::WakeOne(header.dataSeq);
+        return true;
+    }
+
+    // waits for ring space at most for timeout, returns false if there was none
+    bool Push(std::span<const std::uint8_t> payload, std::chrono::nanoseconds timeout) {
+        if (TryPush(payload)) return true;
+        auto& slot = map_.Slot(slot_);
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        bool pushed{false};
+        while (!pushed) {
+            const auto seq = slot.spaceSeq.load(std::memory_order_relaxed);
+            slot.producerWaiting.store(1, std::memory_order_relaxed);
+            // pairs with the fence in ShmConsumer::Consume()
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if ((pushed = TryPush(payload))) break;
+            const auto left = deadline - std::chrono::steady_clock::now();
+            if (left.count() <= 0) break;
+            exceptions::futex::Wait(slot.spaceSeq, seq, left);
+        }
+        slot.producerWaiting.store(0, std::memory_order_relaxed);
+        return pushed;
+    }
+
+    std::uint32_t Slot() const noexcept { return slot_; }
+
+private:
+    static detail::ShmMapping Open(const std::string& name) {
+        const auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Unable to open command segment " + name);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(detail::ShmHeader)) {
+            ::close(fd);
+            throw std::invalid_argument("Command segment is truncated: " + name);
+        }
+        return detail::ShmMapping{fd, static_cast<std::size_t>(st.st_size)};
+    }
+
+    void Claim() {
+        const auto pid = static_cast<std::int32_t>(::getpid());
+        const auto slots = map_.Header().slots;
+        for (std::uint32_t i = 0; i < slots; ++i) {
+            auto lock = detail::SlotLock(i, F_WRLCK);
+            if (::fcntl(map_.Fd(), F_OFD_SETLK, &lock) != 0) continue;
+            // the slot may still be marked by a crashed owner the consumer has not reaped yet
+            map_.Slot(i).owner.store(pid, std::memory_order_release);
+            slot_ = i;
+            return;
+        }
+        throw std::runtime_error("No free producer slot in the command segment");
+    }
+
+    detail::ShmMapping map_;
+    std::uint32_t slot_{0};
+    std::uint8_t* ring_{nullptr};
+    std::uint64_t ringBytes_{0};
+};
+
+// Consumer side IQueue for cmd_loop::run: decodes the records of the shared segment.
+// Commands pushed locally, e.g. by exception handlers, are executed first. Size() counts
+// the local commands only, the shared rings are not scanned for it.
+class ShmQueue : public exceptions::IQueue {
+public:
+    ShmQueue(ShmConsumer& consumer, const CommandRegistry& registry, CodecContext& ctx)
+    : consumer_{consumer}
+    , registry_{registry}
+    , ctx_{ctx} {}
+
+    void Push(exceptions::ICommandUPtr cmd) override { local_.push(std::move(cmd)); }
+
+    void Pop() override {
+        Stage();
+        current_.reset();
+    }
+
+    exceptions::ICommandUPtr Take() override {
+        Stage();
+        return std::move(current_);
+    }
+
+    const exceptions::ICommandUPtr& Front() const noexcept override {
+        Stage();
+        return current_;
+    }
+
+    bool IsEmpty() const noexcept override {
+        Stage();
+        return !current_;
+    }
+
+    std::size_t Size() const noexcept override { return local_.size() + (current_ ? 1 : 0); }
+
+    // records that could not be decoded and were dropped
+    std::uint64_t Malformed() const noexcept { return malformed_; }
+
+private:
+    void Stage() const noexcept {
+        if (current_) return;
+        if (!local_.empty()) {
+            current_ = std::move(local_.front());
+            local_.pop();
+            return;
+        }
+        std::span<const std::uint8_t> record;
+        while (!current_ && consumer_.Peek(record)) {
+            try {
+                BinaryReader in{record};
+                current_ = registry_.Decode(in, ctx_);
+            } catch (const std::exception&) {
+                ++malformed_;
+            }
+            consumer_.Consume();
+        }
+    }
+
+    ShmConsumer& consumer_;
+    const CommandRegistry& registry_;
+    CodecContext& ctx_;
+    // Front() and IsEmpty() are const for cmd_loop, decoding the next record is not
+    mutable std::queue<exceptions::ICommandUPtr> local_;
+    mutable exceptions::ICommandUPtr current_;
+    mutable std::uint64_t malformed_{0};
+};
+
+} // namespace command
@@ -1,10 +1,30 @@
 #include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 #include <numbers>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include <coalescing_queue.hpp>
+#include <command_codec.hpp>
+#include <caching_adapter.hpp>
 #include <command_impl.hpp>
+#include <fuel_tank.hpp>
 #include <game.hpp>
+#include <journal.hpp>
+#include <loop_command.hpp>
 #include <macro_impl.hpp>
 #include <primitives.hpp>
+#include <queue_impl.hpp>
+#include <tracer.hpp>
+#include <shm_transport.hpp>
 
 class SpaceShip : public game::IEntity {
 public:
@@ -67,6 +87,101 @@ TEST(CheckFuelCommandTest, Basics) {
     EXPECT_EQ(initialFuelAmount - 1, newFuelAmount.val);
 }
 
+TEST(FuelTankTest, TryBurnDoesNotOverspend) {
+    command::FuelTank tank{1'000};
+    std::vector<std::jthread> burners;
+    std::atomic<int> burnt{0};
+    for (int i = 0; i < 4; ++i) {
+        burners.emplace_back([&] {
+            command::TryBurnFuel burn{&tank, 3};
+            for (;;) {
+                try {
+                    burn.Execute();
+                } catch (const command::CommandException&) {
+                    return;
+                }
+                burnt += 3;
+            }
+        });
+    }
+    burners.clear();
+
+    EXPECT_EQ(999, burnt.load());
+    EXPECT_EQ(1, tank.Level());
+    EXPECT_FALSE(tank.TryBurn(2));
+    EXPECT_TRUE(tank.CheckFuel());
+}
+
+TEST(FuelTankTest, ReservationDoesNotThrowFromDestructor) {
+    command::FuelTank tank{5};
+    {
+        command::FuelReservation reservation{&tank};
+        EXPECT_TRUE(reservation.Reserve(3));
+        // the tank fills up meanwhile, the units do not fit back
+        tank.Refill(static_cast<int>(command::maxFuelUnits) - 2);
+        EXPECT_THROW(reservation.Release(), std::out_of_range);
+        EXPECT_EQ(3, reservation.Reserved());
+
+        EXPECT_THROW(reservation.Refund(command::maxFuelUnits), std::out_of_range);
+        EXPECT_EQ(3, reservation.Reserved());
+    }
+    EXPECT_EQ(static_cast<int>(command::maxFuelUnits), tank.Level());
+}
+
+TEST(FuelTankTest, MacroBurnsFromReservation) {
+    command::FuelTank tank{5};
+    command::FuelReservation reservation{&tank};
+
+    command::ReserveFuel reserveCmd{&reservation, 3};
+    command::CheckFuel checkFuelCmd{&reservation};
+    command::BurnFuel burnFuelCmd{&reservation};
+    command::MacroCommand macroCmd{command::MacroCommand::ICommandsArr{
+        &reserveCmd, &checkFuelCmd, &burnFuelCmd, &checkFuelCmd, &burnFuelCmd}};
+
+    macroCmd.Execute();
+    EXPECT_EQ(2, tank.Level());
+    EXPECT_EQ(1, reservation.Reserved());
+
+    // the unused unit goes back before the next reservation
+    command::ReserveFuel reserveTooMuch{&reservation, 4};
+    try {
+        reserveTooMuch.Execute();
+        ADD_FAILURE() << "reserving more than the tank holds must throw";
+    } catch (const command::CommandException& ex) {
+        EXPECT_EQ("Not enough fuel to reserve 4 units", ex.Describe());
+    }
+    EXPECT_EQ(3, tank.Level());
+    EXPECT_EQ(0, reservation.Reserved());
+    EXPECT_TRUE(reservation.Reserve(2));
+    reservation.Release();
+    EXPECT_EQ(3, tank.Level());
+
+    // the string adapter burns the same way, without the atomicity
+    SpaceShip ship;
+    ship.setProperty("fuel", game::IntegerProperty{.val = 2}.toString());
+    command::FuelConsumingObjectAdapter fcoa{&ship};
+    EXPECT_FALSE(fcoa.TryBurn(3));
+    EXPECT_TRUE(fcoa.TryBurn(2));
+    fcoa.Refund(1);
+    EXPECT_EQ(1, game::IntegerProperty::fromString(ship.getProperty("fuel")));
+}
+
+TEST(FuelTankTest, UnitsBeyondFuelLevelsAreRejected) {
+    constexpr auto huge = command::maxFuelUnits + 1;
+    command::FuelTank tank{5};
+    EXPECT_FALSE(tank.TryBurn(huge));
+    EXPECT_FALSE(tank.TryBurn(std::numeric_limits<std::uint32_t>::max()));
+    EXPECT_THROW(tank.Refund(command::maxFuelUnits), std::out_of_range);
+    EXPECT_EQ(5, tank.Level());
+
+    SpaceShip ship;
+    ship.setProperty("fuel", game::IntegerProperty{.val = 5}.toString());
+    command::FuelConsumingObjectAdapter fcoa{&ship};
+    EXPECT_FALSE(fcoa.TryBurn(huge));
+    EXPECT_THROW(fcoa.Refund(command::maxFuelUnits), std::out_of_range);
+    EXPECT_EQ(5, game::IntegerProperty::fromString(ship.getProperty("fuel")));
+}
+
 TEST(MacroCommandTest, Basics) {
     int counter{0};
 
@@ -88,6 +203,28 @@ TEST(MacroCommandTest, Basics) {
     EXPECT_EQ(3, counter);
 }
 
+TEST(MacroCommandTest, ChildrenAreTraced) {
+    SpaceShip ship;
+    game::MovingObjectAdapter moa{&ship};
+    game::RotatingObjectAdapter roa{&ship};
+    command::Move moveCmd{&moa};
+    command::Rotate rotateCmd{&roa};
+    command::MacroCommand macroCmd{command::MacroCommand::ICommandsArr{&moveCmd, &rotateCmd}};
+
+    exceptions::trace::Reset();
+    exceptions::trace::Start();
+    exceptions::QueueImpl q;
+    q.Push(std::make_unique<command::LoopCommand<command::MacroCommand>>(macroCmd));
+    exceptions::cmd_loop::run(q);
+    exceptions::trace::Stop();
+
+    const auto json = exceptions::trace::ToChromeJson();
+    exceptions::trace::Reset();
+    EXPECT_NE(std::string::npos, json.find(R"({"name":"command::BasicMove<int>","cat":"macro_child")"));
+    EXPECT_NE(std::string::npos, json.find(R"({"name":"command::Rotate","cat":"macro_child")"));
+    EXPECT_NE(std::string::npos, json.find(R"("cat":"command")"));
+}
+
 TEST(MacroCommandTest, BurnFuel) {
     int initialFuelAmount{10};
     SpaceShip ship;
@@ -173,4 +310,499 @@ TEST(MacroCommandTest, MoveRotateAndChangeVelocity){
     const auto newLocation = game::Vector::fromString(ship.getProperty("location"));
     EXPECT_EQ(newLocation.x, 0);
     EXPECT_EQ(newLocation.y, 1);
-}
\ No newline at end of file
+}
+
+TEST(MacroCommandTest, CachedMacroMatchesPlainAdapters) {
+    const auto run = [](SpaceShip& ship, game::IMovingObject& moving, game::IRotatingObject& rotating, command::ICommand* last) {
+        command::Move moveCmd{&moving};
+        command::ChangeVelocity changeVelocityCmd{&rotating, &moving};
+        command::Rotate rotateCmd{&rotating};
+        command::MacroCommand::ICommandsArr cmds{&moveCmd, &changeVelocityCmd, &rotateCmd, &moveCmd};
+        if (last) cmds.push_back(last);
+        command::MacroCommand{std::move(cmds)}.Execute();
+        return ship.getProperty("location") + ";" + ship.getProperty("angle");
+    };
+    const auto prepare = [](SpaceShip& ship) {
+        ship.setProperty("velocity", game::Vector{3, 1}.toString());
+        ship.setProperty("angle", game::Angle{.rad = 0.5}.toString());
+        ship.setProperty("angular_velocity", game::Angle{.rad = 0.25}.toString());
+    };
+
+    SpaceShip plain;
+    prepare(plain);
+    game::MovingObjectAdapter moa{&plain};
+    game::RotatingObjectAdapter roa{&plain};
+
+    SpaceShip cached;
+    prepare(cached);
+    game::CachingAdapter cache{&cached};
+    command::FlushCache flushCmd{&cache};
+
+    EXPECT_EQ(run(plain, moa, roa, nullptr), run(cached, cache, cache, &flushCmd));
+}
+
+TEST(ChangeVelocityCommandTest, DoubleCoordinatesDoNotRound) {
+    SpaceShip ship;
+    ship.setProperty("velocity", game::BasicVector<double>{.x = 1., .y = 0.}.toString());
+    ship.setProperty("angle", game::Angle{.rad = 0.3}.toString());
+
+    game::BasicMovingObjectAdapter<double> moa{&ship};
+    game::RotatingObjectAdapter roa{&ship};
+
+    command::BasicChangeVelocity<double> cmd{&roa, &moa};
+    for (int i = 0; i < 10; ++i) {
+        cmd.Execute();
+    }
+
+    // int coordinates would round every step to {1, 0}
+    const auto newLocation = moa.getLocation();
+    EXPECT_NEAR(newLocation.x(), 10. * std::cos(0.3), 1e-5);
+    EXPECT_NEAR(newLocation.y(), 10. * std::sin(0.3), 1e-5);
+}
+
+
+TEST(LoopCommandTest, GameCommandsRunInCmdLoop) {
+    SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{2, 1}.toString());
+    ship.setProperty("fuel", game::IntegerProperty{.val = 0}.toString());
+
+    game::MovingObjectAdapter moa{&ship};
+    command::FuelConsumingObjectAdapter fcoa{&ship};
+
+    exceptions::QueueImpl q;
+    q.Push(command::MakeLoopCommand<command::CheckFuel>(&fcoa)); // throws CommandException
+    q.Push(command::MakeLoopCommand<command::Move>(&moa));
+
+    EXPECT_NO_THROW(exceptions::cmd_loop::run(q));
+    EXPECT_TRUE(q.IsEmpty());
+    EXPECT_EQ("2,1", ship.getProperty("location"));
+}
+
+TEST(CommandCodecTest, BuiltinCommandsRoundTrip) {
+    SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, 2}.toString());
+    ship.setProperty("angular_velocity", game::Angle{.rad = 0.5}.toString());
+    ship.setProperty("fuel", game::IntegerProperty{.val = 5}.toString());
+
+    command::CodecContext ctx;
+    const auto id = ctx.AddEntity(&ship);
+
+    command::Move moveCmd{&ctx.Moving(id)};
+    command::Rotate rotateCmd{&ctx.Rotating(id)};
+    command::BurnFuel burnFuelCmd{&ctx.Fuel(id)};
+    command::TryBurnFuel tryBurnFuelCmd{&ctx.Fuel(id), 2};
+    command::MacroCommand macroCmd{command::MacroCommand::ICommandsArr{&moveCmd, &rotateCmd, &burnFuelCmd, &tryBurnFuelCmd}};
+
+    command::CommandRegistry registry;
+    command::BinaryWriter out;
+    registry.Encode(command::LoopCommand<command::MacroCommand>{macroCmd}, out, ctx);
+    registry.Encode(exceptions::LogErrorCommand{"boom", "/tmp/log"}, out, ctx);
+
+    // macro: tag, child count, 3 x (tag, entity id), tag, entity id, units
+    // log: tag, 2 x (size, chars)
+    EXPECT_EQ(11 + 15, out.Data().size());
+
+    command::BinaryReader in{out.Data()};
+    const auto decodedMacro = registry.Decode(in, ctx);
+    const auto decodedLog = registry.Decode(in, ctx);
+    EXPECT_TRUE(in.AtEnd());
+
+    decodedMacro->Execute();
+    EXPECT_EQ("1,2", ship.getProperty("location"));
+    EXPECT_NEAR(0.5, game::Angle::fromString(ship.getProperty("angle")).rad, 1e-6);
+    EXPECT_EQ(2, game::IntegerProperty::fromString(ship.getProperty("fuel")));
+
+    const auto* log = dynamic_cast<const exceptions::LogErrorCommand*>(decodedLog.get());
+    ASSERT_NE(nullptr, log);
+    EXPECT_EQ("boom", log->Error());
+    EXPECT_EQ("/tmp/log", log->LogPath());
+}
+
+TEST(CommandCodecTest, UnknownCommandsAreRejected) {
+    class Unregistered : public command::ICommand {
+        public:
+            void Execute() override {}
+    };
+
+    command::CodecContext ctx;
+    command::CommandRegistry registry;
+    command::BinaryWriter out;
+    EXPECT_THROW(registry.Encode(command::LoopCommand<Unregistered>{{}}, out, ctx), std::logic_error);
+
+    const std::uint8_t badTag[] = {0xff};
+    command::BinaryReader in{badTag};
+    EXPECT_THROW(registry.Decode(in, ctx), std::invalid_argument);
+
+    // a corrupt child count is not allocated
+    out.WriteByte(command::CommandRegistry::MacroCommandTag);
+    out.WriteVarint(std::numeric_limits<std::uint64_t>::max());
+    command::BinaryReader hugeMacro{out.Data()};
+    EXPECT_THROW(registry.Decode(hugeMacro, ctx), std::invalid_argument);
+
+    // so are fuel units beyond any fuel level
+    SpaceShip ship;
+    command::BinaryWriter burn;
+    burn.WriteByte(command::CommandRegistry::TryBurnFuelTag);
+    burn.WriteVarint(ctx.AddEntity(&ship));
+    burn.WriteVarint(std::uint64_t{command::maxFuelUnits} + 1);
+    command::BinaryReader hugeBurn{burn.Data()};
+    EXPECT_THROW(registry.Decode(hugeBurn, ctx), std::invalid_argument);
+
+    // and ids past EntityId, which would wrap onto a registered entity
+    command::BinaryWriter move;
+    move.WriteByte(command::CommandRegistry::MoveTag);
+    move.WriteVarint(std::uint64_t{std::numeric_limits<command::EntityId>::max()} + 1);
+    command::BinaryReader hugeId{move.Data()};
+    EXPECT_THROW(registry.Decode(hugeId, ctx), std::invalid_argument);
+    EXPECT_THROW(command::ToEntityId(std::uint64_t{1} << 32), std::out_of_range);
+}
+
+TEST(JournalTest, RecordAndReplay) {
+    namespace fs = std::filesystem;
+    const fs::path journalPath = fs::temp_directory_path() / "command_journal_test.bin";
+
+    auto makeShip = [](SpaceShip& ship) {
+        ship.setProperty("velocity", game::Vector{1, -1}.toString());
+        ship.setProperty("fuel", game::IntegerProperty{.val = 3}.toString());
+    };
+
+    SpaceShip recorded;
+    makeShip(recorded);
+    {
+        command::CodecContext ctx;
+        const auto id = ctx.AddEntity(&recorded);
+        command::CommandRegistry registry;
+        command::JournalWriter journal{journalPath, 64}; // forces the file to grow
+
+        exceptions::QueueImpl q;
+        command::RecordingQueue recordingQueue{q, journal, registry, ctx};
+        for (int i = 0; i < 5; ++i) {
+            recordingQueue.Push(command::MakeLoopCommand<command::CheckFuel>(&ctx.Fuel(id)));
+            recordingQueue.Push(command::MakeLoopCommand<command::BurnFuel>(&ctx.Fuel(id)));
+            recordingQueue.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(id)));
+        }
+        exceptions::cmd_loop::run(recordingQueue);
+        EXPECT_EQ(15, journal.Records());
+        EXPECT_EQ(0, recordingQueue.Skipped());
+    }
+
+    SpaceShip replayed;
+    makeShip(replayed);
+    {
+        command::CodecContext ctx;
+        ctx.AddEntity(&replayed);
+        command::CommandRegistry registry;
+        command::JournalReader journal{journalPath};
+        EXPECT_EQ(15, journal.Records());
+
+        exceptions::QueueImpl q;
+        command::Replayer replayer{journal, registry, ctx};
+        EXPECT_EQ(15, replayer.Run(q, command::ReplaySpeed::Maximum, 4));
+    }
+
+    EXPECT_EQ(recorded.getProperty("location"), replayed.getProperty("location"));
+    EXPECT_EQ(recorded.getProperty("fuel"), replayed.getProperty("fuel"));
+    fs::remove(journalPath);
+}
+
+TEST(JournalTest, FailedCreateLeavesNoFile) {
+    namespace fs = std::filesystem;
+    const fs::path journalPath = fs::temp_directory_path() / "command_journal_failed_test.bin";
+    // no file system takes a file of this size
+    EXPECT_THROW(command::JournalWriter(journalPath, std::numeric_limits<off_t>::max()), std::system_error);
+    EXPECT_FALSE(fs::exists(journalPath));
+}
+
+TEST(JournalTest, FailedGrowKeepsJournalUsable) {
+    namespace fs = std::filesystem;
+    const fs::path journalPath = fs::temp_directory_path() / "command_journal_grow_test.bin";
+    const std::uint8_t payload[] = {1, 2, 3};
+
+    const auto pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (0 == pid) {
+        // the address space only has room for small mappings now
+        long pages{0};
+        std::ifstream{"/proc/self/statm"} >> pages;
+        const auto used = static_cast<rlim_t>(pages) * static_cast<rlim_t>(::sysconf(_SC_PAGESIZE));
+        const rlimit limit{used + (rlim_t{64} << 20), used + (rlim_t{64} << 20)};
+        int failures{0};
+        {
+            command::JournalWriter journal{journalPath, 4096};
+            journal.Append(std::chrono::nanoseconds{1}, payload);
+            if (0 != ::setrlimit(RLIMIT_AS, &limit)) ::_exit(2);
+            const std::vector<std::uint8_t> big(std::size_t{1} << 20);
+            try {
+                // doubling from 1 GiB does not fit
+                for (int i = 0; i < 2048; ++i) journal.Append(std::chrono::nanoseconds{2}, big);
+            } catch (const std::system_error&) {
+                ++failures;
+            }
+            journal.Append(std::chrono::nanoseconds{3}, payload);
+        }
+        ::_exit(1 == failures ? 0 : 1);
+    }
+    int status{0};
+    ASSERT_EQ(pid, ::waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    command::JournalReader journal{journalPath};
+    command::JournalReader::Record rec;
+    std::uint64_t records{0};
+    while (journal.Next(rec)) ++records;
+    EXPECT_EQ(journal.Records(), records);
+    EXPECT_EQ(std::chrono::nanoseconds{3}, rec.timestamp);
+    fs::remove(journalPath);
+}
+
+namespace {
+
+std::string ShmName(std::string_view test) {
+    return std::format("/command_test_{}_{}", test, ::getpid());
+}
+
+} // namespace
+
+TEST(ShmTransportTest, CommandsReachConsumerLoop) {
+    SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, 2}.toString());
+    command::CommandRegistry registry;
+    command::CodecContext consumerCtx;
+    consumerCtx.AddEntity(&ship);
+
+    command::ShmConsumer consumer{ShmName("loop"), command::ShmConfig{.slots = 2, .ringBytes = 4096}};
+    command::ShmQueue queue{consumer, registry, consumerCtx};
+    {
+        // the producers address the same entity by id through their own context
+        SpaceShip mirror;
+        command::CodecContext producerCtx;
+        const auto id = producerCtx.AddEntity(&mirror);
+        command::ShmProducer first{consumer.Name()};
+        command::ShmProducer second{consumer.Name()};
+        EXPECT_NE(first.Slot(), second.Slot());
+        EXPECT_EQ(2, consumer.Producers());
+        EXPECT_THROW(command::ShmProducer{consumer.Name()}, std::runtime_error);
+
+        command::BinaryWriter out;
+        registry.Encode(command::LoopCommand<command::Move>{command::Move{&producerCtx.Moving(id)}}, out, producerCtx);
+        for (int i = 0; i < 3; ++i) {
+            EXPECT_TRUE(first.TryPush(out.Data()));
+            EXPECT_TRUE(second.TryPush(out.Data()));
+        }
+        const std::uint8_t badTag[] = {0xff};
+        EXPECT_TRUE(first.TryPush(badTag));
+    }
+    EXPECT_EQ(0, consumer.Producers());
+
+    EXPECT_TRUE(consumer.Wait(std::chrono::milliseconds{0}));
+    EXPECT_EQ(6, exceptions::cmd_loop::run(queue, 100));
+    EXPECT_EQ("6,12", ship.getProperty("location"));
+    EXPECT_EQ(1, queue.Malformed());
+    EXPECT_FALSE(consumer.HasRecords());
+}
+
+TEST(ShmTransportTest, RingWrapsAndFills) {
+    command::ShmConsumer consumer{ShmName("wrap"), command::ShmConfig{.slots = 1, .ringBytes = 64}};
+    command::ShmProducer producer{consumer.Name()};
+
+    std::uint8_t payload[20];
+    std::uint8_t next{0};
+    std::uint8_t expected{0};
+    std::span<const std::uint8_t> record;
+    for (int round = 0; round < 50; ++round) {
+        // 24 bytes per record, only two fit a 64 byte ring when it wraps
+        int pushed{0};
+        while (true) {
+            std::fill(std::begin(payload), std::end(payload), next);
+            if (!producer.TryPush(std::span{payload, 1 + next % sizeof(payload)})) break;
+            ++next;
+            ++pushed;
+        }
+        EXPECT_GE(pushed, round > 0 ? 1 : 2);
+        while (consumer.Peek(record)) {
+            ASSERT_EQ(1 + expected % sizeof(payload), record.size());
+            EXPECT_EQ(expected, record.front());
+            EXPECT_EQ(expected, record.back());
+            consumer.Consume();
+            ++expected;
+        }
+    }
+    EXPECT_EQ(next, expected);
+
+    const std::vector<std::uint8_t> tooLarge(64);
+    EXPECT_THROW(producer.TryPush(tooLarge), std::invalid_argument);
+}
+
+TEST(ShmTransportTest, CrashedProducerIsDetected) {
+    command::ShmConsumer consumer{ShmName("crash"), command::ShmConfig{.slots = 1, .ringBytes = 4096}};
+
+    const auto pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (0 == pid) {
+        // dies holding the slot, without detaching
+        command::ShmProducer producer{consumer.Name()};
+        const std::uint8_t payload[] = {1, 2, 3};
+        for (int i = 0; i < 3; ++i) producer.TryPush(payload);
+        ::_exit(0);
+    }
+    int status{0};
+    ASSERT_EQ(pid, ::waitpid(pid, &status, 0));
+
+    EXPECT_EQ(1, consumer.Producers());
+    // the records published before the crash are delivered
+    int records{0};
+    std::span<const std::uint8_t> record;
+    while (consumer.Peek(record)) {
+        EXPECT_EQ(3, record.size());
+        consumer.Consume();
+        ++records;
+    }
+    EXPECT_EQ(3, records);
+
+    EXPECT_FALSE(consumer.Wait(std::chrono::milliseconds{1}));
+    EXPECT_EQ(1, consumer.CrashedProducers());
+    EXPECT_EQ(0, consumer.Producers());
+    command::ShmProducer replacement{consumer.Name()};
+    EXPECT_EQ(0, consumer.ReapCrashedProducers());
+}
+
+TEST(ShmTransportTest, LiveConsumerKeepsItsSegment) {
+    const auto name = ShmName("owner");
+    {
+        command::ShmConsumer consumer{name, command::ShmConfig{.slots = 1, .ringBytes = 4096}};
+        EXPECT_THROW((command::ShmConsumer{name, command::ShmConfig{.slots = 1, .ringBytes = 4096}}), std::runtime_error);
+
+        // producers still reach the first consumer
+        command::ShmProducer producer{name};
+        const std::uint8_t payload[] = {1, 2, 3};
+        EXPECT_TRUE(producer.TryPush(payload));
+        EXPECT_TRUE(consumer.HasRecords());
+    }
+
+    // a consumer that died without unlinking leaves a segment that is replaced
+    const auto pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (0 == pid) {
+        command::ShmConsumer crashed{name, command::ShmConfig{.slots = 1, .ringBytes = 4096}};
+        ::_exit(0);
+    }
+    int status{0};
+    ASSERT_EQ(pid, ::waitpid(pid, &status, 0));
+    ASSERT_EQ(0, status);
+    command::ShmConsumer replacement{name, command::ShmConfig{.slots = 2, .ringBytes = 4096}};
+    command::ShmProducer first{name};
+    command::ShmProducer second{name};
+    EXPECT_EQ(2, replacement.Producers());
+}
+
+TEST(ShmTransportTest, MalformedRingIsDropped) {
+    command::ShmConsumer consumer{ShmName("corrupt"), command::ShmConfig{.slots = 1, .ringBytes = 4096}};
+    command::ShmProducer producer{consumer.Name()};
+    const std::uint8_t payload[] = {1, 2, 3};
+    ASSERT_TRUE(producer.TryPush(payload));
+
+    // a second view of the segment plays the misbehaving producer
+    const auto fd = ::shm_open(consumer.Name().c_str(), O_RDWR, 0);
+    ASSERT_GE(fd, 0);
+    command::detail::ShmMapping raw{fd, command::detail::SegmentBytes(1, 4096)};
+    auto& slot = raw.Slot(0);
+    auto* ring = raw.Ring(0);
+
+    // a record larger than what was published
+    const std::uint32_t hugeSize{1000};
+    std::memcpy(ring, &hugeSize, sizeof(hugeSize));
+    std::span<const std::uint8_t> record;
+    EXPECT_FALSE(consumer.Peek(record));
+    EXPECT_EQ(1, consumer.CorruptProducers());
+    EXPECT_EQ(0, consumer.Producers());
+
+    // a head further ahead than the ring holds
+    slot.head.store(slot.tail.load() + 8192);
+    EXPECT_FALSE(consumer.Peek(record));
+    EXPECT_EQ(2, consumer.CorruptProducers());
+    EXPECT_FALSE(consumer.HasRecords());
+}
+
+TEST(ShmTransportTest, WaitWakesOnPush) {
+    using namespace std::chrono_literals;
+    command::ShmConsumer consumer{ShmName("wake"), command::ShmConfig{.slots = 1, .ringBytes = 4096}};
+    command::ShmProducer producer{consumer.Name()};
+
+    const auto start = std::chrono::steady_clock::now();
+    std::thread pusher{[&producer] {
+        std::this_thread::sleep_for(20ms);
+        const std::uint8_t payload[] = {42};
+        producer.Push(payload, 1s);
+    }};
+    EXPECT_TRUE(consumer.Wait(10s));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+    pusher.join();
+}
+
+TEST(CoalescingQueueTest, MergesMovesAndRotatesPerTarget) {
+    SpaceShip first;
+    SpaceShip second;
+    first.setProperty("velocity", game::Vector{2, 1}.toString());
+    first.setProperty("angular_velocity", game::Angle{.rad = 0.25}.toString());
+    second.setProperty("velocity", game::Vector{-1, 3}.toString());
+
+    command::CodecContext ctx;
+    const auto a = ctx.AddEntity(&first);
+    const auto b = ctx.AddEntity(&second);
+
+    command::CoalescingQueue q;
+    for (int i = 0; i < 3; ++i) {
+        q.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(a)));
+        q.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(b)));
+    }
+    q.Push(command::MakeLoopCommand<command::Rotate>(&ctx.Rotating(a)));
+    q.Push(command::MakeLoopCommand<command::Rotate>(&ctx.Rotating(a)));
+    EXPECT_EQ(3, q.Size());
+    EXPECT_EQ(5, q.Merged());
+
+    EXPECT_EQ(3, exceptions::cmd_loop::run(q, 10));
+    EXPECT_TRUE(q.IsEmpty());
+    EXPECT_EQ("6,3", first.getProperty("location"));
+    EXPECT_EQ("-3,9", second.getProperty("location"));
+    EXPECT_NEAR(0.5, game::Angle::fromString(first.getProperty("angle")).rad, 1e-6);
+}
+
+TEST(CoalescingQueueTest, MergeWindowCloses) {
+    SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, 0}.toString());
+    command::CodecContext ctx;
+    const auto id = ctx.AddEntity(&ship);
+
+    // another command may read or change the location, the moves around it stay apart
+    command::CoalescingQueue q;
+    q.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(id)));
+    q.Push(command::MakeLoopCommand<command::CheckFuel>(&ctx.Fuel(id)));
+    q.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(id)));
+    q.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(id)));
+    EXPECT_EQ(3, q.Size());
+    EXPECT_EQ(1, q.Merged());
+
+    // the window moves to the queue with the first Front(), later pushes open the next one
+    q.Front();
+    q.Push(command::MakeLoopCommand<command::Move>(&ctx.Moving(id)));
+    EXPECT_EQ(4, q.Size());
+    EXPECT_EQ(1, q.Merged());
+
+    exceptions::cmd_loop::run(q);
+    EXPECT_EQ("4,0", ship.getProperty("location"));
+}
+
+TEST(CoalescingQueueTest, MergedCommandsAreNotEncoded) {
+    SpaceShip ship;
+    command::CodecContext ctx;
+    const auto id = ctx.AddEntity(&ship);
+
+    command::Move move{&ctx.Moving(id)};
+    EXPECT_TRUE(move.Merge(command::Move{&ctx.Moving(id)}));
+    EXPECT_EQ(2, move.Steps());
+
+    command::CommandRegistry registry;
+    command::BinaryWriter out;
+    EXPECT_THROW(registry.Encode(command::LoopCommand<command::Move>{move}, out, ctx), std::invalid_argument);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <command_codec.hpp>
+#include <game.hpp>
+
+#include "scheduler.hpp"
+
+namespace simulation {
+
+// Ship state as replicated to clients. Angles are quantized to 2pi / 65536 steps.
+struct ReplicatedShip {
+    game::Point location{0, 0};
+    game::Vector velocity{0, 0};
+    std::uint16_t angle{0};
+    std::int32_t angularVelocity{0};
+};
+
+std::uint16_t QuantizeAngle(game::Angle angle) noexcept;
+std::int32_t QuantizeAngularVelocity(game::Angle velocity) noexcept;
+game::Angle DequantizeAngle(std::int64_t steps) noexcept;
+
+// Encodes the ships whose dirty mask is set, and only their changed properties, as deltas
+// against what the previous calls sent. Per ship: varint id gap, the mask byte, then per
+// property zigzag varint deltas of x and y, or of the quantized angle. A zero ends the stream.
+// Ships that were never changed keep the defaults of ReplicatedShip on the client.
+class DeltaEncoder {
+public:
+    // clears the dirty masks, the data stays valid until the next call
+    std::span<const std::uint8_t> Encode(EntityStore& store);
+
+private:
+    std::vector<ReplicatedShip> sent_;
+    command::BinaryWriter out_;
+};
+
+// Client side of DeltaEncoder. Ship ids are bounded by maxShips, a stream naming a larger
+// id is rejected before anything is allocated for it.
+class DeltaDecoder {
+public:
+    explicit DeltaDecoder(std::size_t maxShips = std::size_t{1} << 20)
+    : maxShips_{maxShips} {}
+
+    void Apply(std::span<const std::uint8_t> delta);
+
+    // ships not mentioned so far have the default state
+    ReplicatedShip Get(EntityId id) const { return id < ships_.size() ? ships_[id] : ReplicatedShip{}; }
+
+private:
+    std::size_t maxShips_;
+    std::vector<ReplicatedShip> ships_;
+};
+
+} // namespace simulation
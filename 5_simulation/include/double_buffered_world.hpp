@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <primitives.hpp>
+
+#include "entity_schema.hpp"
+#include "thread_pool.hpp"
+
+namespace simulation {
+
+// Entity state kept twice: reads see the state as of the last Swap(), writes go to the
+// next state, so entities can be updated from any number of threads without locks as
+// long as no two threads write the same property. A write is not visible before the
+// next Swap(), not even to the entity that made it.
+// Swap() exchanges the buffers and then brings the new back buffer up to date by
+// copying the pages written since the previous swap, untouched pages are not copied.
+class DoubleBufferedWorld {
+public:
+    static constexpr std::size_t pageEntities{256};
+
+    explicit DoubleBufferedWorld(EntitySchema schema = ShipSchema());
+
+    DoubleBufferedWorld(const DoubleBufferedWorld&) = delete;
+    DoubleBufferedWorld& operator=(const DoubleBufferedWorld&) = delete;
+
+    // not to be called while entities are being updated
+    EntityId Add();
+
+    // the handle stays valid for the lifetime of the world, adapters can wrap it
+    game::IEntity& Get(EntityId id) { return views_.at(id); }
+    const game::IEntity& Get(EntityId id) const { return views_.at(id); }
+
+    std::size_t Size() const noexcept { return views_.size(); }
+
+    // publishes the writes made since the previous swap, the pool copies the dirty pages
+    void Swap(ThreadPool& pool);
+
+    // pages copied by the last Swap()
+    std::size_t CopiedPages() const noexcept { return copiedPages_; }
+
+private:
+    class View : public game::IEntity {
+    public:
+        View(DoubleBufferedWorld& world, EntityId id)
+        : world_{world}
+        , id_{id} {}
+
+        std::string getProperty(std::string_view key) const override;
+        void setProperty(std::string_view key, std::string_view val) override;
+
+    private:
+        DoubleBufferedWorld& world_;
+        EntityId id_;
+    };
+
+    std::size_t Slot(EntityId id, std::string_view key, const char* action) const;
+
+    EntitySchema schema_;
+    std::array<std::vector<std::string>, 2> buffers_;
+    std::size_t front_{0};
+    std::deque<View> views_;
+    // one flag per page of the back buffer, relaxed since Swap() runs after a pool join
+    std::deque<std::atomic<bool>> dirty_;
+    std::vector<std::size_t> dirtyPages_;
+    std::size_t copiedPages_{0};
+};
+
+} // namespace simulation
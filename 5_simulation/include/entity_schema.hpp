@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <primitives.hpp>
+
+namespace simulation {
+
+// an index into a store, the command codec's ids are 32 bits: convert with command::ToEntityId
+using EntityId = std::size_t;
+
+// property names and initial values of the entities of a store, the names must outlive the store
+using EntitySchema = std::vector<std::pair<std::string_view, std::string>>;
+
+// the properties of game::SpaceShip
+inline EntitySchema ShipSchema() {
+    return {
+         {"location", game::Point{0, 0}.toString()}
+        ,{"velocity", game::Vector{0, 0}.toString()}
+        ,{"angle", game::Angle{.rad = 0.}.toString()}
+        ,{"angular_velocity", game::Angle{.rad = 0.}.toString()}
+    };
+}
+
+inline constexpr std::size_t noProperty = static_cast<std::size_t>(-1);
+
+// a handful of properties, a scan beats hashing
+inline std::size_t PropertyIndex(const EntitySchema& schema, std::string_view key) noexcept {
+    for (std::size_t prop = 0; prop < schema.size(); ++prop) {
+        if (schema[prop].first == key) return prop;
+    }
+    return noProperty;
+}
+
+} // namespace simulation
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <access_set.hpp>
+#include <loop_command.hpp>
+#include <queue_interface.hpp>
+
+#include "thread_pool.hpp"
+
+namespace simulation {
+
+// Runs the commands of a queue on a thread pool with the same outcome as cmd_loop::run.
+// The queued commands are taken as one window and every command gets a level one above
+// the last earlier command it conflicts with, judged by the read/write sets declared
+// through command::GameLoopCommand. Commands on one level do not conflict with each other
+// and conflicts across levels follow queue order, so running the levels one after another,
+// each in parallel, ends in the state a serial run would. Commands with an unknown set run alone.
+// Exception handlers of a level run after it on the calling thread, in queue order, not
+// right after the failing command as in cmd_loop::run: the outcome matches a serial run only
+// while the commands returned by handlers touch nothing the rest of the level accesses.
+// Handlers that change game state need the serial loop (SchedulerConfig::parallelCommands off).
+// An exception other than IException ends Run after the handlers of its level; the commands of
+// the window that did not run, the failing one included, go back to the front of the queue.
+class ParallelExecutor {
+public:
+    // smallest level worth handing to the pool
+    explicit ParallelExecutor(ThreadPool& pool, std::size_t minParallelLevel = 64)
+    : pool_{pool}
+    , minParallelLevel_{minParallelLevel} {}
+
+    // Executes at most maxCommands commands, the rest stays in the queue.
+    // Returns the number of executed commands.
+    std::size_t Run(exceptions::IQueue& queue, std::size_t maxCommands);
+
+    std::uint64_t Commands() const noexcept { return commands_; }
+    std::uint64_t Levels() const noexcept { return levels_; }
+
+private:
+    struct Key {
+        const void* target;
+        std::string_view property;
+
+        bool operator==(const Key&) const noexcept = default;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept {
+            return std::hash<const void*>{}(key.target) ^ (std::hash<std::string_view>{}(key.property) << 1);
+        }
+    };
+
+    // first level a later reader or writer of the property may take
+    struct Frontier {
+        std::size_t afterWrite{0};
+        std::size_t afterRead{0};
+    };
+
+    std::size_t Plan();
+    void ExecuteLevel(std::size_t begin, std::size_t end);
+    void Requeue(exceptions::IQueue& queue);
+
+    ThreadPool& pool_;
+    std::size_t minParallelLevel_;
+
+    std::vector<exceptions::ICommandUPtr> window_;
+    std::vector<std::size_t> level_;
+    // window indices grouped by level, queue order inside a level
+    std::vector<std::size_t> order_;
+    std::vector<std::size_t> levelStart_;
+    std::vector<std::exception_ptr> failures_;
+    // one byte per command, each written by the thread that runs it
+    std::vector<char> ran_;
+    command::AccessSet access_;
+    std::vector<Frontier*> touched_;
+    std::unordered_map<Key, Frontier, KeyHash> frontiers_;
+    command::CastCache<command::GameLoopCommand> asGame_;
+
+    std::uint64_t commands_{0};
+    std::uint64_t levels_{0};
+};
+
+} // namespace simulation
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <command_interface.hpp>
+#include <primitives.hpp>
+#include <queue_impl.hpp>
+
+#include "entity_schema.hpp"
+
+namespace simulation {
+
+// Entity storage that can go back a number of ticks, e.g. to apply an input that arrived
+// late and simulate the ticks since once more. A tick runs its input commands through
+// cmd_loop and then the tick hooks. The first write of a property in a tick moves the
+// old value into the tick's undo records, so a tick costs as much as it changes and
+// nothing for untouched entities. The records of the last historyTicks ticks are kept
+// in a ring. Writes outside Step() are not recorded and survive a rewind, and so do
+// entities added after the tick rewound to. Single-threaded.
+class RollbackWorld {
+public:
+    using TickHook = std::function<void(RollbackWorld&)>;
+
+    // with zero ticks of history nothing is recorded and nothing can be rewound
+    explicit RollbackWorld(std::size_t historyTicks, EntitySchema schema = ShipSchema());
+
+    RollbackWorld(const RollbackWorld&) = delete;
+    RollbackWorld& operator=(const RollbackWorld&) = delete;
+
+    EntityId Add();
+
+    // the handle stays valid for the lifetime of the world, adapters can wrap it
+    game::IEntity& Get(EntityId id) { return views_.at(id); }
+    const game::IEntity& Get(EntityId id) const { return views_.at(id); }
+
+    std::size_t Size() const noexcept { return views_.size(); }
+
+    // runs after the commands of every tick, e.g. physics
+    void OnTick(TickHook hook) { hooks_.push_back(std::move(hook)); }
+
+    // the command runs in the given tick, a past one only after Resimulate()
+    void Input(std::uint64_t tick, exceptions::ICommandUPtr cmd);
+
+    // runs the current tick, which ends even if a command or hook throws
+    void Step();
+    // restores the state as of the start of the tick, the inputs of the following ticks are kept
+    void RewindTo(std::uint64_t tick);
+    // rewinds to the tick and steps up to the current one again
+    void Resimulate(std::uint64_t fromTick);
+
+    std::uint64_t CurrentTick() const noexcept { return tick_; }
+    // the oldest tick RewindTo() can go back to
+    std::uint64_t OldestTick() const noexcept { return tick_ > frames_.size() ? tick_ - frames_.size() : 0; }
+    // property values recorded by the last Step()
+    std::size_t LastRecorded() const noexcept { return lastRecorded_; }
+
+private:
+    class View : public game::IEntity {
+    public:
+        View(RollbackWorld& world, EntityId id)
+        : world_{world}
+        , id_{id} {}
+
+        std::string getProperty(std::string_view key) const override;
+        void setProperty(std::string_view key, std::string_view val) override;
+
+    private:
+        RollbackWorld& world_;
+        EntityId id_;
+    };
+
+    struct Undo {
+        std::size_t slot;
+        std::string old;
+    };
+
+    struct Frame {
+        std::uint64_t tick;
+        std::vector<Undo> undo;
+    };
+
+    std::size_t Slot(EntityId id, std::string_view key, const char* action) const;
+    void Write(std::size_t slot, std::string_view val);
+    void FinishTick() noexcept;
+
+    EntitySchema schema_;
+    std::vector<std::string> values_;
+    // tick + 1 of the last undo record of every slot
+    std::vector<std::uint64_t> recordedIn_;
+    std::deque<View> views_;
+
+    std::vector<Frame> frames_;
+    Frame* recording_{nullptr};
+    std::size_t lastRecorded_{0};
+
+    std::map<std::uint64_t, std::vector<exceptions::ICommandUPtr>> inputs_;
+    std::vector<TickHook> hooks_;
+    exceptions::QueueImpl queue_;
+    std::uint64_t tick_{0};
+};
+
+} // namespace simulation
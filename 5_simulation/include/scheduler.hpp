@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <game.hpp>
+#include <latency_histogram.hpp>
+#include <queue_impl.hpp>
+
+#include "double_buffered_world.hpp"
+#include "parallel_executor.hpp"
+#include "thread_pool.hpp"
+
+namespace simulation {
+
+enum class Phase : std::size_t {
+    Input,     // hooks enqueue this tick's commands
+    Commands,  // cmd_loop drains the command queue
+    Physics,   // Move + Rotate for every entity, in parallel
+    Post,      // hooks observe the new state
+};
+
+inline constexpr std::size_t phaseCount = 4;
+
+class EntityStore {
+public:
+    EntityId Add();
+
+    game::SpaceShip& Get(EntityId id) { return *entities_.at(id); }
+    const game::SpaceShip& Get(EntityId id) const { return *entities_.at(id); }
+
+    std::size_t Size() const noexcept { return entities_.size(); }
+
+private:
+    // ships are heap allocated so adapters keep valid pointers when the store grows
+    std::vector<std::unique_ptr<game::SpaceShip>> entities_;
+};
+
+struct SchedulerConfig {
+    std::chrono::nanoseconds timestep{std::chrono::milliseconds{16}};
+    std::size_t threads{1};
+    // commands left over are executed on the next tick
+    std::size_t maxCommandsPerTick{std::numeric_limits<std::size_t>::max()};
+    // zero means no budget for the phase
+    std::array<std::chrono::nanoseconds, phaseCount> phaseBudgets{};
+    // sleep between ticks to keep the wall clock in step with the simulation
+    bool realtime{true};
+    // run the commands phase in conflict-free parallel levels, see ParallelExecutor
+    bool parallelCommands{false};
+    // entities live in World() instead of Entities(), see DoubleBufferedWorld;
+    // the commands and physics phases each end with a swap
+    bool doubleBuffered{false};
+};
+
+// Fixed-timestep tick driver. Every tick runs Input -> Commands -> Physics -> Post.
+// The physics phase runs in parallel, and every entity is updated independently
+// of the others there, so the resulting state does not depend on the thread count.
+// With parallelCommands the commands phase does too, with the outcome of serial order.
+// With doubleBuffered a command reads the state as of the start of the commands phase.
+// The commands and physics phases end with a game::ChangeBus dispatch.
+class Scheduler {
+public:
+    using PhaseHook = std::function<void(Scheduler&)>;
+
+    explicit Scheduler(SchedulerConfig config = {});
+
+    EntityStore& Entities() noexcept { return entities_; }
+    const EntityStore& Entities() const noexcept { return entities_; }
+    DoubleBufferedWorld& World() noexcept { return world_; }
+    const DoubleBufferedWorld& World() const noexcept { return world_; }
+    exceptions::IQueue& Queue() noexcept { return queue_; }
+
+    void OnInput(PhaseHook hook) { inputHooks_.push_back(std::move(hook)); }
+    void OnPost(PhaseHook hook) { postHooks_.push_back(std::move(hook)); }
+
+    // runs one tick immediately
+    void Step();
+    // runs the given number of ticks, paced by the timestep in realtime mode
+    void Run(std::size_t ticks);
+
+    std::uint64_t CurrentTick() const noexcept { return tick_; }
+    std::chrono::nanoseconds SimulationTime() const noexcept { return config_.timestep * tick_; }
+
+    const exceptions::LatencyHistogram& PhaseLatency(Phase phase) const {
+        return phaseLatency_[static_cast<std::size_t>(phase)];
+    }
+    const exceptions::LatencyHistogram& TickLatency() const noexcept { return tickLatency_; }
+
+    std::uint64_t BudgetOverruns(Phase phase) const {
+        return budgetOverruns_[static_cast<std::size_t>(phase)];
+    }
+    // ticks that took longer than the timestep
+    std::uint64_t TickOverruns() const noexcept { return tickOverruns_; }
+
+    const ParallelExecutor& Executor() const noexcept { return executor_; }
+
+private:
+    template<typename TFunc>
+    void RunPhase(Phase phase, TFunc&& fn);
+
+    void RunPhysics();
+    template<typename TStore>
+    void RunPhysics(TStore& store);
+
+    SchedulerConfig config_;
+    ThreadPool pool_;
+    ParallelExecutor executor_{pool_};
+    EntityStore entities_;
+    DoubleBufferedWorld world_;
+    exceptions::QueueImpl queue_;
+    std::vector<PhaseHook> inputHooks_;
+    std::vector<PhaseHook> postHooks_;
+
+    std::uint64_t tick_{0};
+    std::array<exceptions::LatencyHistogram, phaseCount> phaseLatency_{};
+    exceptions::LatencyHistogram tickLatency_;
+    std::array<std::uint64_t, phaseCount> budgetOverruns_{};
+    std::uint64_t tickOverruns_{0};
+};
+
+} // namespace simulation
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <barrier>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <command_interface.hpp>
+#include <game.hpp>
+#include <queue_impl.hpp>
+
+#include "entity_schema.hpp"
+
+namespace simulation {
+
+// An entity of a ShardedWorld with the adapters commands are built on
+struct ShardEntity {
+    explicit ShardEntity(EntityId id)
+    : id{id} {}
+
+    ShardEntity(const ShardEntity&) = delete;
+    ShardEntity& operator=(const ShardEntity&) = delete;
+
+    EntityId id;
+    game::SpaceShip ship;
+    game::MovingObjectAdapter moving{&ship};
+    game::RotatingObjectAdapter rotating{&ship};
+};
+
+struct ShardedWorldConfig {
+    std::size_t shards{1};
+    // entities are split into equal stripes of [0, width) by their x coordinate,
+    // the first and the last stripe take everything beyond
+    int width{1 << 16};
+    // runs shard i on the CPUs of NUMA node i % nodes
+    bool pinToNodes{true};
+};
+
+// Entities partitioned spatially into shards, each with its own thread, queue and cmd_loop.
+// A tick runs all shards at once: a shard builds the commands sent to its entities, runs
+// them, moves and rotates its entities and hands the ones that left its stripe over to
+// their new shard, which takes them in before the tick ends. Commands are addressed by entity id and reach the owning shard through
+// its inbox, a shard forwards the ones for entities that have just left.
+// A shard allocates its entities on its own thread, so on a NUMA machine with the default
+// first-touch policy they live in the memory of the node the shard runs on.
+// Messages sent during a tick are read in the next one, the outcome of a tick does not
+// depend on the timing of the threads.
+class ShardedWorld {
+public:
+    using CommandFactory = std::function<exceptions::ICommandUPtr(ShardEntity&)>;
+
+    explicit ShardedWorld(ShardedWorldConfig config = {});
+    ~ShardedWorld();
+
+    ShardedWorld(const ShardedWorld&) = delete;
+    ShardedWorld& operator=(const ShardedWorld&) = delete;
+
+    // between ticks only, the owning shard creates the entity when the next tick starts
+    EntityId Add(game::Point location, game::Vector velocity = {0, 0});
+    // between ticks the command runs in the next tick, from a command of a shard in the one after;
+    // the command must not outlive the entity's ShardEntity, it does not survive a migration
+    void Send(EntityId id, CommandFactory factory);
+
+    // rethrows the first exception of a shard's factories or commands, the tick still completes
+    void Step();
+
+    // between ticks only
+    const game::IEntity& Get(EntityId id) const;
+    std::size_t ShardOf(EntityId id) const { return owners_.at(id); }
+
+    std::size_t Shards() const noexcept { return shards_.size(); }
+    std::size_t Size() const noexcept { return owners_.size(); }
+    std::size_t Nodes() const noexcept { return nodes_; }
+    std::uint64_t CurrentTick() const noexcept { return tick_; }
+    // entities handed over between shards so far
+    std::uint64_t Migrations() const noexcept { return migrations_; }
+
+private:
+    struct Letter {
+        EntityId id;
+        CommandFactory factory;
+    };
+
+    struct Arrival {
+        EntityId id;
+        std::vector<std::string> values;
+    };
+
+    // messages for one tick
+    struct Inbox {
+        std::mutex mtx;
+        std::vector<Arrival> arrivals;
+        std::vector<Letter> letters;
+    };
+
+    struct Shard {
+        std::size_t index;
+        std::unordered_map<EntityId, std::unique_ptr<ShardEntity>> entities;
+        // by the parity of the tick they are read in
+        std::array<Inbox, 2> inboxes;
+        // the letters of the running tick, taken out of its inbox
+        std::vector<Letter> letters;
+        exceptions::QueueImpl queue;
+        // entities handed over in the running tick and their new shards
+        std::vector<std::pair<EntityId, std::size_t>> moved;
+        std::exception_ptr error;
+        std::thread thread;
+    };
+
+    void ShardLoop(Shard& shard, const std::vector<int>& cpus);
+    void RunTick(Shard& shard);
+    void TakeArrivals(Shard& shard, Inbox& inbox);
+    static void KeepError(Shard& shard, std::exception_ptr error) noexcept;
+    std::size_t Owner(const game::Point& location) const noexcept;
+    Inbox& NextInbox(std::size_t shard);
+
+    ShardedWorldConfig config_;
+    EntitySchema schema_{ShipSchema()};
+    std::size_t nodes_{1};
+    std::deque<Shard> shards_;
+    // the shard of every entity, as of the start of the running tick
+    std::deque<std::size_t> owners_;
+    std::uint64_t migrations_{0};
+    std::uint64_t tick_{0};
+
+    // the driving thread and the shards meet before a tick, before the hand-over and after it
+    std::barrier<> tickBarrier_;
+    bool stop_{false};
+};
+
+} // namespace simulation
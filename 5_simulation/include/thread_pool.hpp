@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace simulation {
+
+// Fixed-size fork/join pool. The calling thread takes part in every job,
+// so ThreadPool{1} runs everything inline without any worker threads.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t Size() const noexcept { return workers_.size() + 1; }
+
+    // Splits [0, count) into Size() contiguous chunks and calls fn(begin, end) for each of them.
+    // The chunk boundaries depend on count and Size() only. Blocks until all chunks are done,
+    // rethrows the first exception thrown by fn.
+    template<typename TFunc>
+    void ParallelFor(std::size_t count, TFunc&& fn) {
+        const auto chunks = Size();
+        RunChunks([&fn, count, chunks](std::size_t chunk) {
+            const auto begin = count * chunk / chunks;
+            const auto end = count * (chunk + 1) / chunks;
+            if (begin != end) fn(begin, end);
+        });
+    }
+
+private:
+    using ChunkTask = std::function<void(std::size_t)>;
+
+    void RunChunks(ChunkTask task);
+    void WorkerLoop(std::size_t chunk);
+
+    std::vector<std::thread> workers_;
+    std::mutex mtx_;
+    std::condition_variable startCv_;
+    std::condition_variable doneCv_;
+    ChunkTask task_;
+    std::size_t generation_{0};
+    std::size_t pending_{0};
+    std::exception_ptr error_;
+    bool stop_{false};
+};
+
+} // namespace simulation
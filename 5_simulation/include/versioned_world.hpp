@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <primitives.hpp>
+
+#include "entity_schema.hpp"
+
+namespace simulation {
+
+// Multi-version entity storage: one writer thread updates entities through Get() while
+// any number of reader threads look at consistent snapshots of all of them.
+// Writes are grouped into epochs. A write copies the entity's latest version once per
+// epoch and Commit() makes all writes of the epoch visible at once. A reader pins the
+// last committed epoch with TakeSnapshot() and sees the newest version of every entity
+// not newer than that epoch, no matter how many epochs the writer commits meanwhile.
+// Neither side waits for the other. Commit() also frees the versions that no pinned
+// snapshot can reach any more (epoch based reclamation).
+class VersionedWorld {
+public:
+    // snapshots alive at the same time
+    static constexpr std::size_t maxReaders{64};
+
+    class Snapshot;
+
+    // the capacity is fixed so readers can index entities while the writer adds new ones
+    explicit VersionedWorld(std::size_t capacity, EntitySchema schema = ShipSchema());
+    ~VersionedWorld();
+
+    VersionedWorld(const VersionedWorld&) = delete;
+    VersionedWorld& operator=(const VersionedWorld&) = delete;
+
+    // writer side
+
+    // the new entity has the initial values of the schema in every snapshot taken after Add()
+    EntityId Add();
+    // reads the writer's own latest values, writes go to the current epoch
+    game::IEntity& Get(EntityId id) { return writers_.at(id); }
+    // publishes the current epoch and reclaims unreachable versions, returns the published epoch
+    std::uint64_t Commit();
+
+    // reader side, any thread
+
+    Snapshot TakeSnapshot() const;
+
+    std::size_t Size() const noexcept { return size_.load(std::memory_order_acquire); }
+    std::uint64_t CommittedEpoch() const noexcept { return committed_.load(std::memory_order_acquire); }
+    // versions kept besides the latest one of every entity
+    std::size_t RetainedVersions() const noexcept { return retained_; }
+
+private:
+    struct Version {
+        std::uint64_t epoch;
+        Version* older;
+        std::vector<std::string> values;
+    };
+
+    class Writer : public game::IEntity {
+    public:
+        Writer(VersionedWorld& world, EntityId id)
+        : world_{world}
+        , id_{id} {}
+
+        std::string getProperty(std::string_view key) const override;
+        void setProperty(std::string_view key, std::string_view val) override;
+
+    private:
+        VersionedWorld& world_;
+        EntityId id_;
+    };
+
+    // a slot of a pinned epoch, padded so readers do not share cache lines
+    struct alignas(64) ReaderSlot {
+        std::atomic<std::uint64_t> epoch{idle};
+    };
+
+    static constexpr std::uint64_t idle = static_cast<std::uint64_t>(-1);
+
+    std::size_t Index(std::string_view key, const char* action) const;
+    const Version* Visible(EntityId id, std::uint64_t epoch) const;
+    std::uint64_t OldestPinned() const noexcept;
+    void Reclaim();
+
+    EntitySchema schema_;
+    std::size_t capacity_;
+    std::unique_ptr<std::atomic<Version*>[]> heads_;
+    std::atomic<std::size_t> size_{0};
+    std::deque<Writer> writers_;
+    mutable std::array<ReaderSlot, maxReaders> readers_{};
+
+    std::atomic<std::uint64_t> committed_{0};
+    std::uint64_t writeEpoch_{1};
+    // entities with more than one version, the only ones Reclaim() has to look at
+    std::vector<EntityId> versioned_;
+    std::size_t retained_{0};
+};
+
+// A consistent read-only view of all entities, pinned until destruction.
+class VersionedWorld::Snapshot {
+public:
+    // read-only handle for the adapters, setProperty throws
+    class Entity : public game::IEntity {
+    public:
+        Entity(const Snapshot& snapshot, EntityId id)
+        : snapshot_{snapshot}
+        , id_{id} {}
+
+        std::string getProperty(std::string_view key) const override { return snapshot_.Get(id_, key); }
+        void setProperty(std::string_view key, std::string_view val) override;
+
+    private:
+        const Snapshot& snapshot_;
+        EntityId id_;
+    };
+
+    Snapshot(Snapshot&& other) noexcept;
+    Snapshot& operator=(Snapshot&&) = delete;
+    ~Snapshot();
+
+    std::uint64_t Epoch() const noexcept { return epoch_; }
+    // entities added before the snapshot was taken
+    std::size_t Size() const noexcept { return size_; }
+
+    std::string Get(EntityId id, std::string_view key) const;
+    // the value is valid as long as the snapshot
+    std::string_view View(EntityId id, std::string_view key) const;
+    Entity operator[](EntityId id) const { return Entity{*this, id}; }
+
+private:
+    friend class VersionedWorld;
+
+    Snapshot(const VersionedWorld& world, ReaderSlot& slot, std::uint64_t epoch, std::size_t size)
+    : world_{&world}
+    , slot_{&slot}
+    , epoch_{epoch}
+    , size_{size} {}
+
+    const VersionedWorld* world_;
+    ReaderSlot* slot_;
+    std::uint64_t epoch_;
+    std::size_t size_;
+};
+
+} // namespace simulation
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <command_codec.hpp>
+#include <primitives.hpp>
+
+#include "entity_schema.hpp"
+#include "scheduler.hpp"
+#include "thread_pool.hpp"
+
+namespace simulation {
+
+struct WalConfig {
+    // a group is written at the latest this long after its first record
+    std::chrono::microseconds flushInterval{1000};
+    // or as soon as it has this many bytes
+    std::size_t flushBytes{std::size_t{1} << 20};
+    // fdatasync every group, without it the log survives a crash of the process but not of the machine
+    bool sync{true};
+};
+
+// Write-ahead log of the property writes of an EntityStore, one directory per store:
+//   checkpoint.bin       all properties of all entities up to an LSN
+//   wal-<LSN>.log        groups of records from that LSN on
+// A record is an entity id, a property of the schema and the new value, or the creation of an entity. Append() only
+// encodes the record into the pending group; a flusher thread writes groups and syncs
+// them, so many records share one fdatasync (group commit). The log sequence number
+// (LSN) of a record is the number of records appended before it.
+// Recover() loads the checkpoint and applies the records after it, the entities split
+// between the threads of a pool. Every group carries a checksum, replay stops at the
+// first torn one.
+class WriteAheadLog {
+public:
+    // Starts a new segment. nextLsn is 0 for an empty directory, otherwise the LSN returned by
+    // Recover(); a checkpoint beyond it is an invalid_argument, segments from it on are removed.
+    WriteAheadLog(std::filesystem::path dir, std::uint64_t nextLsn, WalConfig config = {},
+                  EntitySchema schema = ShipSchema());
+    // writes the pending group
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // any thread, returns the LSN of the record
+    std::uint64_t Append(EntityId id, std::size_t prop, std::string_view value);
+    // an entity that has the initial values, the store is grown to hold it on recovery
+    std::uint64_t AppendCreate(EntityId id) { return Append(id, createProp, {}); }
+    // blocks until the record is on disk, an out_of_range for a record not appended yet
+    void WaitDurable(std::uint64_t lsn);
+    // blocks until everything appended so far is on disk
+    void Flush();
+    // stores the state of the store and starts a new segment, older segments are removed;
+    // nothing may be appended or written to the store meanwhile
+    void Checkpoint(const EntityStore& store);
+
+    // the index of the property in the schema, a logic_error for unknown ones
+    std::size_t Property(std::string_view key) const;
+
+    std::uint64_t NextLsn() const;
+    // records below it are on disk
+    std::uint64_t DurableLsn() const;
+    std::uint64_t Groups() const noexcept { return groups_.load(std::memory_order_relaxed); }
+
+    // fills an empty store from the directory, returns the LSN to continue with
+    static std::uint64_t Recover(const std::filesystem::path& dir, EntityStore& store, ThreadPool& pool,
+                                 const EntitySchema& schema = ShipSchema());
+
+private:
+    static constexpr std::size_t createProp{0xff};
+
+    void FlushLoop(std::stop_token stop);
+    void WriteGroup(std::uint64_t firstLsn, std::uint64_t records, std::span<const std::uint8_t> payload);
+    void OpenSegment(std::uint64_t firstLsn);
+    void ThrowIfFailed() const;
+
+    std::filesystem::path dir_;
+    WalConfig config_;
+    EntitySchema schema_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable_any flushCv_;
+    std::condition_variable durableCv_;
+    command::BinaryWriter pending_;
+    std::uint64_t pendingFirst_;
+    std::uint64_t nextLsn_;
+    std::uint64_t durableLsn_;
+    bool flushRequested_{false};
+    std::exception_ptr error_;
+
+    // the segment, written by the flusher and switched by Checkpoint()
+    std::mutex fileMtx_;
+    int fd_{-1};
+    std::atomic<std::uint64_t> groups_{0};
+
+    std::jthread flusher_;
+};
+
+// Writes through to the entity and logs every write. Adapters and commands take it like
+// any other entity.
+class LoggedEntity : public game::IEntity {
+public:
+    LoggedEntity(game::IEntity& entity, EntityId id, WriteAheadLog& wal)
+    : entity_{entity}
+    , id_{id}
+    , wal_{wal} {}
+
+    std::string getProperty(std::string_view key) const override { return entity_.getProperty(key); }
+
+    void getProperties(std::span<const std::string_view> keys, std::span<std::string> values) const override {
+        entity_.getProperties(keys, values);
+    }
+
+    void setProperty(std::string_view key, std::string_view val) override {
+        const auto prop = wal_.Property(key);
+        entity_.setProperty(key, val);
+        wal_.Append(id_, prop, val);
+    }
+
+private:
+    game::IEntity& entity_;
+    EntityId id_;
+    WriteAheadLog& wal_;
+};
+
+} // namespace simulation
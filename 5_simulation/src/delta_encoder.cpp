@@ -0,0 +1,115 @@
+#include "delta_encoder.hpp"
+
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <stdexcept>
+
+namespace simulation {
+
+namespace {
+
+constexpr double angleStep{2. * std::numbers::pi / 65536.};
+
+void WriteDelta(command::BinaryWriter& out, const game::Point& from, const game::Point& to) {
+    out.WriteZigzag(static_cast<std::int64_t>(to.x()) - from.x());
+    out.WriteZigzag(static_cast<std::int64_t>(to.y()) - from.y());
+}
+
+void WriteDelta(command::BinaryWriter& out, const game::Vector& from, const game::Vector& to) {
+    out.WriteZigzag(static_cast<std::int64_t>(to.x) - from.x);
+    out.WriteZigzag(static_cast<std::int64_t>(to.y) - from.y);
+}
+
+} // namespace
+
+std::uint16_t QuantizeAngle(game::Angle angle) noexcept {
+    // the wrap-around to [0, 2pi) comes with the conversion
+    return static_cast<std::uint16_t>(std::llround(angle.rad / angleStep));
+}
+
+std::int32_t QuantizeAngularVelocity(game::Angle velocity) noexcept {
+    return static_cast<std::int32_t>(std::llround(velocity.rad / angleStep));
+}
+
+game::Angle DequantizeAngle(std::int64_t steps) noexcept {
+    return game::Angle{.rad = static_cast<double>(steps) * angleStep};
+}
+
+std::span<const std::uint8_t> DeltaEncoder::Encode(EntityStore& store) {
+    out_.Clear();
+    sent_.resize(store.Size());
+
+    EntityId next{0};
+    for (EntityId id = 0; id < store.Size(); ++id) {
+        auto& ship = store.Get(id);
+        const auto mask = ship.DirtyMask();
+        if (0 == mask) continue;
+        ship.ClearDirty();
+
+        // gaps are sent + 1, zero ends the stream
+        out_.WriteVarint(id - next + 1);
+        out_.WriteByte(mask);
+        next = id + 1;
+
+        auto& sent = sent_[id];
+        if (mask & game::SpaceShip::locationBit) {
+            const auto location = game::Point::fromString(ship.getProperty("location"));
+            WriteDelta(out_, sent.location, location);
+            sent.location = location;
+        }
+        if (mask & game::SpaceShip::velocityBit) {
+            const auto velocity = game::Vector::fromString(ship.getProperty("velocity"));
+            WriteDelta(out_, sent.velocity, velocity);
+            sent.velocity = velocity;
+        }
+        if (mask & game::SpaceShip::angleBit) {
+            const auto angle = QuantizeAngle(game::Angle::fromString(ship.getProperty("angle")));
+            // the shortest way around the circle
+            out_.WriteZigzag(static_cast<std::int16_t>(angle - sent.angle));
+            sent.angle = angle;
+        }
+        if (mask & game::SpaceShip::angularVelocityBit) {
+            const auto velocity = QuantizeAngularVelocity(game::Angle::fromString(ship.getProperty("angular_velocity")));
+            out_.WriteZigzag(static_cast<std::int64_t>(velocity) - sent.angularVelocity);
+            sent.angularVelocity = velocity;
+        }
+    }
+    out_.WriteVarint(0);
+    return out_.Data();
+}
+
+void DeltaDecoder::Apply(std::span<const std::uint8_t> delta) {
+    command::BinaryReader in{delta};
+    EntityId next{0};
+    while (const auto gap = in.ReadVarint()) {
+        // next never exceeds maxShips_, so neither the check nor the id can overflow
+        if (gap > maxShips_ - next) {
+            throw std::invalid_argument(std::format("Ship id beyond the limit of {} in a delta stream", maxShips_));
+        }
+        const auto id = next + gap - 1;
+        next = id + 1;
+        if (ships_.size() <= id) ships_.resize(id + 1);
+
+        auto& ship = ships_[id];
+        const auto mask = in.ReadByte();
+        if (mask & game::SpaceShip::locationBit) {
+            const auto dx = in.ReadZigzag();
+            const auto dy = in.ReadZigzag();
+            ship.location = game::Point{static_cast<int>(ship.location.x() + dx), static_cast<int>(ship.location.y() + dy)};
+        }
+        if (mask & game::SpaceShip::velocityBit) {
+            ship.velocity.x += static_cast<int>(in.ReadZigzag());
+            ship.velocity.y += static_cast<int>(in.ReadZigzag());
+        }
+        if (mask & game::SpaceShip::angleBit) {
+            ship.angle = static_cast<std::uint16_t>(ship.angle + in.ReadZigzag());
+        }
+        if (mask & game::SpaceShip::angularVelocityBit) {
+            ship.angularVelocity += static_cast<std::int32_t>(in.ReadZigzag());
+        }
+    }
+    if (!in.AtEnd()) throw std::invalid_argument("Trailing bytes after the end of a delta stream");
+}
+
+} // namespace simulation
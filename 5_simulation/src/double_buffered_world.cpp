@@ -0,0 +1,63 @@
+#include "double_buffered_world.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+namespace simulation {
+
+DoubleBufferedWorld::DoubleBufferedWorld(EntitySchema schema)
+: schema_{std::move(schema)} {}
+
+EntityId DoubleBufferedWorld::Add() {
+    const auto id = views_.size();
+    for (auto& buffer: buffers_) {
+        for (const auto& [name, initial]: schema_) buffer.push_back(initial);
+    }
+    views_.emplace_back(*this, id);
+    if (id % pageEntities == 0) dirty_.emplace_back(false);
+    return id;
+}
+
+std::size_t DoubleBufferedWorld::Slot(EntityId id, std::string_view key, const char* action) const {
+    if (const auto prop = PropertyIndex(schema_, key); noProperty != prop) return id * schema_.size() + prop;
+    throw std::logic_error(std::format("Unable to {} '{}' property in DoubleBufferedWorld entity", action, key));
+}
+
+std::string DoubleBufferedWorld::View::getProperty(std::string_view key) const {
+    return world_.buffers_[world_.front_][world_.Slot(id_, key, "find")];
+}
+
+void DoubleBufferedWorld::View::setProperty(std::string_view key, std::string_view val) {
+    world_.buffers_[world_.front_ ^ 1][world_.Slot(id_, key, "set")] = val;
+    // a load first keeps the page's flag from bouncing between writers
+    auto& dirty = world_.dirty_[id_ / pageEntities];
+    if (!dirty.load(std::memory_order_relaxed)) dirty.store(true, std::memory_order_relaxed);
+}
+
+void DoubleBufferedWorld::Swap(ThreadPool& pool) {
+    front_ ^= 1;
+
+    dirtyPages_.clear();
+    for (std::size_t page = 0; page < dirty_.size(); ++page) {
+        if (dirty_[page].load(std::memory_order_relaxed)) {
+            dirtyPages_.push_back(page);
+            dirty_[page].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // the new back buffer misses exactly the writes of the dirty pages
+    const auto& from = buffers_[front_];
+    auto& to = buffers_[front_ ^ 1];
+    const auto pageSlots = pageEntities * schema_.size();
+    pool.ParallelFor(dirtyPages_.size(), [&](std::size_t begin, std::size_t end) {
+        for (auto idx = begin; idx < end; ++idx) {
+            const auto first = dirtyPages_[idx] * pageSlots;
+            const auto last = std::min(first + pageSlots, from.size());
+            std::copy(from.begin() + first, from.begin() + last, to.begin() + first);
+        }
+    });
+    copiedPages_ = dirtyPages_.size();
+}
+
+} // namespace simulation
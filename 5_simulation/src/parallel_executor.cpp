@@ -0,0 +1,152 @@
+#include "parallel_executor.hpp"
+
+#include <algorithm>
+#include <typeinfo>
+
+#include <cmd_loop.hpp>
+#include <exceptions_impl.hpp>
+#include <tracer.hpp>
+
+namespace simulation {
+
+std::size_t ParallelExecutor::Run(exceptions::IQueue& queue, std::size_t maxCommands) {
+    if (1 == pool_.Size()) {
+        const auto executed = exceptions::cmd_loop::run(queue, maxCommands);
+        commands_ += executed;
+        levels_ += executed;
+        return executed;
+    }
+
+    std::size_t executed{0};
+    // commands pushed by handlers are queued behind the window and make the next one
+    while (executed < maxCommands && !queue.IsEmpty()) {
+        window_.clear();
+        while (executed + window_.size() < maxCommands && !queue.IsEmpty()) {
+            window_.push_back(queue.Take());
+        }
+
+        const auto levels = Plan();
+        failures_.assign(window_.size(), nullptr);
+        ran_.assign(window_.size(), false);
+        try {
+            for (std::size_t level = 0; level < levels; ++level) {
+                ExecuteLevel(levelStart_[level], levelStart_[level + 1]);
+            }
+        } catch (...) {
+            Requeue(queue);
+            throw;
+        }
+        executed += window_.size();
+        commands_ += window_.size();
+        levels_ += levels;
+    }
+    window_.clear();
+    return executed;
+}
+
+std::size_t ParallelExecutor::Plan() {
+    const auto size = window_.size();
+    level_.resize(size);
+    frontiers_.clear();
+
+    std::size_t floor{0};   // commands after one with an unknown set go above it
+    std::size_t levels{0};
+    for (std::size_t i = 0; i < size; ++i) {
+        access_.Clear();
+        if (auto* game = asGame_(*window_[i])) game->DeclareAccess(access_);
+        else access_.MarkUnknown();
+
+        auto level = floor;
+        if (access_.Unknown()) {
+            level = std::max(floor, levels);
+            floor = level + 1;
+        } else {
+            touched_.clear();
+            for (const auto& access: access_.Accesses()) {
+                auto& frontier = frontiers_[Key{access.target, access.property}];
+                touched_.push_back(&frontier);
+                level = std::max(level, access.write ? std::max(frontier.afterWrite, frontier.afterRead) : frontier.afterWrite);
+            }
+            const auto& accesses = access_.Accesses();
+            for (std::size_t a = 0; a < accesses.size(); ++a) {
+                auto& frontier = *touched_[a];
+                if (accesses[a].write) frontier.afterWrite = level + 1;
+                else frontier.afterRead = std::max(frontier.afterRead, level + 1);
+            }
+        }
+        level_[i] = level;
+        levels = std::max(levels, level + 1);
+    }
+
+    // counting sort by level keeps queue order inside a level
+    levelStart_.assign(levels + 1, 0);
+    for (const auto level: level_) ++levelStart_[level + 1];
+    for (std::size_t level = 0; level < levels; ++level) levelStart_[level + 1] += levelStart_[level];
+    order_.resize(size);
+    auto next = levelStart_;
+    for (std::size_t i = 0; i < size; ++i) order_[next[level_[i]]++] = i;
+    return levels;
+}
+
+void ParallelExecutor::ExecuteLevel(std::size_t begin, std::size_t end) {
+    const auto execute = [this](std::size_t from, std::size_t to) {
+        for (auto pos = from; pos < to; ++pos) {
+            const auto idx = order_[pos];
+            const auto& cmd = window_[idx];
+            try {
+                if (exceptions::trace::Enabled()) [[unlikely]] {
+                    const exceptions::trace::Span span{exceptions::trace::Category::Command, typeid(*cmd)};
+                    cmd->Execute();
+                } else {
+                    cmd->Execute();
+                }
+            } catch (const exceptions::IException&) {
+                failures_[idx] = std::current_exception();
+            }
+            ran_[idx] = true;
+        }
+    };
+
+    // anything else stops its chunk, the commands that ran still get their handlers
+    std::exception_ptr error;
+    try {
+        if (end - begin < minParallelLevel_) {
+            execute(begin, end);
+        } else {
+            pool_.ParallelFor(end - begin, [&](std::size_t from, std::size_t to) { execute(begin + from, begin + to); });
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // ExceptionHandler and the commands it returns are not meant to run concurrently
+    for (auto pos = begin; pos < end; ++pos) {
+        const auto idx = order_[pos];
+        if (!failures_[idx]) continue;
+        try {
+            std::rethrow_exception(failures_[idx]);
+        } catch (const exceptions::IException& e) {
+            if (exceptions::trace::Enabled()) {
+                const exceptions::trace::Span span{exceptions::trace::Category::Handler, typeid(e)};
+                exceptions::ExceptionHandler::Handle(window_[idx], e)->Execute();
+            } else {
+                exceptions::ExceptionHandler::Handle(window_[idx], e)->Execute();
+            }
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ParallelExecutor::Requeue(exceptions::IQueue& queue) {
+    // the commands that did not run go back in front of the rest, as cmd_loop::run leaves them
+    std::vector<exceptions::ICommandUPtr> rest;
+    rest.reserve(queue.Size());
+    while (!queue.IsEmpty()) rest.push_back(queue.Take());
+    for (std::size_t idx = 0; idx < window_.size(); ++idx) {
+        if (!ran_[idx]) queue.Push(std::move(window_[idx]));
+    }
+    for (auto& cmd: rest) queue.Push(std::move(cmd));
+    window_.clear();
+}
+
+} // namespace simulation
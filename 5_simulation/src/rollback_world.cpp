@@ -0,0 +1,107 @@
+#include "rollback_world.hpp"
+
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#include <cmd_loop.hpp>
+
+namespace simulation {
+
+RollbackWorld::RollbackWorld(std::size_t historyTicks, EntitySchema schema)
+: schema_{std::move(schema)}
+, frames_(historyTicks) {}
+
+EntityId RollbackWorld::Add() {
+    const auto id = views_.size();
+    for (const auto& [name, initial]: schema_) {
+        values_.push_back(initial);
+        recordedIn_.push_back(0);
+    }
+    views_.emplace_back(*this, id);
+    return id;
+}
+
+std::size_t RollbackWorld::Slot(EntityId id, std::string_view key, const char* action) const {
+    if (const auto prop = PropertyIndex(schema_, key); noProperty != prop) return id * schema_.size() + prop;
+    throw std::logic_error(std::format("Unable to {} '{}' property in RollbackWorld entity", action, key));
+}
+
+std::string RollbackWorld::View::getProperty(std::string_view key) const {
+    return world_.values_[world_.Slot(id_, key, "find")];
+}
+
+void RollbackWorld::View::setProperty(std::string_view key, std::string_view val) {
+    world_.Write(world_.Slot(id_, key, "set"), val);
+}
+
+void RollbackWorld::Write(std::size_t slot, std::string_view val) {
+    auto& value = values_[slot];
+    if (recording_ != nullptr && recordedIn_[slot] != tick_ + 1) {
+        // the old value moves into the record, only the new one is copied
+        recording_->undo.push_back({slot, std::move(value)});
+        recordedIn_[slot] = tick_ + 1;
+    }
+    value = val;
+}
+
+void RollbackWorld::Input(std::uint64_t tick, exceptions::ICommandUPtr cmd) {
+    if (tick < OldestTick()) {
+        throw std::out_of_range(std::format("Unable to add an input to tick {}, the oldest kept tick is {}", tick, OldestTick()));
+    }
+    inputs_[tick].push_back(std::move(cmd));
+}
+
+void RollbackWorld::Step() {
+    // a throwing command or hook ends the tick too, what it wrote so far stays rewindable
+    struct TickEnd {
+        RollbackWorld& world;
+        ~TickEnd() { world.FinishTick(); }
+    } end{*this};
+
+    if (!frames_.empty()) {
+        // the oldest frame makes room, its tick cannot be rewound to any more
+        recording_ = &frames_[tick_ % frames_.size()];
+        recording_->tick = tick_;
+        recording_->undo.clear();
+    }
+
+    // the recorded inputs stay for a resimulation, the queue gets copies
+    if (const auto inputs = inputs_.find(tick_); std::end(inputs_) != inputs) {
+        for (const auto& cmd: inputs->second) queue_.Push(cmd->Clone());
+        exceptions::cmd_loop::run(queue_);
+    }
+    for (auto& hook: hooks_) hook(*this);
+}
+
+void RollbackWorld::FinishTick() noexcept {
+    // inputs cut short by a throw do not leak into the next tick
+    while (!queue_.IsEmpty()) queue_.Pop();
+    lastRecorded_ = recording_ != nullptr ? recording_->undo.size() : 0;
+    recording_ = nullptr;
+    ++tick_;
+    inputs_.erase(std::begin(inputs_), inputs_.lower_bound(OldestTick()));
+}
+
+void RollbackWorld::RewindTo(std::uint64_t tick) {
+    if (tick > tick_ || tick < OldestTick()) {
+        throw std::out_of_range(std::format("Unable to rewind to tick {}, kept ticks are {} to {}", tick, OldestTick(), tick_));
+    }
+    while (tick_ > tick) {
+        --tick_;
+        auto& frame = frames_[tick_ % frames_.size()];
+        for (auto undo = frame.undo.rbegin(); undo != frame.undo.rend(); ++undo) {
+            values_[undo->slot] = std::move(undo->old);
+            recordedIn_[undo->slot] = 0;
+        }
+        frame.undo.clear();
+    }
+}
+
+void RollbackWorld::Resimulate(std::uint64_t fromTick) {
+    const auto current = tick_;
+    RewindTo(fromTick);
+    while (tick_ < current) Step();
+}
+
+} // namespace simulation
@@ -0,0 +1,100 @@
+#include "scheduler.hpp"
+
+#include <thread>
+
+#include <cmd_loop.hpp>
+
+namespace simulation {
+
+using Clock = std::chrono::steady_clock;
+
+EntityId EntityStore::Add() {
+    entities_.push_back(std::make_unique<game::SpaceShip>());
+    return entities_.size() - 1;
+}
+
+Scheduler::Scheduler(SchedulerConfig config)
+: config_{config}
+, pool_{config.threads}
+{}
+
+template<typename TFunc>
+void Scheduler::RunPhase(Phase phase, TFunc&& fn) {
+    const auto idx = static_cast<std::size_t>(phase);
+    const auto start = Clock::now();
+    fn();
+    const auto elapsed = Clock::now() - start;
+
+    phaseLatency_[idx].Record(elapsed);
+    const auto budget = config_.phaseBudgets[idx];
+    if (budget.count() > 0 && elapsed > budget) {
+        ++budgetOverruns_[idx];
+    }
+}
+
+void Scheduler::Step() {
+    const auto start = Clock::now();
+
+    RunPhase(Phase::Input, [this] {
+        for (auto& hook: inputHooks_) hook(*this);
+    });
+    // the command budget is a command count, not wall time, so replays stay deterministic
+    RunPhase(Phase::Commands, [this] {
+        if (config_.parallelCommands) executor_.Run(queue_, config_.maxCommandsPerTick);
+        else exceptions::cmd_loop::run(queue_, config_.maxCommandsPerTick);
+        if (config_.doubleBuffered) world_.Swap(pool_);
+        game::ChangeBus::Dispatch();
+    });
+    RunPhase(Phase::Physics, [this] {
+        RunPhysics();
+        game::ChangeBus::Dispatch();
+    });
+    RunPhase(Phase::Post, [this] {
+        for (auto& hook: postHooks_) hook(*this);
+    });
+
+    const auto elapsed = Clock::now() - start;
+    tickLatency_.Record(elapsed);
+    if (elapsed > config_.timestep) {
+        ++tickOverruns_;
+    }
+    ++tick_;
+}
+
+void Scheduler::Run(std::size_t ticks) {
+    auto deadline = Clock::now();
+    for (std::size_t i = 0; i < ticks; ++i) {
+        Step();
+        if (!config_.realtime) continue;
+
+        // a late tick is not followed by a sleep, the following ones catch up
+        deadline += config_.timestep;
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+template<typename TStore>
+void Scheduler::RunPhysics(TStore& store) {
+    pool_.ParallelFor(store.Size(), [&store](std::size_t begin, std::size_t end) {
+        for (auto id = begin; id < end; ++id) {
+            auto& ship = store.Get(id);
+
+            game::MovingObjectAdapter moa{&ship};
+            game::Move{&moa}.Execute();
+
+            game::RotatingObjectAdapter roa{&ship};
+            game::Rotate{&roa}.Execute();
+        }
+    });
+}
+
+void Scheduler::RunPhysics() {
+    if (!config_.doubleBuffered) {
+        RunPhysics(entities_);
+        return;
+    }
+    RunPhysics(world_);
+    world_.Swap(pool_);
+}
+
+} // namespace simulation
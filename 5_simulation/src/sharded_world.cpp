@@ -0,0 +1,237 @@
+#include "sharded_world.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <cmd_loop.hpp>
+
+namespace simulation {
+
+namespace {
+
+// the shard running on this thread, messages it sends are for the next tick
+thread_local const void* currentWorld{nullptr};
+
+// "0-3,8,10-11"
+std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss{list};
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        const auto dash = range.find('-');
+        const auto first = std::stoi(range.substr(0, dash));
+        const auto last = std::string::npos == dash ? first : std::stoi(range.substr(dash + 1));
+        for (auto cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// CPUs of every NUMA node, a single node with no CPUs to pin to when the system does not tell
+std::vector<std::vector<int>> NodeCpus() {
+    namespace fs = std::filesystem;
+    std::vector<std::vector<int>> nodes;
+    std::error_code ec;
+    for (int node = 0;; ++node) {
+        const auto path = fs::path{"/sys/devices/system/node"} / std::format("node{}", node) / "cpulist";
+        if (!fs::exists(path, ec)) break;
+        std::ifstream in{path};
+        std::string list;
+        std::getline(in, list);
+        if (auto cpus = ParseCpuList(list); !cpus.empty()) nodes.push_back(std::move(cpus));
+    }
+    if (nodes.empty()) nodes.emplace_back();
+    return nodes;
+}
+
+void PinToCpus(const std::vector<int>& cpus) {
+    if (cpus.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu: cpus) CPU_SET(cpu, &set);
+    // best effort, a cgroup may not allow the node
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+}
+
+} // namespace
+
+ShardedWorld::ShardedWorld(ShardedWorldConfig config)
+: config_{config}
+, tickBarrier_{static_cast<std::ptrdiff_t>(std::max<std::size_t>(config.shards, 1) + 1)} {
+    const auto nodeCpus = config_.pinToNodes ? NodeCpus() : std::vector<std::vector<int>>{{}};
+    nodes_ = nodeCpus.size();
+    for (std::size_t i = 0; i < std::max<std::size_t>(config_.shards, 1); ++i) {
+        auto& shard = shards_.emplace_back();
+        shard.index = i;
+        shard.thread = std::thread{[this, &shard, &cpus = nodeCpus[i % nodeCpus.size()]] { ShardLoop(shard, cpus); }};
+    }
+    // the threads have pinned themselves, nodeCpus may go
+    tickBarrier_.arrive_and_wait();
+}
+
+ShardedWorld::~ShardedWorld() {
+    stop_ = true;
+    tickBarrier_.arrive_and_wait();
+    for (auto& shard: shards_) shard.thread.join();
+}
+
+void ShardedWorld::ShardLoop(Shard& shard, const std::vector<int>& cpus) {
+    PinToCpus(cpus);
+    currentWorld = this;
+    tickBarrier_.arrive_and_wait();
+    for (;;) {
+        tickBarrier_.arrive_and_wait();
+        if (stop_) return;
+        try {
+            RunTick(shard);
+        } catch (...) {
+            KeepError(shard, std::current_exception());
+        }
+        tickBarrier_.arrive_and_wait();
+        // the entities handed over in this tick, before anybody looks at them
+        TakeArrivals(shard, shard.inboxes[(tick_ + 1) % 2]);
+        tickBarrier_.arrive_and_wait();
+    }
+}
+
+std::size_t ShardedWorld::Owner(const game::Point& location) const noexcept {
+    const auto x = std::clamp<long long>(location.x(), 0, config_.width - 1);
+    return static_cast<std::size_t>(x * static_cast<long long>(shards_.size()) / config_.width);
+}
+
+ShardedWorld::Inbox& ShardedWorld::NextInbox(std::size_t shard) {
+    // the inbox of the running tick belongs to the shard until the tick ends
+    const auto tick = currentWorld == this ? tick_ + 1 : tick_;
+    return shards_[shard].inboxes[tick % 2];
+}
+
+EntityId ShardedWorld::Add(game::Point location, game::Vector velocity) {
+    // the shards read owners_ while a tick runs
+    if (currentWorld == this) throw std::logic_error("Entities can not be added to a ShardedWorld from a running tick");
+    const auto id = owners_.size();
+    const auto shard = Owner(location);
+    owners_.emplace_back(shard);
+
+    Arrival arrival{id, {}};
+    for (const auto& [key, initial]: schema_) arrival.values.push_back(initial);
+    arrival.values[PropertyIndex(schema_, "location")] = location.toString();
+    arrival.values[PropertyIndex(schema_, "velocity")] = velocity.toString();
+
+    auto& inbox = NextInbox(shard);
+    std::lock_guard lock{inbox.mtx};
+    inbox.arrivals.push_back(std::move(arrival));
+    return id;
+}
+
+void ShardedWorld::Send(EntityId id, CommandFactory factory) {
+    auto& inbox = NextInbox(ShardOf(id));
+    std::lock_guard lock{inbox.mtx};
+    inbox.letters.push_back({id, std::move(factory)});
+}
+
+void ShardedWorld::Step() {
+    tickBarrier_.arrive_and_wait();
+    tickBarrier_.arrive_and_wait();
+    tickBarrier_.arrive_and_wait();
+    ++tick_;
+    for (auto& shard: shards_) {
+        for (const auto& [id, target]: shard.moved) owners_[id] = target;
+        migrations_ += shard.moved.size();
+        shard.moved.clear();
+    }
+    for (auto& shard: shards_) {
+        if (shard.error) std::rethrow_exception(std::exchange(shard.error, nullptr));
+    }
+}
+
+void ShardedWorld::TakeArrivals(Shard& shard, Inbox& inbox) {
+    for (auto& arrival: inbox.arrivals) {
+        // allocated on the shard's node
+        auto entity = std::make_unique<ShardEntity>(arrival.id);
+        for (std::size_t prop = 0; prop < schema_.size(); ++prop) {
+            entity->ship.setProperty(schema_[prop].first, arrival.values[prop]);
+        }
+        shard.entities.emplace(arrival.id, std::move(entity));
+    }
+    inbox.arrivals.clear();
+}
+
+void ShardedWorld::KeepError(Shard& shard, std::exception_ptr error) noexcept {
+    // Step reports the first one
+    if (!shard.error) shard.error = std::move(error);
+}
+
+void ShardedWorld::RunTick(Shard& shard) {
+    // nobody else touches the inbox of the running tick
+    auto& inbox = shard.inboxes[tick_ % 2];
+    // added since the previous tick
+    TakeArrivals(shard, inbox);
+
+    // out of the inbox first, it is filled again two ticks later whatever happens here
+    shard.letters.swap(inbox.letters);
+    inbox.letters.clear();
+    for (auto& letter: shard.letters) {
+        const auto entity = shard.entities.find(letter.id);
+        if (std::end(shard.entities) == entity) {
+            // the entity left in the previous tick, the owners are up to date
+            Send(letter.id, std::move(letter.factory));
+            continue;
+        }
+        try {
+            shard.queue.Push(letter.factory(*entity->second));
+        } catch (...) {
+            KeepError(shard, std::current_exception());
+        }
+    }
+    shard.letters.clear();
+
+    // a command that throws past cmd_loop::run is dropped, the rest of the queue still runs
+    for (;;) {
+        try {
+            exceptions::cmd_loop::run(shard.queue);
+            break;
+        } catch (...) {
+            KeepError(shard, std::current_exception());
+            shard.queue.Pop();
+        }
+    }
+
+    std::vector<EntityId> leaving;
+    for (auto& [id, entity]: shard.entities) {
+        game::Move{&entity->moving}.Execute();
+        game::Rotate{&entity->rotating}.Execute();
+        if (Owner(entity->moving.getLocation()) != shard.index) leaving.push_back(id);
+    }
+
+    for (const auto id: leaving) {
+        const auto entity = shard.entities.extract(id);
+        const auto& ship = entity.mapped()->ship;
+        Arrival arrival{id, {}};
+        for (const auto& [key, initial]: schema_) arrival.values.push_back(ship.getProperty(key));
+
+        const auto target = Owner(entity.mapped()->moving.getLocation());
+        shard.moved.emplace_back(id, target);
+        auto& next = NextInbox(target);
+        std::lock_guard lock{next.mtx};
+        next.arrivals.push_back(std::move(arrival));
+    }
+}
+
+const game::IEntity& ShardedWorld::Get(EntityId id) const {
+    const auto& entities = shards_[ShardOf(id)].entities;
+    const auto entity = entities.find(id);
+    if (std::end(entities) == entity) {
+        throw std::out_of_range(std::format("Entity {} has not arrived at its shard yet", id));
+    }
+    return entity->second->ship;
+}
+
+} // namespace simulation
@@ -0,0 +1,83 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace simulation {
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    const auto workers = std::max<std::size_t>(threads, 1) - 1;
+    workers_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        // chunk 0 belongs to the calling thread
+        workers_.emplace_back([this, chunk = i + 1] { WorkerLoop(chunk); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mtx_};
+        stop_ = true;
+    }
+    startCv_.notify_all();
+    for (auto& worker: workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::RunChunks(ChunkTask task) {
+    if (workers_.empty()) {
+        task(0);
+        return;
+    }
+
+    {
+        std::lock_guard lock{mtx_};
+        task_ = std::move(task);
+        pending_ = workers_.size();
+        error_ = nullptr;
+        ++generation_;
+    }
+    startCv_.notify_all();
+
+    std::exception_ptr callerError;
+    try {
+        task_(0);
+    } catch (...) {
+        callerError = std::current_exception();
+    }
+
+    std::unique_lock lock{mtx_};
+    doneCv_.wait(lock, [this] { return 0 == pending_; });
+    task_ = nullptr;
+
+    if (callerError) std::rethrow_exception(callerError);
+    if (error_) std::rethrow_exception(error_);
+}
+
+void ThreadPool::WorkerLoop(std::size_t chunk) {
+    std::size_t seenGeneration{0};
+    while (true) {
+        {
+            std::unique_lock lock{mtx_};
+            startCv_.wait(lock, [&] { return stop_ || generation_ != seenGeneration; });
+            if (stop_) return;
+            seenGeneration = generation_;
+        }
+
+        std::exception_ptr error;
+        try {
+            task_(chunk);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard lock{mtx_};
+            if (error && !error_) error_ = error;
+            --pending_;
+        }
+        doneCv_.notify_one();
+    }
+}
+
+} // namespace simulation
@@ -0,0 +1,144 @@
+#include "versioned_world.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+namespace simulation {
+
+VersionedWorld::VersionedWorld(std::size_t capacity, EntitySchema schema)
+: schema_{std::move(schema)}
+, capacity_{capacity}
+, heads_{std::make_unique<std::atomic<Version*>[]>(capacity)} {}
+
+VersionedWorld::~VersionedWorld() {
+    for (std::size_t id = 0; id < Size(); ++id) {
+        for (auto* version = heads_[id].load(std::memory_order_relaxed); version != nullptr;) {
+            delete std::exchange(version, version->older);
+        }
+    }
+}
+
+EntityId VersionedWorld::Add() {
+    const auto id = Size();
+    if (id == capacity_) {
+        throw std::length_error(std::format("VersionedWorld is full, capacity: {}", capacity_));
+    }
+
+    // epoch 0 makes the initial values visible to every snapshot that can see the entity
+    auto* initial = new Version{0, nullptr, {}};
+    for (const auto& [name, value]: schema_) initial->values.push_back(value);
+    heads_[id].store(initial, std::memory_order_relaxed);
+    writers_.emplace_back(*this, id);
+    size_.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+std::size_t VersionedWorld::Index(std::string_view key, const char* action) const {
+    if (const auto prop = PropertyIndex(schema_, key); noProperty != prop) return prop;
+    throw std::logic_error(std::format("Unable to {} '{}' property in VersionedWorld entity", action, key));
+}
+
+std::string VersionedWorld::Writer::getProperty(std::string_view key) const {
+    return world_.heads_[id_].load(std::memory_order_relaxed)->values[world_.Index(key, "find")];
+}
+
+void VersionedWorld::Writer::setProperty(std::string_view key, std::string_view val) {
+    const auto prop = world_.Index(key, "set");
+    auto& head = world_.heads_[id_];
+    auto* latest = head.load(std::memory_order_relaxed);
+    // no snapshot can see the current epoch yet, its version may change in place
+    if (latest->epoch == world_.writeEpoch_) {
+        latest->values[prop] = val;
+        return;
+    }
+
+    auto* next = new Version{world_.writeEpoch_, latest, latest->values};
+    next->values[prop] = val;
+    head.store(next, std::memory_order_release);
+    if (latest->older == nullptr) world_.versioned_.push_back(id_);
+    ++world_.retained_;
+}
+
+std::uint64_t VersionedWorld::Commit() {
+    const auto epoch = writeEpoch_++;
+    committed_.store(epoch, std::memory_order_seq_cst);
+    Reclaim();
+    return epoch;
+}
+
+std::uint64_t VersionedWorld::OldestPinned() const noexcept {
+    auto oldest = committed_.load(std::memory_order_seq_cst);
+    for (const auto& slot: readers_) {
+        oldest = std::min(oldest, slot.epoch.load(std::memory_order_seq_cst));
+    }
+    return oldest;
+}
+
+void VersionedWorld::Reclaim() {
+    const auto oldest = OldestPinned();
+    // a reader stops at the first version not newer than its epoch, for every pinned
+    // epoch that version is at or above the cut, so everything below the cut is unreachable
+    std::erase_if(versioned_, [this, oldest](EntityId id) {
+        auto* cut = heads_[id].load(std::memory_order_relaxed);
+        // a slot that is still being claimed reads as epoch 0, older versions may be gone already
+        while (cut->epoch > oldest && cut->older != nullptr) cut = cut->older;
+        for (auto* version = std::exchange(cut->older, nullptr); version != nullptr; --retained_) {
+            delete std::exchange(version, version->older);
+        }
+        return cut == heads_[id].load(std::memory_order_relaxed);
+    });
+}
+
+VersionedWorld::Snapshot VersionedWorld::TakeSnapshot() const {
+    for (auto& slot: readers_) {
+        // a claimed slot holds epoch 0 until the real one is known, which keeps everything alive
+        auto expected = idle;
+        if (!slot.epoch.compare_exchange_strong(expected, 0, std::memory_order_seq_cst)) continue;
+
+        // Reclaim() either sees the pinned epoch or has committed a newer one, then pin again
+        auto epoch = committed_.load(std::memory_order_seq_cst);
+        for (;;) {
+            slot.epoch.store(epoch, std::memory_order_seq_cst);
+            const auto again = committed_.load(std::memory_order_seq_cst);
+            if (again == epoch) break;
+            epoch = again;
+        }
+        return Snapshot{*this, slot, epoch, Size()};
+    }
+    throw std::runtime_error(std::format("VersionedWorld supports at most {} snapshots at a time", maxReaders));
+}
+
+const VersionedWorld::Version* VersionedWorld::Visible(EntityId id, std::uint64_t epoch) const {
+    const auto* version = heads_[id].load(std::memory_order_acquire);
+    while (version->epoch > epoch) version = version->older;
+    return version;
+}
+
+VersionedWorld::Snapshot::Snapshot(Snapshot&& other) noexcept
+: world_{other.world_}
+, slot_{std::exchange(other.slot_, nullptr)}
+, epoch_{other.epoch_}
+, size_{other.size_} {}
+
+VersionedWorld::Snapshot::~Snapshot() {
+    if (slot_ != nullptr) slot_->epoch.store(idle, std::memory_order_release);
+}
+
+std::string_view VersionedWorld::Snapshot::View(EntityId id, std::string_view key) const {
+    if (id >= size_) {
+        throw std::out_of_range(std::format("No entity {} in a snapshot of {} entities", id, size_));
+    }
+    return world_->Visible(id, epoch_)->values[world_->Index(key, "find")];
+}
+
+std::string VersionedWorld::Snapshot::Get(EntityId id, std::string_view key) const {
+    return std::string{View(id, key)};
+}
+
+void VersionedWorld::Snapshot::Entity::setProperty(std::string_view key, std::string_view) {
+    throw std::logic_error(std::format("Unable to set '{}' property in a VersionedWorld snapshot", key));
+}
+
+} // namespace simulation
@@ -0,0 +1,374 @@
+#include "write_ahead_log.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace simulation {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char checkpointMagic[8] = {'W', 'A', 'L', 'C', 'K', 'P', 'T', '1'};
+constexpr std::string_view checkpointName{"checkpoint.bin"};
+
+struct GroupHeader {
+    std::uint64_t firstLsn;
+    std::uint32_t records;
+    std::uint32_t bytes;
+    std::uint64_t checksum;
+};
+
+// FNV-1a over the header fields and the payload
+std::uint64_t Checksum(std::uint64_t firstLsn, std::uint32_t records, std::span<const std::uint8_t> payload) {
+    std::uint64_t hash{14695981039346656037ull};
+    auto mix = [&hash](std::uint8_t byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for (int shift = 0; shift < 64; shift += 8) mix(static_cast<std::uint8_t>(firstLsn >> shift));
+    for (int shift = 0; shift < 32; shift += 8) mix(static_cast<std::uint8_t>(records >> shift));
+    for (const auto byte: payload) mix(byte);
+    return hash;
+}
+
+[[noreturn]] void ThrowErrno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void WriteAll(int fd, std::span<const std::uint8_t> data) {
+    while (!data.empty()) {
+        const auto written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (EINTR == errno) continue;
+            ThrowErrno("Unable to write the log");
+        }
+        data = data.subspan(static_cast<std::size_t>(written));
+    }
+}
+
+void SyncDir(const fs::path& dir) {
+    const auto fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) ThrowErrno("Unable to open " + dir.string());
+    ::fsync(fd);
+    ::close(fd);
+}
+
+fs::path SegmentPath(const fs::path& dir, std::uint64_t firstLsn) {
+    return dir / std::format("wal-{:020}.log", firstLsn);
+}
+
+// segments sorted by their first LSN
+std::vector<std::pair<std::uint64_t, fs::path>> Segments(const fs::path& dir) {
+    std::vector<std::pair<std::uint64_t, fs::path>> segments;
+    for (const auto& entry: fs::directory_iterator{dir}) {
+        const auto name = entry.path().filename().string();
+        if (!name.starts_with("wal-") || !name.ends_with(".log")) continue;
+        segments.emplace_back(std::stoull(name.substr(4, name.size() - 8)), entry.path());
+    }
+    std::ranges::sort(segments);
+    return segments;
+}
+
+class MappedFile {
+public:
+    explicit MappedFile(const fs::path& path) {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) ThrowErrno("Unable to open " + path.string());
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            ThrowErrno("Unable to stat " + path.string());
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (0 == size_) return;
+
+        auto* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (MAP_FAILED == mapped) {
+            ::close(fd_);
+            ThrowErrno("Unable to map " + path.string());
+        }
+        data_ = static_cast<const std::uint8_t*>(mapped);
+        ::madvise(mapped, size_, MADV_SEQUENTIAL);
+    }
+
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+        ::close(fd_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::uint8_t> Data() const noexcept { return {data_, size_}; }
+
+private:
+    int fd_{-1};
+    const std::uint8_t* data_{nullptr};
+    std::size_t size_{0};
+};
+
+// checks the magic, returns the LSN the checkpoint covers
+std::uint64_t ReadCheckpointLsn(command::BinaryReader& in, const fs::path& path) {
+    for (const auto byte: checkpointMagic) {
+        if (in.ReadByte() != static_cast<std::uint8_t>(byte)) {
+            throw std::invalid_argument("Not a checkpoint: " + path.string());
+        }
+    }
+    return in.ReadVarint();
+}
+
+struct Record {
+    EntityId id;
+    std::size_t prop;
+    std::string_view value;
+};
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(fs::path dir, std::uint64_t nextLsn, WalConfig config, EntitySchema schema)
+: dir_{std::move(dir)}
+, config_{config}
+, schema_{std::move(schema)}
+, pendingFirst_{nextLsn}
+, nextLsn_{nextLsn}
+, durableLsn_{nextLsn} {
+    fs::create_directories(dir_);
+    // new records would reuse LSNs that Recover() skips as part of the checkpoint
+    if (const auto path = dir_ / checkpointName; fs::exists(path)) {
+        const MappedFile file{path};
+        command::BinaryReader in{file.Data()};
+        if (const auto lsn = ReadCheckpointLsn(in, path); lsn > nextLsn) {
+            throw std::invalid_argument(std::format("Log continues at LSN {} behind its checkpoint at LSN {}", nextLsn, lsn));
+        }
+    }
+    // segments from here on are left over behind a torn group, their LSNs are reused
+    for (const auto& [first, path]: Segments(dir_)) {
+        if (first >= nextLsn) fs::remove(path);
+    }
+    OpenSegment(nextLsn);
+    flusher_ = std::jthread{[this](std::stop_token stop) { FlushLoop(stop); }};
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    flusher_.request_stop();
+    flusher_.join();
+    ::close(fd_);
+}
+
+std::size_t WriteAheadLog::Property(std::string_view key) const {
+    if (const auto prop = PropertyIndex(schema_, key); noProperty != prop) return prop;
+    throw std::logic_error(std::format("Unable to log '{}' property in WriteAheadLog", key));
+}
+
+std::uint64_t WriteAheadLog::Append(EntityId id, std::size_t prop, std::string_view value) {
+    std::lock_guard lock{mtx_};
+    ThrowIfFailed();
+    pending_.WriteVarint(id);
+    pending_.WriteByte(static_cast<std::uint8_t>(prop));
+    pending_.WriteString(value);
+    if (pending_.Data().size() >= config_.flushBytes) flushCv_.notify_one();
+    return nextLsn_++;
+}
+
+void WriteAheadLog::WaitDurable(std::uint64_t lsn) {
+    std::unique_lock lock{mtx_};
+    if (lsn >= nextLsn_) {
+        throw std::out_of_range(std::format("Unable to wait for LSN {}, the next one is {}", lsn, nextLsn_));
+    }
+    if (durableLsn_ <= lsn) {
+        flushRequested_ = true;
+        flushCv_.notify_one();
+    }
+    durableCv_.wait(lock, [this, lsn] { return durableLsn_ > lsn || error_; });
+    ThrowIfFailed();
+}
+
+void WriteAheadLog::Flush() {
+    std::uint64_t last;
+    {
+        std::lock_guard lock{mtx_};
+        if (nextLsn_ == durableLsn_) return;
+        last = nextLsn_ - 1;
+    }
+    WaitDurable(last);
+}
+
+std::uint64_t WriteAheadLog::NextLsn() const {
+    std::lock_guard lock{mtx_};
+    return nextLsn_;
+}
+
+std::uint64_t WriteAheadLog::DurableLsn() const {
+    std::lock_guard lock{mtx_};
+    return durableLsn_;
+}
+
+void WriteAheadLog::ThrowIfFailed() const {
+    if (error_) std::rethrow_exception(error_);
+}
+
+void WriteAheadLog::FlushLoop(std::stop_token stop) {
+    command::BinaryWriter writing;
+    std::unique_lock lock{mtx_};
+    for (;;) {
+        flushCv_.wait_for(lock, stop, config_.flushInterval, [this] {
+            return flushRequested_ || pending_.Data().size() >= config_.flushBytes;
+        });
+        flushRequested_ = false;
+
+        if (nextLsn_ != pendingFirst_ && !error_) {
+            // appends go on into the other buffer while the group is written
+            std::swap(pending_, writing);
+            const auto first = std::exchange(pendingFirst_, nextLsn_);
+            const auto records = nextLsn_ - first;
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                WriteGroup(first, records, writing.Data());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            writing.Clear();
+            lock.lock();
+            if (error) error_ = error;
+            else durableLsn_ = first + records;
+            durableCv_.notify_all();
+        }
+        if (stop.stop_requested() && (nextLsn_ == pendingFirst_ || error_)) return;
+    }
+}
+
+void WriteAheadLog::WriteGroup(std::uint64_t firstLsn, std::uint64_t records, std::span<const std::uint8_t> payload) {
+    const GroupHeader header{
+        .firstLsn = firstLsn,
+        .records = static_cast<std::uint32_t>(records),
+        .bytes = static_cast<std::uint32_t>(payload.size()),
+        .checksum = Checksum(firstLsn, static_cast<std::uint32_t>(records), payload),
+    };
+
+    std::lock_guard lock{fileMtx_};
+    WriteAll(fd_, std::span{reinterpret_cast<const std::uint8_t*>(&header), sizeof(header)});
+    WriteAll(fd_, payload);
+    if (config_.sync && ::fdatasync(fd_) != 0) ThrowErrno("Unable to sync the log");
+    groups_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WriteAheadLog::OpenSegment(std::uint64_t firstLsn) {
+    const auto path = SegmentPath(dir_, firstLsn);
+    const auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) ThrowErrno("Unable to create " + path.string());
+    SyncDir(dir_);
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = fd;
+}
+
+void WriteAheadLog::Checkpoint(const EntityStore& store) {
+    Flush();
+    const auto lsn = NextLsn();
+    {
+        std::lock_guard lock{fileMtx_};
+        OpenSegment(lsn);
+    }
+
+    command::BinaryWriter out;
+    for (const auto byte: checkpointMagic) out.WriteByte(static_cast<std::uint8_t>(byte));
+    out.WriteVarint(lsn);
+    out.WriteVarint(store.Size());
+    for (EntityId id = 0; id < store.Size(); ++id) {
+        const auto& entity = store.Get(id);
+        for (const auto& [key, initial]: schema_) out.WriteString(entity.getProperty(key));
+    }
+
+    // the old checkpoint stays valid until the new one replaces it
+    const auto tmp = dir_ / "checkpoint.tmp";
+    const auto fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) ThrowErrno("Unable to create " + tmp.string());
+    try {
+        WriteAll(fd, out.Data());
+        if (::fsync(fd) != 0) ThrowErrno("Unable to sync " + tmp.string());
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    fs::rename(tmp, dir_ / checkpointName);
+    SyncDir(dir_);
+
+    for (const auto& [first, path]: Segments(dir_)) {
+        if (first < lsn) fs::remove(path);
+    }
+}
+
+std::uint64_t WriteAheadLog::Recover(const fs::path& dir, EntityStore& store, ThreadPool& pool, const EntitySchema& schema) {
+    std::uint64_t lsn{0};
+    if (const auto path = dir / checkpointName; fs::exists(path)) {
+        const MappedFile file{path};
+        command::BinaryReader in{file.Data()};
+        lsn = ReadCheckpointLsn(in, path);
+        const auto size = in.ReadVarint();
+        while (store.Size() < size) store.Add();
+        for (EntityId id = 0; id < size; ++id) {
+            auto& entity = store.Get(id);
+            for (const auto& [key, initial]: schema) entity.setProperty(key, in.ReadString());
+        }
+    }
+
+    // the records stay in the mapped segments, every thread applies the ones of its entities in log order
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<std::vector<Record>> shards(pool.Size());
+    for (const auto& [first, path]: Segments(dir)) {
+        // a gap in the LSNs, the rest of the log is unreachable
+        if (first > lsn) break;
+        const auto& file = *files.emplace_back(std::make_unique<MappedFile>(path));
+        auto data = file.Data();
+        while (data.size() >= sizeof(GroupHeader)) {
+            GroupHeader header;
+            std::memcpy(&header, data.data(), sizeof(header));
+            const auto payload = data.subspan(sizeof(header)).first(std::min<std::size_t>(header.bytes, data.size() - sizeof(header)));
+            if (payload.size() != header.bytes || header.firstLsn > lsn
+                || header.checksum != Checksum(header.firstLsn, header.records, payload)) {
+                break;
+            }
+            data = data.subspan(sizeof(header) + header.bytes);
+            // already in the checkpoint
+            if (header.firstLsn + header.records <= lsn) continue;
+
+            command::BinaryReader in{payload};
+            for (std::uint32_t i = 0; i < header.records; ++i) {
+                const auto id = static_cast<EntityId>(in.ReadVarint());
+                const auto prop = static_cast<std::size_t>(in.ReadByte());
+                const auto value = in.ReadString();
+                if (prop >= schema.size() && createProp != prop) throw std::invalid_argument(std::format("Unknown property {} in the log", prop));
+                // records before the checkpoint LSN are in it already
+                if (header.firstLsn + i < lsn) continue;
+                while (store.Size() <= id) store.Add();
+                if (createProp != prop) shards[id % shards.size()].push_back({id, prop, value});
+            }
+            lsn = header.firstLsn + header.records;
+        }
+    }
+
+    pool.ParallelFor(shards.size(), [&](std::size_t begin, std::size_t end) {
+        for (auto shard = begin; shard < end; ++shard) {
+            for (const auto& record: shards[shard]) {
+                store.Get(record.id).setProperty(schema[record.prop].first, record.value);
+            }
+        }
+    });
+    return lsn;
+}
+
+} // namespace simulation
@@ -0,0 +1,862 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <command_codec.hpp>
+#include <delta_encoder.hpp>
+#include <double_buffered_world.hpp>
+#include <loop_command.hpp>
+#include <parallel_executor.hpp>
+#include <queue_impl.hpp>
+#include <rollback_world.hpp>
+#include <scheduler.hpp>
+#include <sharded_world.hpp>
+#include <thread_pool.hpp>
+#include <tracer.hpp>
+#include <versioned_world.hpp>
+#include <write_ahead_log.hpp>
+
+using namespace simulation;
+
+namespace test {
+
+class SetVelocity : public exceptions::ICommand {
+public:
+    SetVelocity(game::IEntity& entity, game::Vector velocity)
+    : entity_{entity}
+    , velocity_{velocity} {}
+
+    void Execute() const override {
+        entity_.setProperty("velocity", velocity_.toString());
+    }
+
+    exceptions::ICommandUPtr Clone() const override {
+        return std::make_unique<SetVelocity>(*this);
+    }
+
+private:
+    game::IEntity& entity_;
+    game::Vector velocity_;
+};
+
+template<typename TStore>
+std::vector<std::string> Snapshot(const TStore& store) {
+    std::vector<std::string> res;
+    for (EntityId id = 0; id < store.Size(); ++id) {
+        const auto& ship = store.Get(id);
+        res.push_back(ship.getProperty("location") + ";" + ship.getProperty("angle"));
+    }
+    return res;
+}
+
+std::vector<std::string> Simulate(std::size_t threads, bool doubleBuffered = false) {
+    Scheduler scheduler{SchedulerConfig{.threads = threads, .realtime = false, .doubleBuffered = doubleBuffered}};
+    const auto entity = [doubleBuffered](Scheduler& s, EntityId id) -> game::IEntity& {
+        if (doubleBuffered) return s.World().Get(id);
+        return s.Entities().Get(id);
+    };
+    for (int i = 0; i < 1000; ++i) {
+        const auto id = doubleBuffered ? scheduler.World().Add() : scheduler.Entities().Add();
+        entity(scheduler, id).setProperty("angular_velocity", game::Angle{.rad = 0.01 * i}.toString());
+    }
+    // the initial writes become visible with the first swap, publish them before tick 0
+    if (doubleBuffered) {
+        ThreadPool pool{1};
+        scheduler.World().Swap(pool);
+    }
+
+    scheduler.OnInput([entity](Scheduler& s) {
+        // every tick steers a different subset of ships
+        const auto tick = static_cast<int>(s.CurrentTick());
+        for (EntityId id = tick % 7; id < 1000; id += 7) {
+            const auto vx = static_cast<int>(id % 5) - 2;
+            s.Queue().Push(std::make_unique<SetVelocity>(entity(s, id), game::Vector{vx, tick % 3}));
+        }
+    });
+    scheduler.Run(50);
+    return doubleBuffered ? Snapshot(scheduler.World()) : Snapshot(scheduler.Entities());
+}
+
+}  // namespace test
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+    ThreadPool pool{4};
+    for (std::size_t count: {0u, 1u, 3u, 4u, 1001u}) {
+        std::vector<std::atomic<int>> visits(count);
+        pool.ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) ++visits[i];
+        });
+        for (const auto& v: visits) EXPECT_EQ(1, v.load());
+    }
+}
+
+TEST(ThreadPoolTest, ParallelForRethrows) {
+    ThreadPool pool{3};
+    EXPECT_THROW(
+        pool.ParallelFor(3, [](std::size_t begin, std::size_t) {
+            if (2 == begin) throw std::runtime_error("chunk failed");
+        }),
+        std::runtime_error
+    );
+
+    // the pool is still usable afterwards
+    std::atomic<int> counter{0};
+    pool.ParallelFor(3, [&](std::size_t, std::size_t) { ++counter; });
+    EXPECT_EQ(3, counter.load());
+}
+
+TEST(SchedulerTest, PhasesRunInOrder) {
+    Scheduler scheduler{SchedulerConfig{.realtime = false}};
+    const auto id = scheduler.Entities().Add();
+    scheduler.Entities().Get(id).setProperty("location", game::Point{1, 1}.toString());
+
+    std::vector<std::string> trace;
+    scheduler.OnInput([&](Scheduler& s) {
+        trace.push_back("input");
+        s.Queue().Push(std::make_unique<test::SetVelocity>(s.Entities().Get(id), game::Vector{2, 3}));
+    });
+    scheduler.OnPost([&](Scheduler& s) {
+        // commands ran before physics, so the new velocity is already applied
+        trace.push_back("post " + s.Entities().Get(id).getProperty("location"));
+    });
+
+    scheduler.Step();
+
+    EXPECT_EQ(trace, (std::vector<std::string>{"input", "post 3,4"}));
+    EXPECT_EQ(1, scheduler.CurrentTick());
+    EXPECT_TRUE(scheduler.Queue().IsEmpty());
+    for (auto phase: {Phase::Input, Phase::Commands, Phase::Physics, Phase::Post}) {
+        EXPECT_EQ(1, scheduler.PhaseLatency(phase).Count());
+    }
+}
+
+TEST(SchedulerTest, CommandBudgetDefersToNextTick) {
+    Scheduler scheduler{SchedulerConfig{.maxCommandsPerTick = 2, .realtime = false}};
+    const auto id = scheduler.Entities().Add();
+    for (int i = 0; i < 5; ++i) {
+        scheduler.Queue().Push(std::make_unique<test::SetVelocity>(scheduler.Entities().Get(id), game::Vector{i, 0}));
+    }
+
+    scheduler.Step();
+    EXPECT_EQ(3, scheduler.Queue().Size());
+    scheduler.Step();
+    scheduler.Step();
+    EXPECT_TRUE(scheduler.Queue().IsEmpty());
+    EXPECT_EQ("4,0", scheduler.Entities().Get(id).getProperty("velocity"));
+}
+
+TEST(SchedulerTest, DeterministicAcrossThreadCounts) {
+    const auto reference = test::Simulate(1);
+    EXPECT_EQ(reference, test::Simulate(2));
+    EXPECT_EQ(reference, test::Simulate(8));
+}
+
+TEST(SchedulerTest, DoubleBufferedMatchesSingleBuffer) {
+    const auto reference = test::Simulate(1);
+    EXPECT_EQ(reference, test::Simulate(1, true));
+    EXPECT_EQ(reference, test::Simulate(4, true));
+}
+
+TEST(DoubleBufferedWorldTest, WritesShowAfterSwap) {
+    DoubleBufferedWorld world;
+    ThreadPool pool{2};
+    for (std::size_t i = 0; i < 3 * DoubleBufferedWorld::pageEntities; ++i) world.Add();
+    // new entities start out the same in both buffers
+    world.Swap(pool);
+    EXPECT_EQ(0, world.CopiedPages());
+
+    const auto last = world.Size() - 1;
+    game::MovingObjectAdapter moa{&world.Get(last)};
+    world.Get(last).setProperty("velocity", game::Vector{1, 2}.toString());
+    EXPECT_EQ(game::Vector{}.toString(), moa.getVelocity().toString());
+    world.Swap(pool);
+    EXPECT_EQ(1, world.CopiedPages());
+
+    // both moves read the location of the previous swap
+    game::Move{&moa}.Execute();
+    game::Move{&moa}.Execute();
+    EXPECT_EQ(game::Point(0, 0), moa.getLocation());
+    world.Swap(pool);
+    EXPECT_EQ(game::Point(1, 2), moa.getLocation());
+
+    // the page copy keeps the back buffer in step, an untouched property survives later swaps
+    game::RotatingObjectAdapter roa{&world.Get(last)};
+    roa.setAngle(game::Angle{.rad = 1.});
+    world.Swap(pool);
+    world.Swap(pool);
+    EXPECT_EQ(0, world.CopiedPages());
+    EXPECT_EQ(game::Point(1, 2), moa.getLocation());
+    EXPECT_EQ(game::Angle{.rad = 1.}.toString(), roa.getAngle().toString());
+
+    EXPECT_THROW(world.Get(0).getProperty("fuel"), std::logic_error);
+}
+
+TEST(VersionedWorldTest, SnapshotKeepsItsEpoch) {
+    VersionedWorld world{16};
+    const auto id = world.Add();
+    game::MovingObjectAdapter moa{&world.Get(id)};
+    moa.setLocation(game::Point{1, 1});
+    // in place, the epoch is not committed yet
+    moa.setLocation(game::Point{2, 2});
+    EXPECT_EQ(game::Point(2, 2), moa.getLocation());
+    EXPECT_EQ(1, world.Commit());
+
+    {
+        const auto pinned = world.TakeSnapshot();
+        moa.setLocation(game::Point{3, 3});
+        world.Commit();
+        moa.setLocation(game::Point{4, 4});
+        world.Commit();
+
+        auto entity = pinned[id];
+        game::MovingObjectAdapter old{&entity};
+        EXPECT_EQ(game::Point(2, 2), old.getLocation());
+        EXPECT_EQ(game::Point(4, 4).toString(), world.TakeSnapshot().Get(id, "location"));
+        EXPECT_THROW(old.setLocation(game::Point{0, 0}), std::logic_error);
+        EXPECT_EQ(2, world.RetainedVersions());
+    }
+    world.Commit();
+    EXPECT_EQ(0, world.RetainedVersions());
+    EXPECT_THROW(world.TakeSnapshot().Get(id + 1, "location"), std::out_of_range);
+}
+
+TEST(VersionedWorldTest, ReadersSeeWholeEpochs) {
+    constexpr std::size_t ships{200};
+    VersionedWorld world{ships};
+    for (std::size_t i = 0; i < ships; ++i) world.Add();
+
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::vector<std::jthread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                // the writer sets every ship to the same values within an epoch
+                const auto snapshot = world.TakeSnapshot();
+                const auto expected = snapshot.Get(0, "location");
+                for (EntityId id = 0; id < snapshot.Size(); ++id) {
+                    if (snapshot.View(id, "location") != expected || snapshot.View(id, "velocity") != expected) ++torn;
+                }
+            }
+        });
+    }
+
+    for (int epoch = 1; epoch <= 300; ++epoch) {
+        const auto value = game::Point{epoch, epoch}.toString();
+        for (EntityId id = 0; id < ships; ++id) {
+            world.Get(id).setProperty("location", value);
+            world.Get(id).setProperty("velocity", value);
+        }
+        world.Commit();
+    }
+    done = true;
+    readers.clear();
+
+    EXPECT_EQ(0, torn.load());
+    world.Commit();
+    EXPECT_EQ(0, world.RetainedVersions());
+}
+
+TEST(SchedulerTest, RealtimeRunKeepsTimestep) {
+    using namespace std::chrono_literals;
+    Scheduler scheduler{SchedulerConfig{.timestep = 2ms}};
+
+    const auto start = std::chrono::steady_clock::now();
+    scheduler.Run(10);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_GE(elapsed, 20ms);
+    EXPECT_EQ(20ms, scheduler.SimulationTime());
+}
+
+namespace test {
+
+// one adapter of each kind per ship, as the executor compares command targets by address
+struct Fleet {
+    explicit Fleet(EntityStore& store) {
+        for (EntityId id = 0; id < store.Size(); ++id) {
+            moving.emplace_back(&store.Get(id));
+            rotating.emplace_back(&store.Get(id));
+        }
+    }
+
+    std::deque<game::MovingObjectAdapter> moving;
+    std::deque<game::RotatingObjectAdapter> rotating;
+};
+
+class NoFuel : public command::IFuelConsumingObject {
+public:
+    bool CheckFuel() const override { return false; }
+    void BurnFuel() override {}
+    bool TryBurn(std::uint32_t) override { return false; }
+    void Refund(std::uint32_t) override {}
+};
+
+class CountFailures : public exceptions::ICommand {
+public:
+    CountFailures(std::atomic<int>& counter, std::thread::id& thread) : counter_{counter}, thread_{thread} {}
+    void Execute() const override {
+        ++counter_;
+        thread_ = std::this_thread::get_id();
+    }
+    exceptions::ICommandUPtr Clone() const override { return std::make_unique<CountFailures>(*this); }
+private:
+    std::atomic<int>& counter_;
+    std::thread::id& thread_;
+};
+
+std::vector<std::string> SimulateCommands(std::size_t threads, bool parallel) {
+    Scheduler scheduler{SchedulerConfig{.threads = threads, .realtime = false, .parallelCommands = parallel}};
+    for (int i = 0; i < 300; ++i) {
+        const auto id = scheduler.Entities().Add();
+        auto& ship = scheduler.Entities().Get(id);
+        ship.setProperty("velocity", game::Vector{i % 3, 1 - i % 2}.toString());
+        ship.setProperty("angular_velocity", game::Angle{.rad = 0.001 * i}.toString());
+    }
+    Fleet fleet{scheduler.Entities()};
+
+    scheduler.OnInput([&fleet](Scheduler& s) {
+        // dense conflicts on a few ships, sparse ones elsewhere, and commands without a declared set
+        const auto tick = s.CurrentTick();
+        for (std::size_t i = 0; i < 600; ++i) {
+            const auto id = (i * 7 + tick * 13) % (i % 4 == 0 ? 5 : s.Entities().Size());
+            switch ((i + tick) % 5) {
+            case 0: s.Queue().Push(command::MakeLoopCommand<command::Move>(&fleet.moving[id])); break;
+            case 1: s.Queue().Push(command::MakeLoopCommand<command::Rotate>(&fleet.rotating[id])); break;
+            case 2: s.Queue().Push(command::MakeLoopCommand<command::ChangeVelocity>(&fleet.rotating[id], &fleet.moving[id])); break;
+            case 3: s.Queue().Push(command::MakeLoopCommand<command::Move>(&fleet.moving[(id + 1) % s.Entities().Size()])); break;
+            default:
+                if (i % 50 == 4) {
+                    s.Queue().Push(std::make_unique<SetVelocity>(s.Entities().Get(id), game::Vector{-1, static_cast<int>(tick % 3)}));
+                }
+            }
+        }
+    });
+    scheduler.Run(20);
+    if (parallel && threads > 1) {
+        EXPECT_LT(scheduler.Executor().Levels(), scheduler.Executor().Commands());
+    }
+    return Snapshot(scheduler.Entities());
+}
+
+}  // namespace test
+
+TEST(ParallelExecutorTest, LevelsFollowConflicts) {
+    EntityStore store;
+    const auto a = store.Add();
+    const auto b = store.Add();
+    store.Get(a).setProperty("velocity", game::Vector{1, 0}.toString());
+    store.Get(b).setProperty("velocity", game::Vector{0, 1}.toString());
+    test::Fleet fleet{store};
+
+    exceptions::QueueImpl q;
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[a]));           // level 0
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[b]));           // level 0
+    q.Push(command::MakeLoopCommand<command::Rotate>(&fleet.rotating[a]));       // level 0, other properties
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[a]));           // level 1
+    q.Push(command::MakeLoopCommand<command::ChangeVelocity>(&fleet.rotating[a], &fleet.moving[a]));  // level 2
+    q.Push(std::make_unique<test::SetVelocity>(store.Get(b), game::Vector{5, 5}));  // unknown set, level 3
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[b]));           // next window
+
+    ThreadPool pool{4};
+    ParallelExecutor executor{pool, 1};
+    EXPECT_EQ(6, executor.Run(q, 6));
+    EXPECT_EQ(4, executor.Levels());
+    EXPECT_EQ(1, q.Size());
+    EXPECT_EQ(1, executor.Run(q, 10));
+    EXPECT_EQ(5, executor.Levels());
+    EXPECT_EQ(7, executor.Commands());
+    EXPECT_TRUE(q.IsEmpty());
+
+    EXPECT_EQ("3,0", store.Get(a).getProperty("location"));
+    EXPECT_EQ("5,6", store.Get(b).getProperty("location"));
+}
+
+TEST(ParallelExecutorTest, AdaptersOfOneEntityConflict) {
+    EntityStore store;
+    const auto a = store.Add();
+    store.Get(a).setProperty("velocity", game::Vector{1, 0}.toString());
+    test::Fleet fleet{store};
+    game::CachingAdapter cache{&store.Get(a)};
+    test::NoFuel noFuel;
+
+    exceptions::QueueImpl q;
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[a]));  // level 0
+    q.Push(command::MakeLoopCommand<command::Move>(&cache));            // level 1, same entity
+    q.Push(command::MakeLoopCommand<command::FlushCache>(&cache));      // level 2
+    q.Push(command::MakeLoopCommand<command::BurnFuel>(&noFuel));       // no access key, level 3
+
+    ThreadPool pool{4};
+    ParallelExecutor executor{pool, 1};
+    EXPECT_EQ(4, executor.Run(q, 10));
+    EXPECT_EQ(4, executor.Levels());
+    EXPECT_EQ("2,0", store.Get(a).getProperty("location"));
+}
+
+TEST(ParallelExecutorTest, LeavesCommandsThatDidNotRunInTheQueue) {
+    EntityStore store;
+    for (int i = 0; i < 3; ++i) store.Add();
+    store.Get(0).setProperty("velocity", game::Vector{1, 0}.toString());
+    store.Get(1).setProperty("velocity", "broken");
+    store.Get(2).setProperty("velocity", game::Vector{0, 1}.toString());
+    test::Fleet fleet{store};
+
+    exceptions::QueueImpl q;
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[0]));   // level 0
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[1]));   // level 0, throws std::invalid_argument
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[2]));   // level 0
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[0]));   // level 1
+    q.Push(command::MakeLoopCommand<command::Move>(&fleet.moving[2]));   // next window
+
+    ThreadPool pool{4};
+    ParallelExecutor executor{pool, 1};
+    EXPECT_THROW(executor.Run(q, 4), std::logic_error);
+    EXPECT_EQ("1,0", store.Get(0).getProperty("location"));
+    EXPECT_EQ("0,0", store.Get(1).getProperty("location"));
+    // the failing command, the next level and the next window stay, Move of ship 2 may have run
+    EXPECT_LE(3, q.Size());
+    EXPECT_GE(4, q.Size());
+
+    store.Get(1).setProperty("velocity", game::Vector{1, 1}.toString());
+    executor.Run(q, 10);
+    EXPECT_TRUE(q.IsEmpty());
+    EXPECT_EQ("2,0", store.Get(0).getProperty("location"));
+    EXPECT_EQ("1,1", store.Get(1).getProperty("location"));
+    EXPECT_EQ("0,2", store.Get(2).getProperty("location"));
+}
+
+TEST(ParallelExecutorTest, HandlersRunOnCallingThreadInOrder) {
+    std::atomic<int> failures{0};
+    std::thread::id handlerThread;
+    exceptions::ExceptionHandler::Register<command::LoopCommand<command::CheckFuel>, command::CommandException>(
+        std::make_unique<test::CountFailures>(failures, handlerThread));
+
+    EntityStore store;
+    store.Add();
+    test::Fleet fleet{store};
+    test::NoFuel noFuel;
+    exceptions::QueueImpl q;
+    for (int i = 0; i < 200; ++i) {
+        q.Push(command::MakeLoopCommand<command::CheckFuel>(&noFuel));
+        q.Push(command::MakeLoopCommand<command::Rotate>(&fleet.rotating[0]));
+    }
+
+    ThreadPool pool{4};
+    ParallelExecutor executor{pool, 1};
+    EXPECT_EQ(400, executor.Run(q, 1000));
+    EXPECT_EQ(200, failures.load());
+    EXPECT_EQ(std::this_thread::get_id(), handlerThread);
+}
+
+TEST(ParallelExecutorTest, TracesCommandsAndHandlers) {
+    std::atomic<int> failures{0};
+    std::thread::id handlerThread;
+    exceptions::ExceptionHandler::Register<command::LoopCommand<command::CheckFuel>, command::CommandException>(
+        std::make_unique<test::CountFailures>(failures, handlerThread));
+
+    EntityStore store;
+    for (int i = 0; i < 100; ++i) store.Add();
+    test::Fleet fleet{store};
+    test::NoFuel noFuel;
+    exceptions::QueueImpl q;
+    for (EntityId id = 0; id < store.Size(); ++id) {
+        q.Push(command::MakeLoopCommand<command::Rotate>(&fleet.rotating[id]));
+    }
+    for (int i = 0; i < 3; ++i) q.Push(command::MakeLoopCommand<command::CheckFuel>(&noFuel));
+
+    exceptions::trace::Reset();
+    exceptions::trace::Start();
+    ThreadPool pool{4};
+    ParallelExecutor executor{pool, 1};
+    EXPECT_EQ(103, executor.Run(q, 1000));
+    exceptions::trace::Stop();
+
+    const auto json = exceptions::trace::ToChromeJson();
+    auto count = [&json](std::string_view what) {
+        std::size_t res{0};
+        for (auto pos = json.find(what); std::string::npos != pos; pos = json.find(what, pos + 1)) ++res;
+        return res;
+    };
+    EXPECT_EQ(103, count(R"("cat":"command")"));
+    EXPECT_EQ(3, count(R"({"name":"command::CommandException","cat":"handler")"));
+    exceptions::trace::Reset();
+}
+
+TEST(SchedulerTest, ParallelCommandsMatchSerialOrder) {
+    const auto reference = test::SimulateCommands(1, false);
+    EXPECT_EQ(reference, test::SimulateCommands(4, true));
+    EXPECT_EQ(reference, test::SimulateCommands(8, true));
+}
+
+TEST(DeltaEncoderTest, ClientFollowsChangedShips) {
+    EntityStore store;
+    for (int i = 0; i < 1000; ++i) store.Add();
+    DeltaEncoder encoder;
+    DeltaDecoder client;
+
+    // nothing changed, only the terminator
+    EXPECT_EQ(1, encoder.Encode(store).size());
+
+    for (int tick = 1; tick <= 3; ++tick) {
+        for (EntityId id = tick; id < store.Size(); id += 100) {
+            auto& ship = store.Get(id);
+            ship.setProperty("location", game::Point{tick * -7, static_cast<int>(id)}.toString());
+            ship.setProperty("angle", game::Angle{.rad = -0.5 * tick}.toString());
+        }
+        store.Get(999).setProperty("angular_velocity", game::Angle{.rad = 0.01 * tick}.toString());
+        // same value, not sent
+        store.Get(500).setProperty("velocity", game::Vector{0, 0}.toString());
+
+        const auto delta = encoder.Encode(store);
+        // 11 ships with location and angle, a few bytes each
+        EXPECT_LT(delta.size(), 11u * 8u);
+        client.Apply(delta);
+
+        for (EntityId id = 0; id < store.Size(); ++id) {
+            const auto& ship = store.Get(id);
+            const auto replicated = client.Get(id);
+            EXPECT_EQ(0, ship.DirtyMask());
+            EXPECT_EQ(game::Point::fromString(ship.getProperty("location")), replicated.location);
+            EXPECT_EQ(QuantizeAngle(game::Angle::fromString(ship.getProperty("angle"))), replicated.angle);
+            EXPECT_EQ(QuantizeAngularVelocity(game::Angle::fromString(ship.getProperty("angular_velocity"))), replicated.angularVelocity);
+        }
+    }
+    EXPECT_EQ(1, encoder.Encode(store).size());
+}
+
+TEST(DeltaEncoderTest, AngleDeltaWrapsAround) {
+    EXPECT_EQ(QuantizeAngle(game::Angle{.rad = -0.001}), QuantizeAngle(game::Angle{.rad = 2 * 3.141592653589793 - 0.001}));
+    EXPECT_NEAR(0.5, DequantizeAngle(QuantizeAngle(game::Angle{.rad = 0.5})).rad, 1e-4);
+
+    EntityStore store;
+    store.Add();
+    DeltaEncoder encoder;
+    DeltaDecoder client;
+    store.Get(0).setProperty("angle", game::Angle{.rad = 6.28}.toString());
+    client.Apply(encoder.Encode(store));
+    store.Get(0).setProperty("angle", game::Angle{.rad = 0.01}.toString());
+    const auto delta = encoder.Encode(store);
+    // id gap, mask, a small delta and the terminator
+    EXPECT_EQ(5, delta.size());
+    client.Apply(delta);
+    EXPECT_EQ(QuantizeAngle(game::Angle{.rad = 0.01}), client.Get(0).angle);
+}
+
+TEST(DeltaEncoderTest, ShipIdsAreBounded) {
+    DeltaDecoder client{100};
+    const auto apply = [&client](std::uint64_t firstGap, std::uint64_t secondGap) {
+        command::BinaryWriter out;
+        out.WriteVarint(firstGap);
+        out.WriteByte(0);
+        out.WriteVarint(secondGap);
+        out.WriteByte(0);
+        out.WriteVarint(0);
+        client.Apply(out.Data());
+    };
+
+    apply(1, 99);
+    EXPECT_THROW(apply(1, 100), std::invalid_argument);
+    // next + gap would wrap around
+    EXPECT_THROW(apply(2, std::numeric_limits<std::uint64_t>::max()), std::invalid_argument);
+    EXPECT_THROW(apply(std::numeric_limits<std::uint64_t>::max(), 1), std::invalid_argument);
+}
+
+TEST(SchedulerTest, ChangesAreDispatchedAfterCommandsAndPhysics) {
+    Scheduler scheduler{SchedulerConfig{.threads = 4, .realtime = false}};
+    for (int i = 0; i < 100; ++i) scheduler.Entities().Add();
+
+    std::vector<Phase> seen;
+    Phase current{Phase::Input};
+    scheduler.OnInput([&current](Scheduler& s) {
+        current = Phase::Commands;
+        s.Queue().Push(std::make_unique<test::SetVelocity>(s.Entities().Get(7), game::Vector{1, 0}));
+    });
+    const auto velocityId = game::ChangeBus::Subscribe("velocity", [&](const game::PropertyChange& change) {
+        EXPECT_EQ(&scheduler.Entities().Get(7), change.entity);
+        seen.push_back(current);
+        current = Phase::Physics;
+    });
+    const auto locationId = game::ChangeBus::Subscribe("location", [&](const game::PropertyChange&) {
+        seen.push_back(current);
+    });
+
+    scheduler.Step();
+    game::ChangeBus::Unsubscribe(velocityId);
+    game::ChangeBus::Unsubscribe(locationId);
+
+    // one velocity change from the command, then the only moving ship
+    EXPECT_EQ((std::vector<Phase>{Phase::Commands, Phase::Physics}), seen);
+}
+
+TEST(WriteAheadLogTest, RecoversCheckpointAndLog) {
+    namespace fs = std::filesystem;
+    const auto dir = fs::temp_directory_path() / "simulation_wal_test";
+    fs::remove_all(dir);
+
+    EntityStore store;
+    {
+        WriteAheadLog wal{dir, 0, WalConfig{.sync = false}};
+        std::deque<LoggedEntity> logged;
+        auto add = [&] {
+            const auto id = store.Add();
+            wal.AppendCreate(id);
+            logged.emplace_back(store.Get(id), id, wal);
+        };
+        for (int i = 0; i < 100; ++i) add();
+
+        for (int i = 0; i < 100; ++i) {
+            logged[i].setProperty("location", game::Point{i, -i}.toString());
+        }
+        wal.Checkpoint(store);
+        EXPECT_EQ(200, wal.NextLsn());
+
+        // entities added after the checkpoint come back from the log alone
+        for (int i = 0; i < 20; ++i) add();
+        for (EntityId id = 0; id < logged.size(); id += 3) {
+            game::MovingObjectAdapter moa{&logged[id]};
+            moa.setLocation(game::Point{static_cast<int>(id), 7});
+            logged[id].setProperty("angle", game::Angle{.rad = 0.5}.toString());
+        }
+        EXPECT_THROW(logged[0].setProperty("fuel", "1"), std::logic_error);
+        wal.Flush();
+        EXPECT_EQ(wal.NextLsn(), wal.DurableLsn());
+    }
+
+    EntityStore recovered;
+    ThreadPool pool{4};
+    EXPECT_EQ(300, WriteAheadLog::Recover(dir, recovered, pool));
+    ASSERT_EQ(store.Size(), recovered.Size());
+    EXPECT_EQ(test::Snapshot(store), test::Snapshot(recovered));
+
+    // LSNs below the checkpoint would be skipped by the next recovery
+    EXPECT_THROW((WriteAheadLog{dir, 0}), std::invalid_argument);
+    {
+        WriteAheadLog wal{dir, 300};
+        EXPECT_THROW(wal.WaitDurable(300), std::out_of_range);
+        EXPECT_EQ(300, wal.Append(0, wal.Property("angle"), game::Angle{.rad = 1.}.toString()));
+        wal.WaitDurable(300);
+    }
+    fs::remove_all(dir);
+}
+
+TEST(WriteAheadLogTest, StopsAtTornGroup) {
+    namespace fs = std::filesystem;
+    const auto dir = fs::temp_directory_path() / "simulation_wal_torn_test";
+    fs::remove_all(dir);
+
+    EntityStore store;
+    store.Add();
+    {
+        WriteAheadLog wal{dir, 0};
+        LoggedEntity ship{store.Get(0), 0, wal};
+        ship.setProperty("location", game::Point{1, 1}.toString());
+        wal.Flush();
+        ship.setProperty("location", game::Point{2, 2}.toString());
+        ship.setProperty("angle", game::Angle{.rad = 1.}.toString());
+        wal.Flush();
+        EXPECT_EQ(2, wal.Groups());
+    }
+    // the second group was cut short
+    const auto segment = fs::directory_iterator{dir}->path();
+    fs::resize_file(segment, fs::file_size(segment) - 3);
+
+    ThreadPool pool{2};
+    {
+        EntityStore recovered;
+        EXPECT_EQ(1, WriteAheadLog::Recover(dir, recovered, pool));
+        EXPECT_EQ(game::Point(1, 1).toString(), recovered.Get(0).getProperty("location"));
+        EXPECT_EQ(game::Angle{.rad = 0.}.toString(), recovered.Get(0).getProperty("angle"));
+
+        // the log goes on behind the torn group
+        WriteAheadLog wal{dir, 1};
+        LoggedEntity ship{recovered.Get(0), 0, wal};
+        EXPECT_EQ(1, wal.Append(0, wal.Property("velocity"), game::Vector{3, 3}.toString()));
+        ship.setProperty("location", game::Point{4, 4}.toString());
+        wal.Flush();
+    }
+
+    EntityStore recovered;
+    EXPECT_EQ(3, WriteAheadLog::Recover(dir, recovered, pool));
+    EXPECT_EQ(game::Point(4, 4).toString(), recovered.Get(0).getProperty("location"));
+    EXPECT_EQ(game::Vector(3, 3).toString(), recovered.Get(0).getProperty("velocity"));
+    fs::remove_all(dir);
+}
+
+namespace test {
+
+// ten ships moving and turning every tick
+void MakeFleet(RollbackWorld& world) {
+    for (int i = 0; i < 10; ++i) {
+        auto& ship = world.Get(world.Add());
+        ship.setProperty("velocity", game::Vector{i, 1}.toString());
+        ship.setProperty("angular_velocity", game::Angle{.rad = 0.1}.toString());
+    }
+    world.OnTick([](RollbackWorld& w) {
+        for (EntityId id = 0; id < w.Size(); ++id) {
+            game::MovingObjectAdapter moa{&w.Get(id)};
+            game::Move{&moa}.Execute();
+            game::RotatingObjectAdapter roa{&w.Get(id)};
+            game::Rotate{&roa}.Execute();
+        }
+    });
+}
+
+}  // namespace test
+
+TEST(RollbackWorldTest, RewindRestoresTickStart) {
+    RollbackWorld world{5};
+    test::MakeFleet(world);
+
+    std::vector<std::vector<std::string>> states;
+    for (int tick = 0; tick < 8; ++tick) {
+        states.push_back(test::Snapshot(world));
+        world.Step();
+    }
+    // 10 locations and 10 angles a tick
+    EXPECT_EQ(20, world.LastRecorded());
+    EXPECT_EQ(3, world.OldestTick());
+    EXPECT_THROW(world.RewindTo(2), std::out_of_range);
+
+    world.RewindTo(6);
+    EXPECT_EQ(states[6], test::Snapshot(world));
+    world.RewindTo(3);
+    EXPECT_EQ(states[3], test::Snapshot(world));
+    EXPECT_EQ(3, world.CurrentTick());
+
+    // the same ticks again give the same states
+    for (int tick = 3; tick < 8; ++tick) {
+        EXPECT_EQ(states[tick], test::Snapshot(world));
+        world.Step();
+    }
+}
+
+TEST(RollbackWorldTest, ThrowingTickCanBeRewound) {
+    RollbackWorld world{5};
+    test::MakeFleet(world);
+    world.Step();
+    const auto before = test::Snapshot(world);
+
+    bool fail{true};
+    world.OnTick([&fail](RollbackWorld&) {
+        if (std::exchange(fail, false)) throw std::runtime_error("hook failed");
+    });
+    EXPECT_THROW(world.Step(), std::runtime_error);
+    EXPECT_EQ(2, world.CurrentTick());
+    EXPECT_EQ(20, world.LastRecorded());
+
+    // the hook's writes are undone, a write outside Step() is not recorded any more
+    world.Get(0).setProperty("velocity", game::Vector{9, 9}.toString());
+    world.RewindTo(1);
+    EXPECT_EQ(game::Vector(9, 9).toString(), world.Get(0).getProperty("velocity"));
+    world.Get(0).setProperty("velocity", game::Vector{0, 1}.toString());
+    EXPECT_EQ(before, test::Snapshot(world));
+    world.Step();
+    EXPECT_EQ(2, world.CurrentTick());
+}
+
+TEST(RollbackWorldTest, LateInputIsResimulated) {
+    RollbackWorld onTime{10};
+    test::MakeFleet(onTime);
+    onTime.Input(4, std::make_unique<test::SetVelocity>(onTime.Get(2), game::Vector{-5, 0}));
+    for (int tick = 0; tick < 9; ++tick) onTime.Step();
+
+    RollbackWorld late{10};
+    test::MakeFleet(late);
+    for (int tick = 0; tick < 9; ++tick) late.Step();
+    EXPECT_NE(test::Snapshot(onTime), test::Snapshot(late));
+
+    late.Input(4, std::make_unique<test::SetVelocity>(late.Get(2), game::Vector{-5, 0}));
+    late.Resimulate(4);
+    EXPECT_EQ(9, late.CurrentTick());
+    EXPECT_EQ(test::Snapshot(onTime), test::Snapshot(late));
+
+    // the input is kept and runs again on the next resimulation
+    late.Resimulate(0);
+    EXPECT_EQ(test::Snapshot(onTime), test::Snapshot(late));
+    for (int tick = 0; tick < 10; ++tick) late.Step();
+    EXPECT_THROW(late.Input(5, std::make_unique<test::SetVelocity>(late.Get(2), game::Vector{0, 0})), std::out_of_range);
+}
+
+namespace test {
+
+// ships crossing the stripes of the shards both ways, steered by commands every few ticks
+std::vector<std::string> SimulateSharded(std::size_t shards, std::uint64_t* migrations = nullptr) {
+    ShardedWorld world{ShardedWorldConfig{.shards = shards, .width = 400}};
+    for (int i = 0; i < 200; ++i) {
+        world.Add(game::Point{i * 2, i}, game::Vector{i % 7 - 3, 1});
+    }
+    EXPECT_THROW(world.Get(0), std::out_of_range);
+
+    for (int tick = 0; tick < 60; ++tick) {
+        if (tick % 5 == 0) {
+            for (EntityId id = tick % 3; id < world.Size(); id += 3) {
+                const game::Vector velocity{(tick + static_cast<int>(id)) % 11 - 5, 0};
+                world.Send(id, [velocity](ShardEntity& entity) {
+                    return std::make_unique<SetVelocity>(entity.ship, velocity);
+                });
+            }
+        }
+        world.Step();
+    }
+
+    std::vector<std::string> res;
+    for (EntityId id = 0; id < world.Size(); ++id) {
+        const auto location = game::Point::fromString(world.Get(id).getProperty("location"));
+        // every ship is where its stripe is
+        EXPECT_EQ(std::clamp(location.x(), 0, 399) * static_cast<int>(world.Shards()) / 400, world.ShardOf(id));
+        res.push_back(location.toString());
+    }
+    if (migrations) *migrations = world.Migrations();
+    return res;
+}
+
+}  // namespace test
+
+TEST(ShardedWorldTest, ShardsMatchOneShard) {
+    std::uint64_t migrations{0};
+    const auto reference = test::SimulateSharded(1, &migrations);
+    EXPECT_EQ(0, migrations);
+
+    EXPECT_EQ(reference, test::SimulateSharded(4, &migrations));
+    EXPECT_GT(migrations, 0);
+}
+
+TEST(ShardedWorldTest, AddIsRejectedDuringTick) {
+    ShardedWorld world{ShardedWorldConfig{.shards = 2, .width = 100, .pinToNodes = false}};
+    const auto id = world.Add(game::Point{10, 0});
+    world.Step();
+    world.Send(id, [&world](ShardEntity&) -> exceptions::ICommandUPtr {
+        world.Add(game::Point{90, 0});
+        return nullptr;
+    });
+    EXPECT_THROW(world.Step(), std::logic_error);
+    EXPECT_EQ(1, world.Size());
+}
+
+TEST(ShardedWorldTest, ThrowingFactoryDoesNotStopTheTick) {
+    ShardedWorld world{ShardedWorldConfig{.shards = 2, .width = 100, .pinToNodes = false}};
+    const auto a = world.Add(game::Point{10, 0}, game::Vector{1, 0});
+    const auto b = world.Add(game::Point{20, 0}, game::Vector{1, 0});
+    world.Step();
+
+    world.Send(a, [](ShardEntity&) -> exceptions::ICommandUPtr { throw std::runtime_error("no command"); });
+    world.Send(b, [](ShardEntity& entity) { return std::make_unique<test::SetVelocity>(entity.ship, game::Vector{2, 0}); });
+    EXPECT_THROW(world.Step(), std::runtime_error);
+    EXPECT_EQ("12,0", world.Get(a).getProperty("location"));
+    EXPECT_EQ("23,0", world.Get(b).getProperty("location"));
+
+    // the letters of that tick are gone when its inbox comes round again
+    world.Step();
+    world.Step();
+    EXPECT_EQ("14,0", world.Get(a).getProperty("location"));
+    EXPECT_EQ("27,0", world.Get(b).getProperty("location"));
+}
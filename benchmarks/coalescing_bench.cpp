@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <cmd_loop.hpp>
+#include <coalescing_queue.hpp>
+#include <command_codec.hpp>
+#include <game.hpp>
+#include <loop_command.hpp>
+#include <queue_impl.hpp>
+
+namespace {
+
+constexpr std::size_t commandsPerTick{4096};
+
+struct Order {
+    command::EntityId target;
+    bool rotate;
+};
+
+// One tick of client input: every target gets range(0) commands, three Moves to one Rotate,
+// shuffled so duplicates for a target are spread over the tick.
+class Traffic {
+public:
+    explicit Traffic(std::size_t perTarget)
+    : targets_{commandsPerTick / perTarget} {
+        for (std::size_t i = 0; i < targets_; ++i) {
+            auto& ship = *ships_.emplace_back(std::make_unique<game::SpaceShip>());
+            ship.setProperty("velocity", game::Vector{1, 1}.toString());
+            ship.setProperty("angular_velocity", game::Angle{.rad = 0.01}.toString());
+            ctx_.AddEntity(&ship);
+        }
+        for (std::size_t i = 0; i < commandsPerTick; ++i) {
+            orders_.push_back(Order{command::ToEntityId(i % targets_), 3 == (i / targets_ + i) % 4});
+        }
+        std::shuffle(orders_.begin(), orders_.end(), std::mt19937{42});
+    }
+
+    void Push(exceptions::IQueue& q) {
+        for (const auto& order: orders_) {
+            if (order.rotate) q.Push(command::MakeLoopCommand<command::Rotate>(&ctx_.Rotating(order.target)));
+            else q.Push(command::MakeLoopCommand<command::Move>(&ctx_.Moving(order.target)));
+        }
+    }
+
+private:
+    std::size_t targets_;
+    std::vector<std::unique_ptr<game::SpaceShip>> ships_;
+    command::CodecContext ctx_;
+    std::vector<Order> orders_;
+};
+
+void BM_TickFifo(benchmark::State& state) {
+    Traffic traffic{static_cast<std::size_t>(state.range(0))};
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        traffic.Push(q);
+        exceptions::cmd_loop::run(q);
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerTick);
+}
+
+void BM_TickCoalesced(benchmark::State& state) {
+    Traffic traffic{static_cast<std::size_t>(state.range(0))};
+    command::CoalescingQueue q;
+    std::size_t executed{0};
+    for (auto _ : state) {
+        traffic.Push(q);
+        executed += exceptions::cmd_loop::run(q, commandsPerTick);
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerTick);
+    state.counters["executed_per_tick"] = static_cast<double>(executed) / static_cast<double>(state.iterations());
+}
+
+} // namespace
+
+// commands per target and tick: no duplicates, typical client rates, a burst
+BENCHMARK(BM_TickFifo)->Arg(1)->Arg(2)->Arg(4)->Arg(16)->ArgName("per_target")->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TickCoalesced)->Arg(1)->Arg(2)->Arg(4)->Arg(16)->ArgName("per_target")->Unit(benchmark::kMicrosecond);
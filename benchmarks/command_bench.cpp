@@ -0,0 +1,151 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+
+#include <caching_adapter.hpp>
+#include <command_impl.hpp>
+#include <fuel_tank.hpp>
+#include <game.hpp>
+#include <macro_impl.hpp>
+#include <seqlock_entity.hpp>
+
+namespace {
+
+class NoOpCommand : public command::ICommand {
+public:
+    void Execute() override {}
+};
+
+// arg: number of children
+void BM_MacroCommandDispatch(benchmark::State& state) {
+    std::vector<NoOpCommand> children(static_cast<std::size_t>(state.range(0)));
+    command::MacroCommand::ICommandsArr ptrs;
+    for (auto& child: children) ptrs.push_back(&child);
+    command::MacroCommand macroCmd{std::move(ptrs)};
+
+    for (auto _ : state) {
+        macroCmd.Execute();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_MacroCheckMoveBurn(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, 1}.toString());
+
+    // game::SpaceShip has no fuel, so the adapter works on a dedicated entity
+    class FuelTank : public game::IEntity {
+    public:
+        std::string getProperty(std::string_view) const override { return fuel_; }
+        void setProperty(std::string_view, std::string_view val) override { fuel_ = val; }
+    private:
+        std::string fuel_{"1000000000"};
+    } tank;
+
+    game::MovingObjectAdapter moa{&ship};
+    command::FuelConsumingObjectAdapter fcoa{&tank};
+    command::CheckFuel checkFuelCmd{&fcoa};
+    command::Move moveCmd{&moa};
+    command::BurnFuel burnFuelCmd{&fcoa};
+    command::MacroCommand macroCmd{command::MacroCommand::ICommandsArr{&checkFuelCmd, &moveCmd, &burnFuelCmd}};
+
+    for (auto _ : state) {
+        macroCmd.Execute();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// arg: 1 - through a write-back CachingAdapter flushed by the macro, 0 - plain adapters.
+// Move, ChangeVelocity, Rotate, Move, Rotate on one ship.
+void BM_FiveCommandMacro(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, 1}.toString());
+    ship.setProperty("angular_velocity", game::Angle{.rad = 0.01}.toString());
+
+    game::MovingObjectAdapter moa{&ship};
+    game::RotatingObjectAdapter roa{&ship};
+    game::CachingAdapter cache{&ship};
+    const auto cached = 0 != state.range(0);
+    game::IMovingObject* moving = cached ? static_cast<game::IMovingObject*>(&cache) : &moa;
+    game::IRotatingObject* rotating = cached ? static_cast<game::IRotatingObject*>(&cache) : &roa;
+
+    command::Move moveCmd{moving};
+    command::ChangeVelocity changeVelocityCmd{rotating, moving};
+    command::Rotate rotateCmd{rotating};
+    command::FlushCache flushCmd{&cache};
+    command::MacroCommand::ICommandsArr cmds{&moveCmd, &changeVelocityCmd, &rotateCmd, &moveCmd, &rotateCmd};
+    if (cached) cmds.push_back(&flushCmd);
+    command::MacroCommand macroCmd{std::move(cmds)};
+
+    for (auto _ : state) {
+        // every macro starts from the entity, as it would in the next tick
+        cache.Reset();
+        macroCmd.Execute();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+enum BurnMode {
+    StringProperty,  // CheckFuel + BurnFuel through FuelConsumingObjectAdapter
+    AtomicTryBurn,   // FuelTank::TryBurn(1) per unit
+    Reservation,     // FuelReservation of 8 units, burnt locally
+};
+
+// arg: mode. All threads burn single units from one ship, the items are burnt units.
+// The string adapter runs over a SeqlockEntity, so every property access is thread safe
+// but check-then-burn is not: "burnt" above "fuel_used" means units were spent twice.
+void BM_ContendedBurn(benchmark::State& state) {
+    constexpr int initialFuel{1'000'000'000};
+    constexpr std::uint32_t batch{8};
+    static game::SeqlockEntity ship{{"fuel", game::IntegerProperty{initialFuel}.toString()}};
+    static command::FuelTank tank;
+
+    const auto mode = static_cast<BurnMode>(state.range(0));
+    command::FuelConsumingObjectAdapter fcoa{&ship};
+    if (0 == state.thread_index()) {
+        ship.setProperty("fuel", game::IntegerProperty{initialFuel}.toString());
+        tank.Refill(initialFuel - tank.Level());
+    }
+
+    std::int64_t burnt{0};
+    command::FuelReservation reservation{&tank};
+    for (auto _ : state) {
+        switch (mode) {
+        case StringProperty:
+            if (fcoa.CheckFuel()) {
+                fcoa.BurnFuel();
+                ++burnt;
+            }
+            break;
+        case AtomicTryBurn:
+            burnt += tank.TryBurn(1) ? 1 : 0;
+            break;
+        case Reservation:
+            if (0 == reservation.Reserved() && !reservation.Reserve(batch)) break;
+            reservation.BurnFuel();
+            ++burnt;
+            break;
+        }
+    }
+    // every thread has left the loop here, reservations still hold their unused units
+    if (0 == state.thread_index()) {
+        const auto level = StringProperty == mode ? game::IntegerProperty::fromString(ship.getProperty("fuel")).val
+                                                  : tank.Level();
+        state.counters["fuel_used"] = static_cast<double>(initialFuel - level);
+    }
+    state.counters["burnt"] = static_cast<double>(burnt);
+    state.SetItemsProcessed(burnt);
+}
+
+}  // namespace
+
+BENCHMARK(BM_MacroCommandDispatch)->Arg(3)->Arg(32);
+BENCHMARK(BM_MacroCheckMoveBurn);
+BENCHMARK(BM_FiveCommandMacro)->Arg(0)->Arg(1)->ArgName("cached");
+BENCHMARK(BM_ContendedBurn)
+    ->Arg(StringProperty)
+    ->Arg(AtomicTryBurn)
+    ->Arg(Reservation)
+    ->ArgName("mode")
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
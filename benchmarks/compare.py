@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Compares a Google Benchmark JSON report against a stored baseline.
+
+    compare.py baseline.json current.json [--threshold 0.1] [--metric cpu_time]
+    compare.py baseline.json current.json --update
+
+Exits with 1 when any benchmark is slower than the baseline by more than
+the threshold. Repetition means are used when the report has aggregates.
+"""
+
+import argparse
+import json
+import shutil
+import sys
+from pathlib import Path
+
+UNIT_TO_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path, metric):
+    with open(path) as f:
+        report = json.load(f)
+
+    results = {}
+    has_aggregates = any(b.get("run_type") == "aggregate" for b in report["benchmarks"])
+    for bench in report["benchmarks"]:
+        if has_aggregates:
+            if bench.get("run_type") != "aggregate" or bench.get("aggregate_name") != "mean":
+                continue
+        elif bench.get("run_type") == "aggregate":
+            continue
+        name = bench.get("run_name", bench["name"])
+        results[name] = bench[metric] * UNIT_TO_NS[bench.get("time_unit", "ns")]
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", type=Path)
+    parser.add_argument("current", type=Path)
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed relative slowdown, default 0.10")
+    parser.add_argument("--metric", choices=["cpu_time", "real_time"], default="cpu_time")
+    parser.add_argument("--update", action="store_true", help="store the current report as the new baseline")
+    args = parser.parse_args()
+
+    if args.update:
+        shutil.copyfile(args.current, args.baseline)
+        print(f"baseline updated: {args.baseline}")
+        return 0
+
+    if not args.baseline.exists():
+        print(f"no baseline at {args.baseline}, store one with --update")
+        return 0
+
+    baseline = load(args.baseline, args.metric)
+    current = load(args.current, args.metric)
+
+    regressions = []
+    width = max((len(name) for name in current), default=10)
+    print(f"{'benchmark':<{width}} {'baseline ns':>14} {'current ns':>14} {'change':>9}")
+    for name, cur in current.items():
+        base = baseline.get(name)
+        if base is None:
+            print(f"{name:<{width}} {'-':>14} {cur:>14.1f} {'new':>9}")
+            continue
+        change = (cur - base) / base if base > 0 else 0.0
+        mark = ""
+        if change > args.threshold:
+            regressions.append(name)
+            mark = "  REGRESSION"
+        print(f"{name:<{width}} {base:>14.1f} {cur:>14.1f} {change:>+8.1%}{mark}")
+
+    for name in baseline.keys() - current.keys():
+        print(f"{name:<{width}} missing from the current report")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than baseline by more than {args.threshold:.0%}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+
+#include <command_impl.hpp>
+#include <game.hpp>
+#include <primitives.hpp>
+
+namespace {
+
+constexpr double velocityX{7.};
+constexpr double velocityY{3.};
+constexpr double angleRad{0.3};
+// keeps the trajectory inside the Q16.16 range (|coordinate| < 32768)
+constexpr int ticksPerTrajectory{1000};
+
+void SetUpShip(game::SpaceShip& ship) {
+    ship.setProperty("location", "0,0");
+    ship.setProperty("velocity", "7,3");
+    ship.setProperty("angle", game::Angle{.rad = angleRad}.toString());
+    ship.setProperty("angular_velocity", game::Angle{.rad = 0.}.toString());
+}
+
+// Move + ChangeVelocity per tick, the hot path of the physics step.
+// The location after a trajectory is known analytically, so the accumulated
+// error of every representation is reported next to its throughput.
+template<typename T>
+void BM_MoveAndChangeVelocity(benchmark::State& state) {
+    game::SpaceShip ship;
+    SetUpShip(ship);
+
+    game::BasicMovingObjectAdapter<T> moa{&ship};
+    game::RotatingObjectAdapter roa{&ship};
+    command::BasicMove<T> moveCmd{&moa};
+    command::BasicChangeVelocity<T> changeVCmd{&roa, &moa};
+
+    for (auto _ : state) {
+        ship.setProperty("location", "0,0");
+        for (int i = 0; i < ticksPerTrajectory; ++i) {
+            moveCmd.Execute();
+            changeVCmd.Execute();
+        }
+    }
+
+    const auto ticks = static_cast<double>(ticksPerTrajectory);
+    const auto c = std::cos(angleRad);
+    const auto s = std::sin(angleRad);
+    const auto expectedX = ticks * (velocityX + velocityX * c - velocityY * s);
+    const auto expectedY = ticks * (velocityY + velocityX * s + velocityY * c);
+
+    const auto location = moa.getLocation();
+    const auto dx = game::CoordinateTraits<T>::toDouble(location.x()) - expectedX;
+    const auto dy = game::CoordinateTraits<T>::toDouble(location.y()) - expectedY;
+    const auto absError = std::hypot(dx, dy);
+
+    state.SetItemsProcessed(state.iterations() * ticksPerTrajectory);
+    state.counters["abs_error"] = absError;
+    state.counters["rel_error"] = absError / std::hypot(expectedX, expectedY);
+}
+
+template<typename T>
+void BM_PointParseFormat(benchmark::State& state) {
+    const auto str = game::BasicPoint<T>{game::CoordinateTraits<T>::fromDouble(1234.5678),
+                                         game::CoordinateTraits<T>::fromDouble(-98.765)}.toString();
+    for (auto _ : state) {
+        auto point = game::BasicPoint<T>::fromString(str);
+        benchmark::DoNotOptimize(point.toString());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_MoveAndChangeVelocity, int);
+BENCHMARK_TEMPLATE(BM_MoveAndChangeVelocity, game::Fixed16);
+BENCHMARK_TEMPLATE(BM_MoveAndChangeVelocity, float);
+BENCHMARK_TEMPLATE(BM_MoveAndChangeVelocity, double);
+
+BENCHMARK_TEMPLATE(BM_PointParseFormat, int);
+BENCHMARK_TEMPLATE(BM_PointParseFormat, game::Fixed16);
+BENCHMARK_TEMPLATE(BM_PointParseFormat, float);
+BENCHMARK_TEMPLATE(BM_PointParseFormat, double);
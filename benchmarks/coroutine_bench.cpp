@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+
+#include <cmd_loop.hpp>
+#include <coroutine_command.hpp>
+#include <queue_impl.hpp>
+
+namespace {
+
+using namespace exceptions;
+
+constexpr int steps{10};
+
+// state of a multi-tick maneuver, the same in both patterns
+struct Maneuver {
+    double x{0.};
+    double y{0.};
+    double vx{1.};
+    double vy{.5};
+    double targetX{100.};
+    double targetY{50.};
+
+    void Step(std::uint64_t& progress) noexcept {
+        x += vx;
+        y += vy;
+        vx += (targetX - x) * 1e-3;
+        vy += (targetY - y) * 1e-3;
+        ++progress;
+    }
+};
+
+// The re-enqueue pattern: a multi-tick behavior is a command that clones itself for the next tick
+class StepCommand : public ICommand {
+public:
+    StepCommand(IQueue& q, std::uint64_t& progress, int remaining)
+    : q_{q}
+    , progress_{progress}
+    , remaining_{remaining} {}
+
+    void Execute() const override {
+        maneuver_.Step(progress_);
+        if (--remaining_ > 0) q_.Push(Clone());
+    }
+
+    ICommandUPtr Clone() const override { return std::make_unique<StepCommand>(*this); }
+
+private:
+    IQueue& q_;
+    std::uint64_t& progress_;
+    mutable Maneuver maneuver_;
+    mutable int remaining_;
+};
+
+Behavior Steps(Coroutines& rt, std::uint64_t& progress) {
+    Maneuver maneuver;
+    for (int i = 0; i < steps; ++i) {
+        maneuver.Step(progress);
+        co_await rt.NextTick();
+    }
+}
+
+void BM_BehaviorsReenqueue(benchmark::State& state) {
+    const auto behaviors = static_cast<std::size_t>(state.range(0));
+    std::uint64_t progress{0};
+    for (auto _ : state) {
+        QueueImpl q;
+        for (std::size_t i = 0; i < behaviors; ++i) {
+            q.Push(std::make_unique<StepCommand>(q, progress, steps));
+        }
+        for (int tick = 0; tick < steps; ++tick) {
+            cmd_loop::run(q, behaviors);
+        }
+    }
+    benchmark::DoNotOptimize(progress);
+    state.SetItemsProcessed(state.iterations() * behaviors * steps);
+}
+
+void BM_BehaviorsCoroutine(benchmark::State& state) {
+    const auto behaviors = static_cast<std::size_t>(state.range(0));
+    std::uint64_t progress{0};
+    for (auto _ : state) {
+        QueueImpl q;
+        Coroutines rt{q};
+        for (std::size_t i = 0; i < behaviors; ++i) {
+            rt.Spawn(Steps(rt, progress));
+        }
+        // one more tick lets every behavior run to completion
+        for (int tick = 0; tick <= steps; ++tick) {
+            cmd_loop::run(q);
+            rt.Tick();
+        }
+    }
+    benchmark::DoNotOptimize(progress);
+    state.SetItemsProcessed(state.iterations() * behaviors * steps);
+}
+
+}  // namespace
+
+BENCHMARK(BM_BehaviorsReenqueue)->Arg(1 << 14)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BehaviorsCoroutine)->Arg(1 << 14)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
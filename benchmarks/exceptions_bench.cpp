@@ -0,0 +1,171 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <cmd_loop.hpp>
+#include <command_impl.hpp>
+#include <exceptions_impl.hpp>
+#include <queue_impl.hpp>
+
+namespace {
+
+using namespace exceptions;
+
+class NoOpCommand : public ICommand {
+public:
+    void Execute() const override {}
+    ICommandUPtr Clone() const override { return std::make_unique<NoOpCommand>(*this); }
+};
+
+// has no registered handler, so Handle falls back to the default command
+class UnhandledThrow : public ICommand {
+public:
+    void Execute() const override { throw TestException{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<UnhandledThrow>(*this); }
+};
+
+class BenchException : public IException {
+public:
+    explicit BenchException(const Message& what) noexcept
+    : IException{what} {}
+};
+
+constexpr int commandsPerRun{1000};
+
+void RegisterNoOpHandler() {
+    ExceptionHandler::Register<ThrowException, TestException>(std::make_unique<NoOpCommand>());
+}
+
+// arg: every n-th command throws, 0 means none does
+void BM_CmdLoopRun(benchmark::State& state) {
+    RegisterNoOpHandler();
+    const auto throwEvery = state.range(0);
+    QueueImpl q;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < commandsPerRun; ++i) {
+            if (throwEvery > 0 && 0 == i % throwEvery) {
+                q.Push(std::make_unique<ThrowException>());
+            } else {
+                q.Push(std::make_unique<NoOpCommand>());
+            }
+        }
+        state.ResumeTiming();
+        cmd_loop::run(q);
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerRun);
+}
+
+void BM_HandleRegistered(benchmark::State& state) {
+    RegisterNoOpHandler();
+    const ICommandUPtr cmd = std::make_unique<ThrowException>();
+    const TestException ex;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ExceptionHandler::Handle(cmd, ex));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_HandleDefault(benchmark::State& state) {
+    const ICommandUPtr cmd = std::make_unique<UnhandledThrow>();
+    const TestException ex;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ExceptionHandler::Handle(cmd, ex));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// One throw, catch and handler lookup per iteration, the cycle cmd_loop runs for a failing command.
+// arg: 0 throws a literal message, 1 a message copied from runtime text, 2 a literal with details
+void BM_ThrowCatchHandle(benchmark::State& state) {
+    RegisterNoOpHandler();
+    const ICommandUPtr cmd = std::make_unique<ThrowException>();
+    const std::string runtime{"Message built at runtime"};
+    const auto kind = state.range(0);
+
+    for (auto _ : state) {
+        try {
+            switch (kind) {
+                case 0: throw TestException{};
+                case 1: throw BenchException{Message::Copy(runtime)};
+                default: throw BenchException{Message::Literal("Not enough fuel to burn {} units", 3)};
+            }
+        } catch (const IException& ex) {
+            benchmark::DoNotOptimize(ExceptionHandler::Handle(cmd, ex));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// DeepError<N> is N levels below the registered DeepError<0>
+template<int N>
+class DeepError : public DeepError<N - 1> {};
+
+template<>
+class DeepError<0> : public IException {
+public:
+    DeepError() : IException{Message::Literal("Deep error")} {}
+};
+
+constexpr int maxDepth{32};
+
+class DeepThrow : public ICommand {
+public:
+    void Execute() const override { throw DeepError<maxDepth>{}; }
+    ICommandUPtr Clone() const override { return std::make_unique<DeepThrow>(*this); }
+};
+
+// registrations for every level on another command, plus bases at three levels for this one
+template<int... Levels>
+void RegisterDeepHandlers(std::integer_sequence<int, Levels...>) {
+    (ExceptionHandler::Register<ThrowException, DeepError<Levels>>(std::make_unique<NoOpCommand>()), ...);
+    ExceptionHandler::Register<ICommand, DeepError<0>>(std::make_unique<NoOpCommand>());
+    ExceptionHandler::Register<DeepThrow, DeepError<0>>(std::make_unique<NoOpCommand>());
+    ExceptionHandler::Register<DeepThrow, DeepError<maxDepth / 2>>(std::make_unique<NoOpCommand>());
+}
+
+// steady state: the pair is resolved on the first call and memoized
+template<int Depth>
+void BM_HandleHierarchy(benchmark::State& state) {
+    RegisterDeepHandlers(std::make_integer_sequence<int, maxDepth + 1>{});
+    const ICommandUPtr cmd = std::make_unique<DeepThrow>();
+    const DeepError<Depth> ex;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ExceptionHandler::Handle(cmd, ex));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// every iteration registers a handler first, so every Handle resolves the pair again
+template<int Depth>
+void BM_ResolveHierarchy(benchmark::State& state) {
+    RegisterDeepHandlers(std::make_integer_sequence<int, maxDepth + 1>{});
+    const ICommandUPtr cmd = std::make_unique<DeepThrow>();
+    const DeepError<Depth> ex;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ExceptionHandler::Register<DeepThrow, TestException>(std::make_unique<NoOpCommand>());
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(ExceptionHandler::Handle(cmd, ex));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK(BM_CmdLoopRun)->Arg(0)->Arg(100)->Arg(10)->Arg(1)->ArgName("throw_every");
+BENCHMARK(BM_HandleRegistered);
+BENCHMARK(BM_HandleDefault);
+BENCHMARK_TEMPLATE(BM_HandleHierarchy, 1);
+BENCHMARK_TEMPLATE(BM_HandleHierarchy, 8);
+BENCHMARK_TEMPLATE(BM_HandleHierarchy, 32);
+BENCHMARK_TEMPLATE(BM_ResolveHierarchy, 1);
+BENCHMARK_TEMPLATE(BM_ResolveHierarchy, 8);
+BENCHMARK_TEMPLATE(BM_ResolveHierarchy, 32);
+BENCHMARK(BM_ThrowCatchHandle)->Arg(0)->Arg(1)->Arg(2)->ArgName("message");
@@ -0,0 +1,117 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+
+#include <cmd_loop.hpp>
+#include <fair_queue_impl.hpp>
+#include <latency_histogram.hpp>
+#include <queue_impl.hpp>
+
+namespace {
+
+using namespace exceptions;
+using Clock = std::chrono::steady_clock;
+
+// Records its queueing latency when executed and burns a fixed amount of work
+class TenantProbe : public ICommand {
+public:
+    TenantProbe(LatencyHistogram& hist, int work)
+    : hist_{hist}
+    , work_{work}
+    , enqueued_{Clock::now()} {}
+
+    void Execute() const override {
+        hist_.Record(Clock::now() - enqueued_);
+        volatile double x{1.};
+        for (int i = 0; i < work_; ++i) x = x * 1.000001;
+    }
+
+    ICommandUPtr Clone() const override { return std::make_unique<TenantProbe>(*this); }
+
+private:
+    LatencyHistogram& hist_;
+    int work_;
+    Clock::time_point enqueued_;
+};
+
+constexpr int rounds{5'000};
+constexpr int quietTenants{8};
+constexpr int floodPerRound{24};
+constexpr int executedPerRound{16};
+constexpr int quietWork{50};
+constexpr int floodWork{200};
+
+// Every round each quiet tenant pushes one cheap command and the flooding tenant
+// pushes a burst of expensive ones, more than the loop executes in a round.
+template<typename TPush>
+void Flood(IQueue& q, TPush push, LatencyHistogram& quiet, LatencyHistogram& flood) {
+    for (int round = 0; round < rounds; ++round) {
+        for (int t = 0; t < quietTenants; ++t) {
+            push(static_cast<std::size_t>(t), std::make_unique<TenantProbe>(quiet, quietWork));
+        }
+        for (int i = 0; i < floodPerRound; ++i) {
+            push(quietTenants, std::make_unique<TenantProbe>(flood, floodWork));
+        }
+        cmd_loop::run(q, executedPerRound);
+    }
+}
+
+void ReportLatency(benchmark::State& state, const LatencyHistogram& quiet, const LatencyHistogram& flood) {
+    state.counters["quiet_p50_us"] = quiet.Percentile(50.) / 1e3;
+    state.counters["quiet_p99_us"] = quiet.Percentile(99.) / 1e3;
+    state.counters["quiet_executed"] = static_cast<double>(quiet.Count()) / state.iterations();
+    state.counters["flood_executed"] = static_cast<double>(flood.Count()) / state.iterations();
+}
+
+void BM_FloodFifo(benchmark::State& state) {
+    LatencyHistogram quiet;
+    LatencyHistogram flood;
+    for (auto _ : state) {
+        QueueImpl q;
+        Flood(q, [&q](std::size_t, ICommandUPtr cmd) { q.Push(std::move(cmd)); }, quiet, flood);
+        state.PauseTiming();
+        while (!q.IsEmpty()) q.Pop();
+        state.ResumeTiming();
+    }
+    ReportLatency(state, quiet, flood);
+}
+
+void BM_FloodFair(benchmark::State& state) {
+    LatencyHistogram quiet;
+    LatencyHistogram flood;
+    for (auto _ : state) {
+        FairQueue q;
+        for (int t = 0; t <= quietTenants; ++t) q.AddTenant();
+        Flood(q, [&q](std::size_t tenant, ICommandUPtr cmd) { q.Push(tenant, std::move(cmd)); }, quiet, flood);
+        state.PauseTiming();
+        while (!q.IsEmpty()) q.Pop();
+        state.ResumeTiming();
+    }
+    ReportLatency(state, quiet, flood);
+}
+
+// dispatch overhead of the front-end alone, one tenant and empty commands
+class Noop : public ICommand {
+public:
+    void Execute() const override {}
+    ICommandUPtr Clone() const override { return std::make_unique<Noop>(); }
+};
+
+void BM_DispatchOverhead(benchmark::State& state) {
+    const auto tenants = static_cast<std::size_t>(state.range(0));
+    FairQueue q;
+    for (std::size_t t = 0; t < tenants; ++t) q.AddTenant();
+    std::size_t next{0};
+    for (auto _ : state) {
+        q.Push(next, std::make_unique<Noop>());
+        next = next + 1 == tenants ? 0 : next + 1;
+        cmd_loop::run(q, 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK(BM_FloodFifo)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FloodFair)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DispatchOverhead)->Arg(1)->Arg(64)->Arg(4096);
@@ -0,0 +1,229 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include <change_bus.hpp>
+#include <game.hpp>
+#include <primitives.hpp>
+#include <seqlock_entity.hpp>
+
+namespace {
+
+void BM_PointParse(benchmark::State& state) {
+    const auto str = game::Point{-1234, 5678}.toString();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(game::Point::fromString(str));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_PointFormat(benchmark::State& state) {
+    const game::Point point{-1234, 5678};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(point.toString());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_VectorParse(benchmark::State& state) {
+    const auto str = game::Vector{-7, 3}.toString();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(game::Vector::fromString(str));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_AngleParse(benchmark::State& state) {
+    const auto str = game::Angle{.rad = 1.234567}.toString();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(game::Angle::fromString(str));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_AngleFormat(benchmark::State& state) {
+    const game::Angle angle{.rad = 1.234567};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(angle.toString());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_IntegerPropertyParseFormat(benchmark::State& state) {
+    const auto str = game::IntegerProperty{.val = 123456}.toString();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(game::IntegerProperty::fromString(str).toString());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_MovingAdapterGetLocation(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("location", game::Point{12, 5}.toString());
+    game::MovingObjectAdapter moa{&ship};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(moa.getLocation());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_MovingAdapterSetLocation(benchmark::State& state) {
+    game::SpaceShip ship;
+    game::MovingObjectAdapter moa{&ship};
+    const game::Point location{12, 5};
+
+    for (auto _ : state) {
+        moa.setLocation(location);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RotatingAdapterGetSet(benchmark::State& state) {
+    game::SpaceShip ship;
+    game::RotatingObjectAdapter roa{&ship};
+
+    for (auto _ : state) {
+        roa.setAngle(roa.getAngle() + roa.getAngularVelocity());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_MoveCommand(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, -1}.toString());
+    game::MovingObjectAdapter moa{&ship};
+    game::Move moveCmd{&moa};
+
+    for (auto _ : state) {
+        moveCmd.Execute();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// SpaceShip behind a reader/writer lock, the baseline for SeqlockEntity
+class SharedMutexEntity : public game::IEntity {
+public:
+    std::string getProperty(std::string_view key) const override {
+        std::shared_lock lock{mtx_};
+        return ship_.getProperty(key);
+    }
+
+    void setProperty(std::string_view key, std::string_view val) override {
+        std::unique_lock lock{mtx_};
+        ship_.setProperty(key, val);
+    }
+
+    void getProperties(std::span<const std::string_view> keys, std::span<std::string> values) const override {
+        std::shared_lock lock{mtx_};
+        ship_.getProperties(keys, values);
+    }
+
+private:
+    mutable std::shared_mutex mtx_;
+    game::SpaceShip ship_;
+};
+
+// args: entity (0 - SeqlockEntity, 1 - SharedMutexEntity), percentage of reads.
+// All threads share one entity, reads are consistent location + velocity pairs.
+void BM_EntityContention(benchmark::State& state) {
+    static game::SeqlockEntity seqlock;
+    static SharedMutexEntity locked;
+    game::IEntity& entity = 0 == state.range(0) ? static_cast<game::IEntity&>(seqlock) : locked;
+    const auto readPct = static_cast<std::uint32_t>(state.range(1));
+
+    game::MovingObjectAdapter moa{&entity};
+    auto op = static_cast<std::uint32_t>(state.thread_index()) * 37;
+    for (auto _ : state) {
+        if (++op % 100 < readPct) {
+            benchmark::DoNotOptimize(moa.getMotion());
+        } else {
+            moa.setLocation(game::Point{static_cast<int>(op % 1000), 0});
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+enum Observers {
+    NoObservers,  // ChangeBus without subscribers
+    OtherKey,     // a subscriber of another property
+    SameKey,      // a subscriber of the written property, dispatched every 1024 writes
+};
+
+// arg: observers. A change of location on every write.
+void BM_SetPropertyObserved(benchmark::State& state) {
+    const auto observers = static_cast<Observers>(state.range(0));
+    std::size_t seen{0};
+    game::ChangeBus::SubscriptionId id{0};
+    if (NoObservers != observers) {
+        id = game::ChangeBus::Subscribe(OtherKey == observers ? "angle" : "location",
+            [&seen](const game::PropertyChange&) { ++seen; });
+    }
+
+    game::SpaceShip ship;
+    const std::array<std::string, 2> locations{game::Point{1, 2}.toString(), game::Point{3, 4}.toString()};
+    std::size_t writes{0};
+    for (auto _ : state) {
+        ship.setProperty("location", locations[++writes % 2]);
+        if (writes % 1024 == 0) game::ChangeBus::Dispatch();
+    }
+    game::ChangeBus::Dispatch();
+    if (NoObservers != observers) game::ChangeBus::Unsubscribe(id);
+
+    benchmark::DoNotOptimize(seen);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// args: changes per batch, subscribers of the changed property. Only Dispatch() is timed.
+void BM_ChangeDispatch(benchmark::State& state) {
+    const auto changes = state.range(0);
+    const auto subscribers = state.range(1);
+    std::size_t seen{0};
+    std::vector<game::ChangeBus::SubscriptionId> ids;
+    for (std::int64_t i = 0; i < subscribers; ++i) {
+        ids.push_back(game::ChangeBus::Subscribe("location",
+            [&seen](const game::PropertyChange&) { ++seen; },
+            [i](const game::PropertyChange& change) { return change.value.size() % 2 == static_cast<std::size_t>(i % 2); }));
+    }
+
+    game::SpaceShip ship;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (std::int64_t i = 0; i < changes; ++i) ship.setProperty("location", game::Point{static_cast<int>(i), 0}.toString());
+        state.ResumeTiming();
+        game::ChangeBus::Dispatch();
+    }
+    for (const auto id: ids) game::ChangeBus::Unsubscribe(id);
+
+    benchmark::DoNotOptimize(seen);
+    state.SetItemsProcessed(state.iterations() * changes);
+}
+
+}  // namespace
+
+BENCHMARK(BM_PointParse);
+BENCHMARK(BM_PointFormat);
+BENCHMARK(BM_VectorParse);
+BENCHMARK(BM_AngleParse);
+BENCHMARK(BM_AngleFormat);
+BENCHMARK(BM_IntegerPropertyParseFormat);
+BENCHMARK(BM_MovingAdapterGetLocation);
+BENCHMARK(BM_MovingAdapterSetLocation);
+BENCHMARK(BM_RotatingAdapterGetSet);
+BENCHMARK(BM_MoveCommand);
+BENCHMARK(BM_EntityContention)
+    ->ArgsProduct({{0, 1}, {90, 99}})
+    ->ArgNames({"shared_mutex", "read_pct"})
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_SetPropertyObserved)
+    ->Arg(NoObservers)->Arg(OtherKey)->Arg(SameKey)
+    ->ArgName("observers");
+BENCHMARK(BM_ChangeDispatch)
+    ->ArgsProduct({{1'024, 65'536}, {1, 8}})
+    ->ArgNames({"changes", "subscribers"});
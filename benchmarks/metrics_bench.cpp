@@ -0,0 +1,205 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+#include <utility>
+
+#include <cmd_loop.hpp>
+#include <game.hpp>
+#include <loop_command.hpp>
+#include <loop_metrics.hpp>
+#include <queue_impl.hpp>
+#include <tracer.hpp>
+
+#include <command_impl.hpp>
+
+namespace {
+
+constexpr int commandsPerRun{1000};
+
+class NoOpCommand : public exceptions::ICommand {
+public:
+    void Execute() const override {}
+    exceptions::ICommandUPtr Clone() const override { return std::make_unique<NoOpCommand>(*this); }
+};
+
+// Same loop with the metrics hooks compiled in and out, the difference is the overhead.
+// NoOp shows the worst case, Move is a typical game command.
+template<bool Instrumented>
+void BM_InstrumentedLoopNoOp(benchmark::State& state) {
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < commandsPerRun; ++i) {
+            q.Push(std::make_unique<NoOpCommand>());
+        }
+        state.ResumeTiming();
+        exceptions::cmd_loop::detail::run_impl<Instrumented>(q, commandsPerRun);
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerRun);
+}
+
+template<bool Instrumented>
+void BM_InstrumentedLoopMove(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, -1}.toString());
+    game::MovingObjectAdapter moa{&ship};
+
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < commandsPerRun; ++i) {
+            q.Push(command::MakeLoopCommand<command::Move>(&moa));
+        }
+        state.ResumeTiming();
+        exceptions::cmd_loop::detail::run_impl<Instrumented>(q, commandsPerRun);
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerRun);
+}
+
+// a distinct command type per N, a queue mixing them changes type on every command
+template<int N>
+class TypedNoOp : public exceptions::ICommand {
+public:
+    void Execute() const override {}
+    exceptions::ICommandUPtr Clone() const override { return std::make_unique<TypedNoOp>(*this); }
+};
+
+template<int... N>
+void PushMixed(exceptions::IQueue& q, std::integer_sequence<int, N...>) {
+    (q.Push(std::make_unique<TypedNoOp<N>>()), ...);
+}
+
+constexpr int mixedTypes{16};
+
+template<bool Instrumented>
+void BM_InstrumentedLoopMixed(benchmark::State& state) {
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < commandsPerRun / mixedTypes; ++i) {
+            PushMixed(q, std::make_integer_sequence<int, mixedTypes>{});
+        }
+        state.ResumeTiming();
+        exceptions::cmd_loop::detail::run_impl<Instrumented>(q, q.Size());
+    }
+    state.SetItemsProcessed(state.iterations() * (commandsPerRun / mixedTypes) * mixedTypes);
+}
+
+// The budget for the metrics when enabled, as a share of the loop without them
+constexpr double overheadBudgetPercent{2.};
+
+// Runs the same commands through the loop with the hooks in and out, alternating so both
+// see the same cache and frequency state, and reports the enabled overhead against the budget
+template<typename MakeCommand>
+void MeasureOverhead(benchmark::State& state, MakeCommand makeCommand) {
+    using Clock = std::chrono::steady_clock;
+    exceptions::QueueImpl q;
+    Clock::duration plain{};
+    Clock::duration instrumented{};
+    const auto timeRun = [&]<bool Instrumented>(Clock::duration& total) {
+        for (int i = 0; i < commandsPerRun; ++i) {
+            q.Push(makeCommand());
+        }
+        const auto start = Clock::now();
+        exceptions::cmd_loop::detail::run_impl<Instrumented>(q, commandsPerRun);
+        total += Clock::now() - start;
+    };
+    for (auto _ : state) {
+        timeRun.template operator()<false>(plain);
+        timeRun.template operator()<true>(instrumented);
+    }
+    const auto overhead = 100. * (std::chrono::duration<double>(instrumented).count() /
+        std::chrono::duration<double>(plain).count() - 1.);
+    state.counters["overhead_%"] = overhead;
+    state.counters["budget_%"] = overheadBudgetPercent;
+    if (overhead > overheadBudgetPercent) {
+        state.SetLabel("over budget");
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerRun * 2);
+}
+
+void BM_MetricsOverheadNoOp(benchmark::State& state) {
+    MeasureOverhead(state, [] { return std::make_unique<NoOpCommand>(); });
+}
+
+void BM_MetricsOverheadMove(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, -1}.toString());
+    game::MovingObjectAdapter moa{&ship};
+    MeasureOverhead(state, [&] { return command::MakeLoopCommand<command::Move>(&moa); });
+}
+
+// arg: tracing. The loop without metrics, with the tracer stopped or recording every command.
+void BM_TracedLoopMove(benchmark::State& state) {
+    game::SpaceShip ship;
+    ship.setProperty("velocity", game::Vector{1, -1}.toString());
+    game::MovingObjectAdapter moa{&ship};
+
+    if (0 != state.range(0)) exceptions::trace::Start();
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        state.PauseTiming();
+        exceptions::trace::Reset();
+        for (int i = 0; i < commandsPerRun; ++i) {
+            q.Push(command::MakeLoopCommand<command::Move>(&moa));
+        }
+        state.ResumeTiming();
+        exceptions::cmd_loop::detail::run_impl<false>(q, commandsPerRun);
+    }
+    exceptions::trace::Stop();
+    exceptions::trace::Reset();
+    state.SetItemsProcessed(state.iterations() * commandsPerRun);
+}
+
+void BM_TracedLoopNoOp(benchmark::State& state) {
+    if (0 != state.range(0)) exceptions::trace::Start();
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        state.PauseTiming();
+        exceptions::trace::Reset();
+        for (int i = 0; i < commandsPerRun; ++i) {
+            q.Push(std::make_unique<NoOpCommand>());
+        }
+        state.ResumeTiming();
+        exceptions::cmd_loop::detail::run_impl<false>(q, commandsPerRun);
+    }
+    exceptions::trace::Stop();
+    exceptions::trace::Reset();
+    state.SetItemsProcessed(state.iterations() * commandsPerRun);
+}
+
+void BM_TraceExport(benchmark::State& state) {
+    exceptions::trace::Reset();
+    exceptions::trace::Start();
+    exceptions::QueueImpl q;
+    for (int i = 0; i < commandsPerRun; ++i) q.Push(std::make_unique<NoOpCommand>());
+    exceptions::cmd_loop::run(q);
+    exceptions::trace::Stop();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(exceptions::trace::ToChromeJson());
+    }
+    exceptions::trace::Reset();
+    state.SetItemsProcessed(state.iterations() * commandsPerRun);
+}
+
+void BM_MetricsCollect(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(exceptions::metrics::Collect());
+    }
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_InstrumentedLoopNoOp, false);
+BENCHMARK_TEMPLATE(BM_InstrumentedLoopNoOp, true);
+BENCHMARK_TEMPLATE(BM_InstrumentedLoopMove, false);
+BENCHMARK_TEMPLATE(BM_InstrumentedLoopMove, true);
+BENCHMARK_TEMPLATE(BM_InstrumentedLoopMixed, false);
+BENCHMARK_TEMPLATE(BM_InstrumentedLoopMixed, true);
+BENCHMARK(BM_MetricsOverheadNoOp);
+BENCHMARK(BM_MetricsOverheadMove);
+BENCHMARK(BM_MetricsCollect);
+BENCHMARK(BM_TracedLoopNoOp)->Arg(0)->Arg(1)->ArgName("tracing");
+BENCHMARK(BM_TracedLoopMove)->Arg(0)->Arg(1)->ArgName("tracing");
+BENCHMARK(BM_TraceExport);
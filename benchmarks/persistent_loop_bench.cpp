@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+#include <pthread.h>
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <stop_token>
+#include <thread>
+
+#include <blocking_queue_impl.hpp>
+#include <cmd_loop.hpp>
+#include <latency_histogram.hpp>
+
+namespace {
+
+using namespace exceptions;
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+// Records the time between Push() and its execution
+class WakeProbe : public ICommand {
+public:
+    explicit WakeProbe(LatencyHistogram& hist) : hist_{hist}, pushed_{Clock::now()} {}
+    void Execute() const override { hist_.Record(Clock::now() - pushed_); }
+    ICommandUPtr Clone() const override { return std::make_unique<WakeProbe>(*this); }
+
+private:
+    LatencyHistogram& hist_;
+    Clock::time_point pushed_;
+};
+
+enum Mode {
+    BusyPoll,      // cmd_loop::run in a tight outer loop
+    SleepPoll,     // cmd_loop::run, then sleep for 1ms
+    Park,          // persistent loop without spinning
+    SpinThenPark,  // persistent loop, 50us spin budget
+};
+
+constexpr int probes{2'000};
+constexpr auto gap{200us};
+
+std::chrono::nanoseconds ThreadCpu(pthread_t thread) {
+    clockid_t clock;
+    timespec ts{};
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) return {};
+    return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+void Consume(BlockingQueue& q, std::stop_token stop, Mode mode) {
+    switch (mode) {
+    case BusyPoll:
+        while (!stop.stop_requested()) cmd_loop::run(q);
+        break;
+    case SleepPoll:
+        while (!stop.stop_requested()) {
+            cmd_loop::run(q);
+            std::this_thread::sleep_for(1ms);
+        }
+        break;
+    case Park:
+        cmd_loop::run(q, stop, cmd_loop::PersistentConfig{.spin = 0ns});
+        break;
+    case SpinThenPark:
+        cmd_loop::run(q, stop, cmd_loop::PersistentConfig{.spin = 50us});
+        break;
+    }
+}
+
+// A producer pushes a probe every 200us into a queue served by a dedicated loop thread.
+// The loop is idle between probes, so the histogram is the wake-up latency and
+// consumer_cpu is the share of a core the loop burns while waiting.
+void BM_LoopWakeLatency(benchmark::State& state) {
+    const auto mode = static_cast<Mode>(state.range(0));
+    LatencyHistogram latency;
+    std::chrono::nanoseconds cpu{0};
+    std::chrono::nanoseconds wall{0};
+
+    for (auto _ : state) {
+        BlockingQueue q;
+        std::jthread loop{[&q, mode](std::stop_token stop) { Consume(q, stop, mode); }};
+        const auto cpuStart = ThreadCpu(loop.native_handle());
+        const auto start = Clock::now();
+        for (int i = 0; i < probes; ++i) {
+            std::this_thread::sleep_for(gap);
+            q.Push(std::make_unique<WakeProbe>(latency));
+        }
+        while (!q.IsEmpty()) std::this_thread::yield();
+        cpu += ThreadCpu(loop.native_handle()) - cpuStart;
+        wall += Clock::now() - start;
+    }
+    state.counters["p50_us"] = latency.Percentile(50.) / 1e3;
+    state.counters["p99_us"] = latency.Percentile(99.) / 1e3;
+    state.counters["consumer_cpu_pct"] = 100. * static_cast<double>(cpu.count()) / static_cast<double>(wall.count());
+    state.SetItemsProcessed(state.iterations() * probes);
+}
+
+// Back-to-back pushes from one producer thread: the cost of the inbox lock and the
+// futex word on the hot path, with the loop mostly busy.
+void BM_LoopThroughput(benchmark::State& state) {
+    constexpr int commands{200'000};
+    LatencyHistogram latency;
+
+    for (auto _ : state) {
+        BlockingQueue q;
+        std::jthread loop{[&q](std::stop_token stop) { cmd_loop::run(q, stop); }};
+        for (int i = 0; i < commands; ++i) {
+            q.Push(std::make_unique<WakeProbe>(latency));
+        }
+        while (!q.IsEmpty()) std::this_thread::yield();
+    }
+    state.SetItemsProcessed(state.iterations() * commands);
+}
+
+} // namespace
+
+BENCHMARK(BM_LoopWakeLatency)->Arg(BusyPoll)->Arg(SleepPoll)->Arg(Park)->Arg(SpinThenPark)->ArgName("mode")
+    ->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LoopThroughput)->Unit(benchmark::kMillisecond)->UseRealTime();
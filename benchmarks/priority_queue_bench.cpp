@@ -0,0 +1,103 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+
+#include <cmd_loop.hpp>
+#include <latency_histogram.hpp>
+#include <priority_queue_impl.hpp>
+#include <queue_impl.hpp>
+
+namespace {
+
+using namespace exceptions;
+using Clock = std::chrono::steady_clock;
+
+// Records its queueing latency when executed. Bulk work stands in for LogErrorCommand.
+class LatencyProbe : public ICommand {
+public:
+    LatencyProbe(LatencyHistogram& hist, bool bulk)
+    : hist_{hist}
+    , bulk_{bulk}
+    , enqueued_{Clock::now()} {}
+
+    void Execute() const override {
+        hist_.Record(Clock::now() - enqueued_);
+        if (bulk_) {
+            // roughly the cost of formatting and writing a log line
+            volatile double x{1.};
+            for (int i = 0; i < 200; ++i) x = x * 1.000001;
+        }
+    }
+
+    ICommandUPtr Clone() const override { return std::make_unique<LatencyProbe>(*this); }
+
+    bool IsBulk() const noexcept { return bulk_; }
+
+private:
+    LatencyHistogram& hist_;
+    bool bulk_;
+    Clock::time_point enqueued_;
+};
+
+constexpr int rounds{20'000};
+constexpr int highPriorityEvery{10};
+
+// Every round pushes two commands and executes one, i.e. 2x overload.
+// 10% of the commands are high priority (Move-like), the rest are bulk.
+template<typename TQueue>
+void Overload(benchmark::State& state, TQueue& q, LatencyHistogram& high) {
+    LatencyHistogram bulk;
+    int pushed{0};
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < 2; ++i, ++pushed) {
+            const bool isHigh = 0 == pushed % highPriorityEvery;
+            q.Push(std::make_unique<LatencyProbe>(isHigh ? high : bulk, !isHigh));
+        }
+        cmd_loop::run(q, 1);
+    }
+    state.PauseTiming();
+    while (!q.IsEmpty()) q.Pop();
+    state.ResumeTiming();
+}
+
+void ReportLatency(benchmark::State& state, const LatencyHistogram& high) {
+    state.counters["high_p50_us"] = high.Percentile(50.) / 1e3;
+    state.counters["high_p99_us"] = high.Percentile(99.) / 1e3;
+    state.counters["high_executed"] = static_cast<double>(high.Count()) / state.iterations();
+}
+
+void BM_OverloadFifo(benchmark::State& state) {
+    LatencyHistogram high;
+    for (auto _ : state) {
+        QueueImpl q;
+        Overload(state, q, high);
+    }
+    ReportLatency(state, high);
+}
+
+void BM_OverloadPriority(benchmark::State& state) {
+    using namespace std::chrono_literals;
+    LatencyHistogram high;
+    std::uint64_t shed{0};
+    for (auto _ : state) {
+        PriorityQueueImpl q{PriorityQueueImpl::Config{
+            .capacity = 1024,
+            .budgets = {1ms, 100ms},
+            .overflow = PriorityQueueImpl::Overflow::DropLowestPriority,
+            .dropExpired = true,
+            .classify = [](const ICommand& cmd) -> std::size_t {
+                return static_cast<const LatencyProbe&>(cmd).IsBulk() ? 1 : 0;
+            },
+        }};
+        Overload(state, q, high);
+        const auto stats = q.TotalStats();
+        shed += stats.evicted + stats.expired + stats.rejected;
+    }
+    ReportLatency(state, high);
+    state.counters["shed"] = static_cast<double>(shed) / state.iterations();
+}
+
+}  // namespace
+
+BENCHMARK(BM_OverloadFifo)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_OverloadPriority)->Unit(benchmark::kMillisecond);
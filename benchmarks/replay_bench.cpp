@@ -0,0 +1,105 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include <command_codec.hpp>
+#include <game.hpp>
+#include <journal.hpp>
+#include <queue_impl.hpp>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr int journalCommands{100'000};
+
+struct Fleet {
+    explicit Fleet(std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            auto& ship = *ships.emplace_back(std::make_unique<game::SpaceShip>());
+            ship.setProperty("velocity", game::Vector{1, 1}.toString());
+            ctx.AddEntity(&ship);
+        }
+    }
+
+    std::vector<std::unique_ptr<game::SpaceShip>> ships;
+    command::CodecContext ctx;
+};
+
+// Move/Rotate/ChangeVelocity mix over 1000 ships, about what a client session produces
+exceptions::ICommandUPtr MakeCommand(Fleet& fleet, int i) {
+    const auto id = command::ToEntityId(i % fleet.ships.size());
+    switch (i % 3) {
+        case 0: return command::MakeLoopCommand<command::Move>(&fleet.ctx.Moving(id));
+        case 1: return command::MakeLoopCommand<command::Rotate>(&fleet.ctx.Rotating(id));
+        default: return command::MakeLoopCommand<command::ChangeVelocity>(&fleet.ctx.Rotating(id), &fleet.ctx.Moving(id));
+    }
+}
+
+fs::path RecordJournal() {
+    const auto path = fs::temp_directory_path() / "architecture_bench_journal.bin";
+    Fleet fleet{1000};
+    command::CommandRegistry registry;
+    command::JournalWriter journal{path};
+    exceptions::QueueImpl q;
+    command::RecordingQueue recordingQueue{q, journal, registry, fleet.ctx};
+    for (int i = 0; i < journalCommands; ++i) {
+        recordingQueue.Push(MakeCommand(fleet, i));
+    }
+    return path;
+}
+
+void BM_EncodeCommand(benchmark::State& state) {
+    Fleet fleet{1000};
+    command::CommandRegistry registry;
+    command::BinaryWriter out;
+    const auto cmd = MakeCommand(fleet, 2);
+
+    for (auto _ : state) {
+        out.Clear();
+        registry.Encode(*cmd, out, fleet.ctx);
+        benchmark::DoNotOptimize(out.Data().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RecordingQueuePush(benchmark::State& state) {
+    const auto path = fs::temp_directory_path() / "architecture_bench_record.bin";
+    {
+        Fleet fleet{1000};
+        command::CommandRegistry registry;
+        command::JournalWriter journal{path};
+        exceptions::QueueImpl q;
+        command::RecordingQueue recordingQueue{q, journal, registry, fleet.ctx};
+
+        int i{0};
+        for (auto _ : state) {
+            recordingQueue.Push(MakeCommand(fleet, i++));
+            recordingQueue.Pop();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    fs::remove(path);
+}
+
+void BM_ReplayMaximumSpeed(benchmark::State& state) {
+    const auto path = RecordJournal();
+    Fleet fleet{1000};
+    command::CommandRegistry registry;
+    command::JournalReader journal{path};
+    exceptions::QueueImpl q;
+
+    for (auto _ : state) {
+        command::Replayer replayer{journal, registry, fleet.ctx};
+        benchmark::DoNotOptimize(replayer.Run(q, command::ReplaySpeed::Maximum));
+    }
+    state.SetItemsProcessed(state.iterations() * journalCommands);
+    fs::remove(path);
+}
+
+}  // namespace
+
+BENCHMARK(BM_EncodeCommand);
+BENCHMARK(BM_RecordingQueuePush);
+BENCHMARK(BM_ReplayMaximumSpeed)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include <delta_encoder.hpp>
+#include <scheduler.hpp>
+
+namespace {
+
+constexpr std::size_t ships{1'000'000};
+
+// args: percent of ships that move and turn per tick. Only Encode() is timed.
+void BM_DeltaEncode(benchmark::State& state) {
+    const auto churn = ships * static_cast<std::size_t>(state.range(0)) / 100;
+
+    simulation::EntityStore store;
+    std::size_t fullBytes{0};
+    for (std::size_t i = 0; i < ships; ++i) {
+        const auto& ship = store.Get(store.Add());
+        for (const auto* key: {"location", "velocity", "angle", "angular_velocity"}) fullBytes += ship.getProperty(key).size();
+    }
+    simulation::DeltaEncoder encoder;
+    encoder.Encode(store);
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<simulation::EntityId> pick{0, ships - 1};
+    std::uniform_int_distribution<int> step{-3, 3};
+    std::size_t bytes{0};
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (std::size_t i = 0; i < churn; ++i) {
+            auto& ship = store.Get(pick(gen));
+            auto location = game::Point::fromString(ship.getProperty("location"));
+            location.MoveTo(game::Vector{step(gen), step(gen)});
+            ship.setProperty("location", location.toString());
+            auto angle = game::Angle::fromString(ship.getProperty("angle"));
+            angle.rad += 0.01 * step(gen);
+            ship.setProperty("angle", angle.toString());
+        }
+        state.ResumeTiming();
+
+        const auto delta = encoder.Encode(store);
+        bytes += delta.size();
+        benchmark::DoNotOptimize(delta.data());
+    }
+
+    state.counters["bytes_per_tick"] = static_cast<double>(bytes) / static_cast<double>(state.iterations());
+    // the properties as stored, sent in full every tick
+    state.counters["full_bytes"] = static_cast<double>(fullBytes);
+}
+
+}  // namespace
+
+BENCHMARK(BM_DeltaEncode)
+    ->ArgsProduct({{1, 10, 50}})
+    ->ArgNames({"churn_pct"})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include <command_impl.hpp>
+#include <game.hpp>
+#include <loop_command.hpp>
+#include <rollback_world.hpp>
+
+namespace {
+
+constexpr std::size_t ships{100'000};
+
+// moves every n-th ship, a different subset every tick
+void MoveShips(simulation::RollbackWorld& world, std::size_t every) {
+    for (auto id = world.CurrentTick() % every; id < world.Size(); id += every) {
+        game::MovingObjectAdapter moa{&world.Get(id)};
+        game::Move{&moa}.Execute();
+    }
+}
+
+void MakeFleet(simulation::RollbackWorld& world, std::size_t churnPct) {
+    for (std::size_t i = 0; i < ships; ++i) {
+        world.Get(world.Add()).setProperty("velocity", game::Vector{1, -1}.toString());
+    }
+    const auto every = 100 / churnPct;
+    world.OnTick([every](simulation::RollbackWorld& w) { MoveShips(w, every); });
+}
+
+// args: ticks of history, percent of ships moved per tick. One iteration is one tick.
+void BM_RollbackCapture(benchmark::State& state) {
+    simulation::RollbackWorld world{static_cast<std::size_t>(state.range(0))};
+    MakeFleet(world, static_cast<std::size_t>(state.range(1)));
+
+    for (auto _ : state) {
+        world.Step();
+    }
+    state.counters["recorded_per_tick"] = static_cast<double>(world.LastRecorded());
+}
+
+// arg: percent of ships moved per tick. One iteration is a late input 10 ticks back,
+// the rewind and the 10 ticks simulated again.
+void BM_RollbackResimulate(benchmark::State& state) {
+    constexpr std::uint64_t ticksBack{10};
+    simulation::RollbackWorld world{16};
+    MakeFleet(world, static_cast<std::size_t>(state.range(0)));
+    for (std::uint64_t tick = 0; tick < ticksBack; ++tick) world.Step();
+
+    game::MovingObjectAdapter moa{&world.Get(0)};
+    for (auto _ : state) {
+        world.Input(world.CurrentTick() - ticksBack, command::MakeLoopCommand<command::Move>(&moa));
+        world.Resimulate(world.CurrentTick() - ticksBack);
+    }
+    state.counters["ticks"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * ticksBack), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_RollbackCapture)
+    ->ArgsProduct({{0, 16}, {1, 10, 100}})
+    ->ArgNames({"history", "churn_pct"})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RollbackResimulate)
+    ->Arg(10)->Arg(100)
+    ->ArgName("churn_pct")
+    ->Unit(benchmark::kMillisecond);
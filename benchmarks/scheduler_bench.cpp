@@ -0,0 +1,111 @@
+#include <benchmark/benchmark.h>
+
+#include <deque>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <command_codec.hpp>
+#include <loop_command.hpp>
+#include <parallel_executor.hpp>
+#include <queue_impl.hpp>
+#include <scheduler.hpp>
+
+namespace {
+
+// args: entity count, thread count, double buffered world
+void BM_SchedulerTick(benchmark::State& state) {
+    const auto entities = static_cast<std::size_t>(state.range(0));
+    const auto threads = static_cast<std::size_t>(state.range(1));
+    const auto doubleBuffered = 0 != state.range(2);
+
+    simulation::Scheduler scheduler{
+        simulation::SchedulerConfig{.threads = threads, .realtime = false, .doubleBuffered = doubleBuffered}};
+    for (std::size_t i = 0; i < entities; ++i) {
+        auto& ship = doubleBuffered ? scheduler.World().Get(scheduler.World().Add())
+                                    : static_cast<game::IEntity&>(scheduler.Entities().Get(scheduler.Entities().Add()));
+        ship.setProperty("velocity", game::Vector{1, -1}.toString());
+        ship.setProperty("angular_velocity", game::Angle{.rad = 0.01}.toString());
+    }
+    if (doubleBuffered) {
+        simulation::ThreadPool pool{threads};
+        scheduler.World().Swap(pool);
+    }
+
+    for (auto _ : state) {
+        scheduler.Step();
+    }
+
+    state.SetItemsProcessed(state.iterations() * entities);
+    const auto& physics = scheduler.PhaseLatency(simulation::Phase::Physics);
+    state.counters["physics_p50_us"] = physics.Percentile(50.) / 1e3;
+    state.counters["physics_p99_us"] = physics.Percentile(99.) / 1e3;
+    state.counters["tick_p99_us"] = scheduler.TickLatency().Percentile(99.) / 1e3;
+}
+
+// args: percentage of commands aimed at 4 hot ships, thread count.
+// Every iteration queues 8192 Move/Rotate/ChangeVelocity commands and executes them
+// through ParallelExecutor; with 1 thread that is cmd_loop::run.
+void BM_ParallelCommands(benchmark::State& state) {
+    constexpr std::size_t entities{10'000};
+    constexpr std::size_t commandsPerTick{8192};
+    constexpr std::size_t hotEntities{4};
+    const auto conflictPct = static_cast<std::size_t>(state.range(0));
+    const auto threads = static_cast<std::size_t>(state.range(1));
+
+    simulation::EntityStore store;
+    std::deque<game::MovingObjectAdapter> moving;
+    std::deque<game::RotatingObjectAdapter> rotating;
+    for (std::size_t i = 0; i < entities; ++i) {
+        auto& ship = store.Get(store.Add());
+        ship.setProperty("velocity", game::Vector{1, -1}.toString());
+        ship.setProperty("angular_velocity", game::Angle{.rad = 0.01}.toString());
+        moving.emplace_back(&ship);
+        rotating.emplace_back(&ship);
+    }
+
+    struct Order {
+        std::size_t target;
+        int kind;
+    };
+    std::vector<Order> orders;
+    std::mt19937 rng{42};
+    for (std::size_t i = 0; i < commandsPerTick; ++i) {
+        const auto hot = rng() % 100 < conflictPct;
+        orders.push_back(Order{hot ? rng() % hotEntities : rng() % entities, static_cast<int>(rng() % 3)});
+    }
+
+    simulation::ThreadPool pool{threads};
+    simulation::ParallelExecutor executor{pool};
+    exceptions::QueueImpl q;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (const auto& order: orders) {
+            switch (order.kind) {
+            case 0: q.Push(command::MakeLoopCommand<command::Move>(&moving[order.target])); break;
+            case 1: q.Push(command::MakeLoopCommand<command::Rotate>(&rotating[order.target])); break;
+            default: q.Push(command::MakeLoopCommand<command::ChangeVelocity>(&rotating[order.target], &moving[order.target]));
+            }
+        }
+        state.ResumeTiming();
+        executor.Run(q, std::numeric_limits<std::size_t>::max());
+    }
+
+    state.SetItemsProcessed(state.iterations() * commandsPerTick);
+    // the speedup bound: commands per level
+    state.counters["parallelism"] = static_cast<double>(executor.Commands()) / static_cast<double>(executor.Levels());
+}
+
+}  // namespace
+
+BENCHMARK(BM_ParallelCommands)
+    ->ArgsProduct({{0, 10, 50, 100}, {1, 2, 4}})
+    ->ArgNames({"conflict_pct", "threads"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_SchedulerTick)
+    ->ArgsProduct({{10'000, 100'000, 1'000'000}, {1, 2, 4, 8}, {0, 1}})
+    ->ArgNames({"entities", "threads", "double_buffered"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
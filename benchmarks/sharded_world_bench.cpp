@@ -0,0 +1,45 @@
+#include <benchmark/benchmark.h>
+
+#include <command_impl.hpp>
+#include <loop_command.hpp>
+#include <sharded_world.hpp>
+
+namespace {
+
+constexpr int ships{100'000};
+constexpr int width{10'000};
+
+// arg: shards. One iteration is a tick of 100k ships spread over the world, 1% of them are
+// steered by a command every tick and some cross into the stripe of another shard.
+void BM_ShardedWorldTick(benchmark::State& state) {
+    simulation::ShardedWorld world{simulation::ShardedWorldConfig{
+        .shards = static_cast<std::size_t>(state.range(0)), .width = width}};
+    for (int i = 0; i < ships; ++i) {
+        world.Add(game::Point{i % width, i / width}, game::Vector{i % 7 - 3, 0});
+    }
+    world.Step();
+
+    const auto migrations = world.Migrations();
+    simulation::EntityId next{0};
+    for (auto _ : state) {
+        for (int i = 0; i < ships / 100; ++i) {
+            world.Send(next++ % ships, [](simulation::ShardEntity& entity) {
+                return command::MakeLoopCommand<command::ChangeVelocity>(&entity.rotating, &entity.moving);
+            });
+        }
+        world.Step();
+    }
+
+    state.SetItemsProcessed(state.iterations() * ships);
+    state.counters["migrations_per_tick"] =
+        static_cast<double>(world.Migrations() - migrations) / static_cast<double>(state.iterations());
+    state.counters["nodes"] = static_cast<double>(world.Nodes());
+}
+
+}  // namespace
+
+BENCHMARK(BM_ShardedWorldTick)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->ArgName("shards")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,139 @@
+#include <benchmark/benchmark.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <cmd_loop.hpp>
+#include <command_codec.hpp>
+#include <game.hpp>
+#include <latency_histogram.hpp>
+#include <loop_command.hpp>
+#include <shm_transport.hpp>
+
+namespace {
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+constexpr int commandsPerIteration{200'000};
+constexpr int latencySamples{2'000};
+
+struct Fleet {
+    explicit Fleet(std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            auto& ship = *ships.emplace_back(std::make_unique<game::SpaceShip>());
+            ship.setProperty("velocity", game::Vector{1, 1}.toString());
+            ctx.AddEntity(&ship);
+        }
+    }
+
+    std::vector<std::unique_ptr<game::SpaceShip>> ships;
+    command::CodecContext ctx;
+};
+
+std::string SegmentName(std::string_view bench) {
+    return std::format("/architecture_bench_{}_{}", bench, ::getpid());
+}
+
+// Runs fn in a child process, which exits right after
+template<typename TFn>
+pid_t Spawn(TFn fn) {
+    const auto pid = ::fork();
+    if (0 == pid) {
+        fn();
+        ::_exit(0);
+    }
+    return pid;
+}
+
+void Join(const std::vector<pid_t>& children) {
+    for (const auto pid: children) {
+        int status{0};
+        ::waitpid(pid, &status, 0);
+    }
+}
+
+// Producer processes send Move commands for 1000 ships, the consumer decodes and executes
+// them through ShmQueue and cmd_loop, i.e. the full ingestion to simulation path.
+void BM_ShmThroughput(benchmark::State& state) {
+    const auto producers = static_cast<int>(state.range(0));
+    Fleet fleet{1000};
+    command::CommandRegistry registry;
+    command::ShmConsumer consumer{SegmentName("throughput"), command::ShmConfig{.slots = 8, .ringBytes = 1 << 20}};
+    command::ShmQueue queue{consumer, registry, fleet.ctx};
+
+    for (auto _ : state) {
+        std::vector<pid_t> children;
+        for (int p = 0; p < producers; ++p) {
+            children.push_back(Spawn([&, p] {
+                command::ShmProducer producer{consumer.Name()};
+                command::BinaryWriter out;
+                for (int i = p; i < commandsPerIteration; i += producers) {
+                    const auto id = command::ToEntityId(i % fleet.ships.size());
+                    out.Clear();
+                    registry.Encode(command::LoopCommand<command::Move>{command::Move{&fleet.ctx.Moving(id)}}, out, fleet.ctx);
+                    producer.Push(out.Data(), 10s);
+                }
+            }));
+        }
+
+        std::size_t executed{0};
+        while (executed < commandsPerIteration && consumer.Wait(1s)) {
+            executed += exceptions::cmd_loop::run(queue, commandsPerIteration);
+        }
+        Join(children);
+        if (executed != commandsPerIteration) {
+            state.SkipWithError("Commands were lost");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * commandsPerIteration);
+}
+
+// One producer process sends a timestamp every 50us, the consumer parks on the futex
+// between records; the histogram shows the one way latency including the wake-up.
+void BM_ShmLatency(benchmark::State& state) {
+    command::ShmConsumer consumer{SegmentName("latency"), command::ShmConfig{.slots = 1, .ringBytes = 1 << 16}};
+    exceptions::LatencyHistogram latency;
+
+    for (auto _ : state) {
+        const auto child = Spawn([&] {
+            command::ShmProducer producer{consumer.Name()};
+            for (int i = 0; i < latencySamples; ++i) {
+                std::this_thread::sleep_for(50us);
+                const auto sent = Clock::now().time_since_epoch().count();
+                std::uint8_t payload[sizeof(sent)];
+                std::memcpy(payload, &sent, sizeof(sent));
+                producer.Push(payload, 1s);
+            }
+        });
+
+        int received{0};
+        std::span<const std::uint8_t> record;
+        while (received < latencySamples && consumer.Wait(1s)) {
+            while (consumer.Peek(record)) {
+                const auto now = Clock::now().time_since_epoch().count();
+                Clock::rep sent;
+                std::memcpy(&sent, record.data(), sizeof(sent));
+                latency.Record(std::chrono::nanoseconds{now - sent});
+                consumer.Consume();
+                ++received;
+            }
+        }
+        Join({child});
+    }
+    state.counters["p50_us"] = latency.Percentile(50.) / 1e3;
+    state.counters["p99_us"] = latency.Percentile(99.) / 1e3;
+    state.counters["max_us"] = static_cast<double>(latency.Max()) / 1e3;
+}
+
+}  // namespace
+
+BENCHMARK(BM_ShmThroughput)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ShmLatency)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(3);
@@ -0,0 +1,45 @@
+#include <benchmark/benchmark.h>
+#include <stdexcept>
+
+#include <square_roots.hpp>
+
+namespace {
+
+void BM_SolveTwoRoots(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(square_roots::solve(1., 0., -1.));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_SolveOneRoot(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(square_roots::solve(1., 2., 1.));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_SolveNoRoots(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(square_roots::solve(1., 0., 1.));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_SolveThrows(benchmark::State& state) {
+    for (auto _ : state) {
+        try {
+            benchmark::DoNotOptimize(square_roots::solve(0., 1., 1.));
+        } catch (const std::runtime_error& ex) {
+            benchmark::DoNotOptimize(ex.what());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK(BM_SolveTwoRoots);
+BENCHMARK(BM_SolveOneRoot);
+BENCHMARK(BM_SolveNoRoots);
+BENCHMARK(BM_SolveThrows);
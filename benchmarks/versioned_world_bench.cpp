@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <game.hpp>
+#include <versioned_world.hpp>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t ships{10'000};
+// ships the writer changes per epoch
+constexpr std::size_t writesPerEpoch{1'000};
+
+enum Mode {
+    Mvcc,         // VersionedWorld, readers pin snapshots
+    StopTheWorld, // SpaceShips behind one mutex, readers copy all of them under the lock
+};
+
+// args: mode, reader threads. The benchmark thread is the writer, every iteration is one epoch.
+// Readers take consistent passes over all ships for as long as the writer runs.
+void BM_SnapshotReaders(benchmark::State& state) {
+    const auto mode = static_cast<Mode>(state.range(0));
+    const auto readerCount = static_cast<std::size_t>(state.range(1));
+
+    simulation::VersionedWorld world{ships};
+    std::vector<std::unique_ptr<game::SpaceShip>> fleet;
+    std::mutex mtx;
+    for (std::size_t i = 0; i < ships; ++i) {
+        world.Add();
+        fleet.push_back(std::make_unique<game::SpaceShip>());
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<std::uint64_t> passes{0};
+    std::vector<std::jthread> readers;
+    for (std::size_t r = 0; r < readerCount; ++r) {
+        readers.emplace_back([&] {
+            std::size_t chars{0};
+            std::vector<std::string> copy(ships);
+            while (!done.load(std::memory_order_relaxed)) {
+                if (Mvcc == mode) {
+                    const auto snapshot = world.TakeSnapshot();
+                    for (simulation::EntityId id = 0; id < snapshot.Size(); ++id) {
+                        chars += snapshot.View(id, "location").size();
+                    }
+                } else {
+                    {
+                        std::lock_guard lock{mtx};
+                        for (std::size_t id = 0; id < ships; ++id) copy[id] = fleet[id]->getProperty("location");
+                    }
+                    for (const auto& location: copy) chars += location.size();
+                }
+                passes.fetch_add(1, std::memory_order_relaxed);
+            }
+            benchmark::DoNotOptimize(chars);
+        });
+    }
+
+    int epoch{0};
+    const auto start = Clock::now();
+    for (auto _ : state) {
+        ++epoch;
+        const auto location = game::Point{epoch, epoch}.toString();
+        const auto first = (static_cast<std::size_t>(epoch) * writesPerEpoch) % ships;
+        if (Mvcc == mode) {
+            for (auto id = first; id < first + writesPerEpoch; ++id) world.Get(id).setProperty("location", location);
+            world.Commit();
+        } else {
+            std::lock_guard lock{mtx};
+            for (auto id = first; id < first + writesPerEpoch; ++id) fleet[id]->setProperty("location", location);
+        }
+    }
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    done = true;
+    readers.clear();
+
+    state.SetItemsProcessed(state.iterations() * writesPerEpoch);
+    state.counters["reader_passes_per_s"] = static_cast<double>(passes.load()) / elapsed;
+}
+
+}  // namespace
+
+BENCHMARK(BM_SnapshotReaders)
+    ->ArgsProduct({{Mvcc, StopTheWorld}, {0, 1, 2, 4, 8, 16}})
+    ->ArgNames({"mode", "readers"})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
@@ -0,0 +1,125 @@
+#include <benchmark/benchmark.h>
+
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cmd_loop.hpp>
+#include <command_codec.hpp>
+#include <loop_command.hpp>
+#include <queue_impl.hpp>
+#include <write_ahead_log.hpp>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+fs::path WalDir() {
+    const auto dir = fs::temp_directory_path() / "architecture_bench_wal";
+    fs::remove_all(dir);
+    return dir;
+}
+
+// args: fdatasync, flush interval in us. Every iteration appends one record,
+// the time includes making all of them durable.
+void BM_WalCommit(benchmark::State& state) {
+    const auto dir = WalDir();
+    const auto location = game::Point{-1234, 5678}.toString();
+    std::uint64_t groups{0};
+    {
+        simulation::WriteAheadLog wal{dir, 0, simulation::WalConfig{
+            .flushInterval = std::chrono::microseconds{state.range(1)}, .sync = 0 != state.range(0)}};
+        const auto prop = wal.Property("location");
+        simulation::EntityId id{0};
+        for (auto _ : state) {
+            wal.Append(++id % 1000, prop, location);
+        }
+        wal.Flush();
+        groups = wal.Groups();
+    }
+    fs::remove_all(dir);
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["records_per_group"] = static_cast<double>(state.iterations()) / static_cast<double>(groups);
+}
+
+// arg: logged. One iteration is cmd_loop::run over a Move of every ship,
+// plain ships or LoggedEntity over them.
+void BM_WalCommandLoop(benchmark::State& state) {
+    constexpr std::size_t ships{1024};
+    const auto logged = 0 != state.range(0);
+    const auto dir = WalDir();
+    {
+        simulation::WriteAheadLog wal{dir, 0, simulation::WalConfig{.sync = true}};
+        simulation::EntityStore store;
+        std::deque<simulation::LoggedEntity> loggedShips;
+        std::vector<std::unique_ptr<game::MovingObjectAdapter>> adapters;
+        for (std::size_t i = 0; i < ships; ++i) {
+            const auto id = store.Add();
+            store.Get(id).setProperty("velocity", game::Vector{1, -1}.toString());
+            game::IEntity* entity = &store.Get(id);
+            if (logged) entity = &loggedShips.emplace_back(store.Get(id), id, wal);
+            adapters.push_back(std::make_unique<game::MovingObjectAdapter>(entity));
+        }
+
+        exceptions::QueueImpl q;
+        for (auto _ : state) {
+            for (auto& adapter: adapters) q.Push(command::MakeLoopCommand<command::Move>(adapter.get()));
+            exceptions::cmd_loop::run(q);
+        }
+    }
+    fs::remove_all(dir);
+
+    state.SetItemsProcessed(state.iterations() * ships);
+}
+
+// arg: log size in MB, location writes over 100k ships. Only Recover() is timed.
+void BM_WalRecover(benchmark::State& state) {
+    constexpr std::size_t ships{100'000};
+    const auto dir = WalDir();
+    std::size_t bytes{0};
+    {
+        simulation::WriteAheadLog wal{dir, 0, simulation::WalConfig{.sync = false}};
+        const auto prop = wal.Property("location");
+        for (simulation::EntityId id = 0; bytes < static_cast<std::size_t>(state.range(0)) << 20; ++id) {
+            const auto location = game::Point{static_cast<int>(id), -static_cast<int>(id)}.toString();
+            wal.Append(id % ships, prop, location);
+            bytes += location.size() + 5;
+        }
+    }
+    bytes = 0;
+    for (const auto& entry: fs::directory_iterator{dir}) bytes += entry.file_size();
+
+    simulation::ThreadPool pool{4};
+    for (auto _ : state) {
+        simulation::EntityStore store;
+        simulation::WriteAheadLog::Recover(dir, store, pool);
+        benchmark::DoNotOptimize(store.Size());
+
+        state.PauseTiming();
+        { [[maybe_unused]] const auto release = std::move(store); }
+        state.ResumeTiming();
+    }
+    fs::remove_all(dir);
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(bytes));
+}
+
+}  // namespace
+
+BENCHMARK(BM_WalCommit)
+    ->ArgsProduct({{0, 1}, {100, 1000}})
+    ->ArgNames({"sync", "flush_us"})
+    ->UseRealTime();
+BENCHMARK(BM_WalCommandLoop)
+    ->Arg(0)->Arg(1)
+    ->ArgName("logged")
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(BM_WalRecover)
+    ->Arg(64)->Arg(256)
+    ->ArgName("log_mb")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();